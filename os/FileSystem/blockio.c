@@ -2,12 +2,20 @@
  * These routines provide block-oriented access to
  * a simulated disk.
  ****************************************************/
+#define _POSIX_C_SOURCE 199309L
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fileSystem.h"
+#include "cache.h"
+#include "stats.h"
+#include "trace.h"
 
 /* file for storing simulated disk's data */
 #define DISKFILE "simdisk.data"
@@ -24,6 +32,26 @@
  is not yet opened. */
 static int diskfd = -1;
 
+/* model of the device behind the disk file: every
+ access is charged a fixed latency, a seek cost for
+ each block the head travels, and its transfer time.
+ all zero (the default) makes every access free. */
+static long model_latency = 0;   /* ns per request */
+static long model_seek = 0;      /* ns per block of head travel */
+static long model_bandwidth = 0; /* bytes per second, 0 for unlimited */
+static int model_depth = 1;      /* requests in flight while plugged */
+static int model_realtime = 0;   /* also sleep for the charged time */
+
+/* simulated time and head travel since the disk was opened */
+static long sim_clock = 0;
+static long sim_travel = 0;
+static int head = 0;
+
+/* while plugged, requests are queued together, so the
+ latencies of up to model_depth of them overlap */
+static int plugged = 0;
+static long plugged_requests = 0;
+
 /************************************************
  * init_disk()
  *     - private function used to open the disk data file
@@ -54,6 +82,105 @@ static int init_disk() {
     return (0);
 }
 
+/************************************************
+ * charge(blknum,count)
+ *     - private function used to advance the
+ *       simulated clock by the cost of one access
+ *       to count blocks from blknum, and to move
+ *       the head past them
+ *************************************************/
+static void charge(int blknum, int count) {
+    long cost = model_seek * labs((long) blknum - head);
+
+    if (model_bandwidth > 0)
+        cost += count * (BLKSIZE * 1000000000L / model_bandwidth);
+    /* a plugged request shares its latency with the
+     others in flight with it */
+    if (!plugged || plugged_requests++ % model_depth == 0)
+        cost += model_latency;
+    sim_travel += labs((long) blknum - head);
+    sim_clock += cost;
+    head = blknum + count;
+    if (model_realtime && cost > 0) {
+        struct timespec t = { cost / 1000000000L, cost % 1000000000L };
+        nanosleep(&t, NULL);
+    }
+}
+
+/************************************************
+ * set_disk_model(latency,seek,bandwidth,depth,realtime)
+ *    - configures the cost of every later access,
+ *      and restarts the simulated clock
+ *
+ *    - latency is charged once per request, in ns
+ *    - seek is charged per block the head travels, in ns
+ *    - bandwidth limits transfers, in bytes per
+ *      second, or 0 for no limit
+ *    - depth is how many plugged requests overlap
+ *    - realtime, if nonzero, also sleeps for the
+ *      charged time, so wall-clock timings see it
+ *
+ *    - Returns 0 if successful, -1 otherwise
+ *************************************************/
+int set_disk_model(long latency, long seek, long bandwidth, int depth, int realtime) {
+    if (latency < 0 || seek < 0 || bandwidth < 0 || depth < 1) {
+        fprintf(stderr, "set_disk_model: invalid device model\n");
+        return (-1);
+    }
+    model_latency = latency;
+    model_seek = seek;
+    model_bandwidth = bandwidth;
+    model_depth = depth;
+    model_realtime = realtime;
+    sim_clock = 0;
+    sim_travel = 0;
+    return (0);
+}
+
+/************************************************
+ * disk_clock()
+ *    - Returns the simulated time spent on the
+ *      disk since the model was set, in ns
+ *************************************************/
+long disk_clock() {
+    return (sim_clock);
+}
+
+/************************************************
+ * disk_travel()
+ *    - Returns how many blocks the head has
+ *      travelled since the model was set
+ *************************************************/
+long disk_travel() {
+    return (sim_travel);
+}
+
+/************************************************
+ * disk_head()
+ *    - Returns the block the head is over, which
+ *      is the one after the last block accessed
+ *************************************************/
+int disk_head() {
+    return (head);
+}
+
+/************************************************
+ * plug_disk() / unplug_disk()
+ *    - requests made while the disk is plugged
+ *      are in flight together: up to the queue
+ *      depth of them share one latency. seeks
+ *      and transfers are still paid one by one
+ *************************************************/
+void plug_disk() {
+    if (plugged++ == 0)
+        plugged_requests = 0;
+}
+
+void unplug_disk() {
+    if (plugged > 0)
+        plugged--;
+}
+
 /************************************************
  * get_block(blknum,buf)
  *    - retrieves one block from the simulated disk
@@ -67,6 +194,7 @@ static int init_disk() {
  *    - Returns 0 if successful, -1 otherwise
  *************************************************/
 int get_block(int blknum, char *buf) {
+    TRACE("get_block");
     if (blknum >= NUMBLKS || blknum < 0) {
         fprintf(stderr, "get_block: invalid block number: %d\n", blknum);
         return (-1);
@@ -86,6 +214,8 @@ int get_block(int blknum, char *buf) {
         perror("get_block");
         return (-1);
     }
+    charge(blknum, 1);
+    countBlockRead();
     return (0);
 }
 
@@ -102,6 +232,7 @@ int get_block(int blknum, char *buf) {
  *    - Returns 0 if successful, -1 otherwise
  *************************************************/
 int put_block(int blknum, char *buf) {
+    TRACE("put_block");
     if (blknum >= NUMBLKS || blknum < 0) {
         fprintf(stderr, "put_block: invalid block number: %d\n", blknum);
         return (-1);
@@ -121,5 +252,80 @@ int put_block(int blknum, char *buf) {
         perror("put_block");
         return (-1);
     }
+    charge(blknum, 1);
+    updateCached(blknum, buf);
+    countBlockWrite();
+    return (0);
+}
+
+/************************************************
+ * get_run(blknum,count,buf)
+ *    - retrieves count consecutive blocks from
+ *      the simulated disk in a single request
+ *
+ *    - blknum is the number of the first block
+ *    - buf should point to count block-sized
+ *      buffers laid end to end
+ *
+ *    - Returns 0 if successful, -1 otherwise
+ *************************************************/
+int get_run(int blknum, int count, char *buf) {
+    TRACE("get_run");
+    if (count < 1 || blknum < 0 || blknum + count > NUMBLKS) {
+        fprintf(stderr, "get_run: invalid block run: %d+%d\n", blknum, count);
+        return (-1);
+    }
+    if (diskfd < 0) {
+        if (init_disk() != 0)
+            return (-1);
+    }
+    if (lseek(diskfd, blknum * BLKSIZE, SEEK_SET) < 0) {
+        perror("get_run");
+        return (-1);
+    }
+    if (read(diskfd, buf, count * BLKSIZE) < 0) {
+        perror("get_run");
+        return (-1);
+    }
+    charge(blknum, count);
+    for (int i = 0; i < count; i++)
+        countBlockRead();
+    return (0);
+}
+
+/************************************************
+ * put_run(blknum,count,buf)
+ *    - writes count consecutive blocks to the
+ *      simulated disk in a single request
+ *
+ *    - blknum is the number of the first block
+ *    - buf should point to count block-sized
+ *      buffers laid end to end
+ *
+ *    - Returns 0 if successful, -1 otherwise
+ *************************************************/
+int put_run(int blknum, int count, char *buf) {
+    TRACE("put_run");
+    if (count < 1 || blknum < 0 || blknum + count > NUMBLKS) {
+        fprintf(stderr, "put_run: invalid block run: %d+%d\n", blknum, count);
+        return (-1);
+    }
+    if (diskfd < 0) {
+        if (init_disk() != 0)
+            return (-1);
+    }
+    if (lseek(diskfd, blknum * BLKSIZE, SEEK_SET) < 0) {
+        perror("put_run");
+        return (-1);
+    }
+    if (write(diskfd, buf, count * BLKSIZE) < 0) {
+        perror("put_run");
+        return (-1);
+    }
+    charge(blknum, count);
+    for (int i = 0; i < count; i++) {
+        updateCached(blknum + i, buf + i * BLKSIZE);
+        countBlockWrite();
+    }
     return (0);
 }
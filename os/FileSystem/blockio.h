@@ -6,3 +6,34 @@ extern int
 put_block(int blknum, /* which disk block to update */
 char *buf); /* where in memory to get new disk block contents */
 
+extern int
+get_run(int blknum, /* first of the disk blocks to retrieve */
+int count, /* how many consecutive blocks to retrieve */
+char *buf); /* where in memory to put them, end to end */
+
+extern int
+put_run(int blknum, /* first of the disk blocks to update */
+int count, /* how many consecutive blocks to update */
+char *buf); /* where in memory to get them, end to end */
+
+extern int
+set_disk_model(long latency, /* ns charged per request */
+long seek, /* ns charged per block the head travels */
+long bandwidth, /* bytes per second, 0 for no limit */
+int depth, /* how many plugged requests overlap */
+int realtime); /* nonzero to also sleep for the charged time */
+
+extern long
+disk_clock(); /* simulated ns spent on the disk */
+
+extern long
+disk_travel(); /* blocks the head has travelled */
+
+extern int
+disk_head(); /* block the head is over */
+
+extern void
+plug_disk(); /* queue the next requests together */
+
+extern void
+unplug_disk(); /* stop queueing requests together */
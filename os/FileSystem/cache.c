@@ -0,0 +1,359 @@
+/*
+ * cache.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "fileSystem.h"
+#include "cache.h"
+#include "stats.h"
+
+/*
+ * The block cache holds CACHE_BLOCKS recently read blocks of file chains. Every write to the
+ * disk goes through updateCached, so a cached block is never stale. Blocks are evicted with
+ * the clock algorithm: a block read or added since the hand last passed it gets a second chance.
+ *
+ * Chain blocks allocated together lie next to each other on disk, so when a file is read
+ * sequentially the blocks after a missing one are read with it, as one request of a run,
+ * and later reads of the chain are served from memory. The number of blocks read ahead is
+ * set for each read from how sequential the reads of the open file have been.
+ *
+ * With warm-up on, the blocks used most since the disk was mounted are listed in a side file
+ * when the file system shuts down cleanly, and read back into the cache on the next mount,
+ * so that the first lookups after a restart are served from memory.
+ */
+
+static char blocks[CACHE_BLOCKS][BLOCK_SIZE];
+
+// Block held in each slot, or -1
+static int heldIn[CACHE_BLOCKS];
+
+// Slot holding each block, or -1
+static int slotOf[BLOCKS];
+
+// Whether each slot was read since the clock hand last passed it
+static char referenced[CACHE_BLOCKS];
+
+static int hand = 0;
+static int ready = 0;
+
+// How many blocks the chain walks of the current read may read ahead
+static int readAhead = 0;
+
+// How many times each block was read through the cache since the disk was mounted
+static unsigned long uses[BLOCKS];
+
+// Whether the hot blocks are saved on shutdown and read back on mount
+static int warmup = 0;
+
+/*
+ * prepare: Empties the cache the first time it is used.
+ */
+static void prepare() {
+    if (!ready) {
+        clearCache();
+    }
+}
+
+/*
+ * place: Finds a slot for a block, evicting the block in it.
+ *
+ * @blockID     Integer     the block to hold
+ *
+ * return int:              the slot, now holding nothing
+ */
+static int place(int blockID) {
+    while (heldIn[hand] >= 0 && referenced[hand]) {
+        referenced[hand] = 0;
+        hand = (hand + 1) % CACHE_BLOCKS;
+    }
+
+    int slot = hand;
+    hand = (hand + 1) % CACHE_BLOCKS;
+
+    if (heldIn[slot] >= 0) {
+        slotOf[heldIn[slot]] = -1;
+    }
+
+    // A new block gets its second chance straight away, so a run being read in never evicts itself
+    heldIn[slot] = blockID;
+    slotOf[blockID] = slot;
+    referenced[slot] = 1;
+
+    return slot;
+}
+
+/*
+ * getCached: Reads a block through the block cache. A block missing from the cache is read
+ * from disk, along with the blocks after it when reading ahead.
+ *
+ * @blockID     Integer     the block to read
+ * @block       String      where the block is copied to
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving the block
+ */
+int getCached(int blockID, char* block) {
+    prepare();
+
+    if (blockID < 0 || blockID >= BLOCKS) {
+        return get_block(blockID, block);
+    }
+
+    if (slotOf[blockID] < 0) {
+        countCache(0);
+
+        if (readAhead > 0 ? prefetchBlocks(blockID, readAhead + 1) : prefetchBlocks(blockID, 1)) {
+            return -1;
+        }
+    } else {
+        countCache(1);
+    }
+
+    int slot = slotOf[blockID];
+
+    memcpy(block, blocks[slot], BLOCK_SIZE);
+    referenced[slot] = 1;
+    uses[blockID]++;
+
+    return 0;
+}
+
+/*
+ * prefetchBlocks: Reads a run of blocks into the cache in a single request.
+ * Blocks already cached keep their copy, which is never stale.
+ *
+ * @blockID     Integer     the first block of the run
+ * @count       Integer     how many blocks to read, cut short at the end of the disk
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving the blocks
+ */
+int prefetchBlocks(int blockID, int count) {
+    static char run[CACHE_BLOCKS][BLOCK_SIZE];
+
+    prepare();
+
+    if (count > CACHE_BLOCKS / 2) {
+        count = CACHE_BLOCKS / 2;
+    }
+
+    if (blockID + count > BLOCKS) {
+        count = BLOCKS - blockID;
+    }
+
+    if (count <= 0 || get_run(blockID, count, run[0])) {
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (slotOf[blockID + i] < 0) {
+            memcpy(blocks[place(blockID + i)], run[i], BLOCK_SIZE);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * updateCached: Keeps the cached copy of a block in step with a write to the disk.
+ *
+ * @blockID     Integer     the block written
+ * @block       String      its new contents
+ */
+void updateCached(int blockID, const char* block) {
+    if (ready && blockID >= 0 && blockID < BLOCKS && slotOf[blockID] >= 0) {
+        memcpy(blocks[slotOf[blockID]], block, BLOCK_SIZE);
+    }
+}
+
+/*
+ * clearCache: Empties the block cache, for a disk that may have changed underneath it.
+ */
+void clearCache() {
+    for (int i = 0; i < CACHE_BLOCKS; i++) {
+        heldIn[i] = -1;
+        referenced[i] = 0;
+    }
+
+    for (int i = 0; i < BLOCKS; i++) {
+        slotOf[i] = -1;
+        uses[i] = 0;
+    }
+
+    hand = 0;
+    ready = 1;
+}
+
+/*
+ * setReadAhead: Sets how many blocks past a missing one the next chain walks read with it.
+ *
+ * @count       Integer     blocks to read ahead, 0 to read one block at a time
+ */
+void setReadAhead(int count) {
+    readAhead = count;
+}
+
+/*
+ * setWarmup: Turns saving and reloading the hot blocks across mounts on or off.
+ *
+ * @enable      Integer     1 to save the hot blocks on shutdown and read them back on mount
+ */
+void setWarmup(int enable) {
+    warmup = enable;
+}
+
+/*
+ * isWarmup: Checks whether the hot blocks are saved and reloaded across mounts.
+ *
+ * return 1:        the hot blocks are saved and reloaded
+ * return 0:        every mount starts with an empty cache
+ */
+int isWarmup() {
+    return warmup;
+}
+
+/*
+ * byUses: Orders blocks from the most used to the least, then by number.
+ */
+static int byUses(const void* a, const void* b) {
+    int x = *(const int*) a;
+    int y = *(const int*) b;
+
+    if (uses[x] != uses[y]) {
+        return uses[x] < uses[y] ? 1 : -1;
+    }
+
+    return x - y;
+}
+
+/*
+ * byNumber: Orders blocks by number, which is their order on disk.
+ */
+static int byNumber(const void* a, const void* b) {
+    return *(const int*) a - *(const int*) b;
+}
+
+/*
+ * saveHotBlocks: Saves the blocks used most since the disk was mounted to a side file,
+ * one block number per line, most used first. At most as many blocks as the cache holds
+ * are saved. The file is written under a temporary name and then renamed, so that a
+ * shutdown cut short leaves the previous list whole.
+ *
+ * @filename    String      the side file
+ *
+ * return  0:               successful execution
+ * return -1:               error writing the side file
+ */
+int saveHotBlocks(const char* filename) {
+    char temporary[FILENAME_MAX];
+    int hot[BLOCKS];
+    int count = 0;
+
+    prepare();
+
+    for (int i = 0; i < BLOCKS; i++) {
+        if (uses[i] > 0) {
+            hot[count++] = i;
+        }
+    }
+
+    qsort(hot, count, sizeof(int), byUses);
+
+    if (count > CACHE_BLOCKS) {
+        count = CACHE_BLOCKS;
+    }
+
+    if (snprintf(temporary, FILENAME_MAX, "%s.tmp", filename) >= FILENAME_MAX) {
+        fprintf(stderr, "The name of the list of hot blocks is too long.\n");
+        return -1;
+    }
+
+    FILE* file = fopen(temporary, "w");
+
+    if (file == NULL) {
+        fprintf(stderr, "Error creating the list of hot blocks.\n");
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%d\n", hot[i]);
+    }
+
+    if (fclose(file) || rename(temporary, filename)) {
+        fprintf(stderr, "Error writing the list of hot blocks.\n");
+        remove(temporary);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * warmCache: Reads the blocks listed in a side file into the block cache. The blocks are
+ * read in order of their number, each run of consecutive blocks as one request, with the
+ * requests queued together, so that warming the cache costs about one sweep of the disk.
+ * A missing side file leaves the cache empty.
+ *
+ * @filename    String      the side file
+ *
+ * return int:              how many blocks were read
+ * return -1:               error reading the blocks
+ * return -2:               the side file is not a list of blocks
+ */
+int warmCache(const char* filename) {
+    int hot[CACHE_BLOCKS];
+    int count = 0;
+
+    prepare();
+
+    FILE* file = fopen(filename, "r");
+
+    if (file == NULL) {
+        return 0;
+    }
+
+    while (count < CACHE_BLOCKS && fscanf(file, "%d", &hot[count]) == 1) {
+        if (hot[count] < 0 || hot[count] >= BLOCKS) {
+            fclose(file);
+            fprintf(stderr, "Block %d in the list of hot blocks is not on the disk.\n", hot[count]);
+            return -2;
+        }
+
+        count++;
+    }
+
+    fclose(file);
+
+    qsort(hot, count, sizeof(int), byNumber);
+
+    int read = 0;
+    int result = 0;
+
+    plug_disk();
+
+    for (int i = 0; i < count && result == 0; i++) {
+        int run = 1;
+
+        // Gather the blocks that follow on from this one, skipping any listed twice
+        while (i + 1 < count && hot[i + 1] - hot[i] <= 1 && run < CACHE_BLOCKS / 2) {
+            run += hot[i + 1] - hot[i];
+            i++;
+        }
+
+        result = prefetchBlocks(hot[i] - run + 1, run);
+        read += run;
+    }
+
+    unplug_disk();
+
+    if (result) {
+        fprintf(stderr, "Error reading the hot blocks.\n");
+        return -1;
+    }
+
+    return read;
+}
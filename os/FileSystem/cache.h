@@ -0,0 +1,36 @@
+/*
+ * cache.h
+ *
+ */
+
+#define CACHE_BLOCKS 128
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 32
+#define HOT_FILE "simdisk.hot"
+
+// Reads a block through the block cache
+int getCached(int blockID, char* block);
+
+// Reads a run of blocks into the block cache in a single request
+int prefetchBlocks(int blockID, int count);
+
+// Keeps the cached copy of a block in step with a write to the disk
+void updateCached(int blockID, const char* block);
+
+// Empties the block cache
+void clearCache();
+
+// Sets how many blocks the next chain walks may read ahead
+void setReadAhead(int count);
+
+// Turns saving and reloading the hot blocks across mounts on or off
+void setWarmup(int enable);
+
+// Checks whether the hot blocks are saved and reloaded across mounts
+int isWarmup();
+
+// Saves the most used blocks to a side file, most used first
+int saveHotBlocks(const char* filename);
+
+// Reads the blocks listed in a side file into the block cache
+int warmCache(const char* filename);
@@ -0,0 +1,479 @@
+/*
+ * dedup.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "dirTree.h"
+#include "entry.h"
+#include "fControl.h"
+#include "dedup.h"
+#include "pathUtils.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "storeInt.h"
+
+/*
+ * Every file block records at REFS_P how many pointers lead to it.
+ * When deduplication is on, the content of every file block written is hashed,
+ * and a block identical to one already on disk is replaced by a pointer to it.
+ *
+ * A chain is a linked list, so a block can only be shared together with the
+ * rest of its chain: identical tails of files collapse into one. The starting
+ * block of a file is never shared, since it identifies the file.
+ */
+
+// Whether deduplication is on
+static int dedup = 0;
+
+// Open addressing table of content hashes to block ids, BLOCK_END when empty
+static unsigned int hashes[INDEX_SIZE];
+static int blocks[INDEX_SIZE];
+
+/*
+ * hash: FNV-1a hash of the content of a file block, ignoring its reference count and generation.
+ *
+ * @block       String      contents of the block
+ *
+ * return unsigned int:     the hash
+ */
+static unsigned int hash(const char* block) {
+    unsigned int h = 2166136261u;
+
+    for (int i = 0; i < GEN_P; i++) {
+        if (i != REFS_P) {
+            h = (h ^ (unsigned char) block[i]) * 16777619u;
+        }
+    }
+
+    return h;
+}
+
+/*
+ * same: Compares the content of two file blocks, ignoring their reference counts and generations.
+ *
+ * return 1:        the blocks hold the same content
+ * return 0:        the blocks differ
+ */
+static int same(const char* a, const char* b) {
+    return !memcmp(a, b, REFS_P) && !memcmp(&a[REFS_P + 1], &b[REFS_P + 1], GEN_P - REFS_P - 1);
+}
+
+/*
+ * insert: Records the content hash of a block in the index.
+ * A block with the same hash is replaced, since either one serves as the copy.
+ */
+static void insert(int blockID, const char* block) {
+    unsigned int h = hash(block);
+    unsigned int i = h % INDEX_SIZE;
+
+    for (int probe = 0; probe < INDEX_SIZE; probe++, i = (i + 1) % INDEX_SIZE) {
+        if (blocks[i] == BLOCK_END || blocks[i] == BLOCKS || blocks[i] == blockID || hashes[i] == h) {
+            hashes[i] = h;
+            blocks[i] = blockID;
+            return;
+        }
+    }
+}
+
+/*
+ * forget: Removes a block from the index.
+ * The slot is kept so that probing continues past it, but no longer matches.
+ */
+static void forget(int blockID) {
+    for (int i = 0; i < INDEX_SIZE; i++) {
+        if (blocks[i] == blockID) {
+            blocks[i] = BLOCKS;
+        }
+    }
+}
+
+/*
+ * lookup: Finds a block on disk holding the same content as a block.
+ *
+ * @duplicate   Integer Pointer     the block holding the same content
+ * @block       String              contents of the block
+ *
+ * return  0:                       found
+ * return -1:                       no such block
+ */
+static int lookup(int* duplicate, const char* block) {
+    unsigned int h = hash(block);
+    unsigned int i = h % INDEX_SIZE;
+
+    for (int probe = 0; probe < INDEX_SIZE && blocks[i] != BLOCK_END; probe++, i = (i + 1) % INDEX_SIZE) {
+        if (hashes[i] != h || blocks[i] == BLOCKS) {
+            continue;
+        }
+
+        // The index may be stale, so the candidate is always compared byte for byte
+        char candidate[BLOCK_SIZE];
+
+        if (get_block(blocks[i], candidate)) {
+            return -1;
+        }
+
+        if (same(block, candidate) && (unsigned char) candidate[REFS_P] < MAX_REFS) {
+            *duplicate = blocks[i];
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * addRef: Adds a pointer to a file block. A block shared with a snapshot is counted as
+ * well: the count is bookkeeping rather than data, and it must cover every pointer of the
+ * live tree once the snapshot is deleted.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving file block
+ * return -2:       error creating file block
+ */
+static int addRef(int blockID) {
+    if (blockID == BLOCK_END) {
+        return 0;
+    }
+
+    char block[BLOCK_SIZE];
+
+    if (get_block(blockID, block)) {
+        fprintf(stderr, "Error retrieving file block.\n");
+        return -1;
+    }
+
+    block[REFS_P]++;
+
+    if (put_block(blockID, block)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * indexDir: Adds every file block of a directory tree, except starting blocks, to the index.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving file block
+ */
+static int indexDir(int fcBlockID) {
+    char fcb[BLOCK_SIZE];
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        char* line = &fcb[i];
+
+        // Entries free or stored inline lead to no blocks
+        if ((line[TYPE_P] != FILE && line[TYPE_P] != DIRECTORY) || line[NAME_P] == '\0') {
+            continue;
+        }
+
+        char start[2];
+        start[0] = line[START_P];
+        start[1] = line[START_P + 1];
+
+        int blockID = decode_int(start);
+
+        if (line[TYPE_P] == DIRECTORY) {
+            if (indexDir(blockID)) {
+                return -1;
+            }
+
+            continue;
+        }
+
+        char block[BLOCK_SIZE];
+        char next[2];
+
+        for (int head = 1; blockID != BLOCK_END; head = 0) {
+            if (get_block(blockID, block)) {
+                fprintf(stderr, "Error retrieving file block.\n");
+                return -1;
+            }
+
+            if (!head) {
+                insert(blockID, block);
+            }
+
+            next[0] = block[NEXT_BLOCK];
+            next[1] = block[NEXT_BLOCK + 1];
+            blockID = decode_int(next);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * setDedup: Turns deduplication of file blocks on or off.
+ * Turning it on indexes every file block of the mounted tree in one pass.
+ *
+ * @enable      Integer     1 to turn deduplication on, 0 to turn it off
+ *
+ * return  0:               successful execution
+ * return -1:               error indexing the file blocks
+ */
+int setDedup(int enable) {
+    for (int i = 0; i < INDEX_SIZE; i++) {
+        blocks[i] = BLOCK_END;
+    }
+
+    dedup = 0;
+
+    if (enable) {
+        if (indexDir(getRoot())) {
+            fprintf(stderr, "Error indexing the file blocks.\n");
+            return -1;
+        }
+
+        dedup = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * isDedup: Checks whether deduplication of file blocks is on.
+ *
+ * return 1:        deduplication is on
+ * return 0:        deduplication is off
+ */
+int isDedup() {
+    return dedup;
+}
+
+/*
+ * isDuplicated: Checks whether a file block is referenced more than once.
+ *
+ * @block       String      contents of the block
+ *
+ * return 1:                more than one pointer leads to the block
+ * return 0:                the block is referenced once
+ */
+int isDuplicated(const char* block) {
+    return block[BLOCK_START] == FILE && (unsigned char) block[REFS_P] > 1;
+}
+
+/*
+ * splitBlock: Moves a file block referenced more than once to a private copy.
+ * The original loses a reference, and the block after it gains one from the copy.
+ * The caller is responsible for pointing the referrer of the block at the copy.
+ *
+ * @blockID     Integer Pointer     the duplicated block, replaced by the copy
+ * @block       String              contents of the duplicated block, made the contents of the copy
+ *
+ * return  0:                       successful execution
+ * return -1:                       error looking for a free block
+ * return -2:                       error creating file block
+ */
+int splitBlock(int* blockID, char* block) {
+    block[REFS_P]--;
+
+    if (put_block(*blockID, block)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -2;
+    }
+
+    char next[2];
+    next[0] = block[NEXT_BLOCK];
+    next[1] = block[NEXT_BLOCK + 1];
+
+    if (addRef(decode_int(next))) {
+        return -2;
+    }
+
+    if (copyOnWrite(blockID, block)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * dedupChain: Points a chain at existing copies of its blocks wherever possible.
+ * The chain is finalised from its last block back to its first, since a block can
+ * only be shared once the block after it is. The first block is never shared.
+ * Blocks replaced by a copy are marked free, and their successors lose a reference.
+ *
+ * @chain       Array of pending    the blocks of the chain, in order
+ * @count       Integer             number of blocks in the chain
+ *
+ * return  0:                       successful execution
+ * return -1:                       error updating a reference count
+ */
+int dedupChain(struct pending* chain, int count) {
+    if (!dedup) {
+        return 0;
+    }
+
+    for (int i = count - 1; i > 0; i--) {
+        char* block = chain[i].block;
+        int duplicate;
+
+        if (!chain[i].dirty || lookup(&duplicate, block) || duplicate == chain[i].blockID) {
+            if (chain[i].dirty) {
+                insert(chain[i].blockID, block);
+            }
+
+            continue;
+        }
+
+        int inChain = 0;
+
+        for (int j = 0; j < count; j++) {
+            inChain |= chain[j].blockID == duplicate;
+        }
+
+        if (inChain) {
+            insert(chain[i].blockID, block);
+            continue;
+        }
+
+        char next[2];
+        next[0] = block[NEXT_BLOCK];
+        next[1] = block[NEXT_BLOCK + 1];
+
+        // The duplicate gains the pointer to this block, and the block after loses this block's pointer
+        if (addRef(duplicate) || releaseChain(decode_int(next))) {
+            fprintf(stderr, "Error updating a reference count.\n");
+            return -1;
+        }
+
+        forget(chain[i].blockID);
+        block[BLOCK_START] = FREE;
+
+        char* _duplicate = encode_int(duplicate);
+        chain[i - 1].block[NEXT_BLOCK] = _duplicate[0];
+        chain[i - 1].block[NEXT_BLOCK + 1] = _duplicate[1];
+        chain[i - 1].dirty = 1;
+        free(_duplicate);
+    }
+
+    return 0;
+}
+
+/*
+ * dropReference: Takes a pointer away from a file block in memory, freeing the block once
+ * nothing refers to it. The caller writes the block back.
+ * A block shared with a snapshot is left alone, but no longer offered for deduplication.
+ *
+ * @blockID     Integer     the block to release
+ * @block       String      contents of the block
+ *
+ * return  1:               the block was freed, so the block after it loses a pointer in turn
+ * return  0:               the block is still referenced
+ * return -1:               the block is shared with a snapshot, and is unchanged
+ */
+int dropReference(int blockID, char* block) {
+    if (isShared(block)) {
+        // The snapshots may be all that hold the block now, and a live chain must not be deduped onto it
+        if (dedup) {
+            forget(blockID);
+        }
+
+        return -1;
+    }
+
+    if (isDuplicated(block)) {
+        block[REFS_P]--;
+    } else {
+        // Label the block as free
+        block[BLOCK_START] = FREE;
+
+        if (dedup) {
+            forget(blockID);
+        }
+    }
+
+    return block[BLOCK_START] == FREE;
+}
+
+/*
+ * releaseBlock: Takes a pointer away from a file block, freeing the block once nothing refers to it.
+ * A block shared with a snapshot is left alone.
+ *
+ * @blockID     Integer     the block to release
+ * @block       String      contents of the block
+ *
+ * return  1:               the block was freed, so the block after it loses a pointer in turn
+ * return  0:               the block is still referenced
+ * return -2:               error creating file block
+ */
+int releaseBlock(int blockID, char* block) {
+    int freed = dropReference(blockID, block);
+
+    if (freed < 0) {
+        return 0;
+    }
+
+    if (put_block(blockID, block)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -2;
+    }
+
+    return freed;
+}
+
+/*
+ * releaseChain: Releases a chain of file blocks, from a block to the end of its chain.
+ * Each block loses a reference. A block no longer referenced is freed and the block after it
+ * is released in turn. Blocks shared with a snapshot are left alone, along with the rest of the chain.
+ *
+ * @blockID     Integer     the first block to release, or BLOCK_END
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving file block
+ * return -2:               error creating file block
+ */
+int releaseChain(int blockID) {
+    char (*blocks)[BLOCK_SIZE] = malloc(BLOCKS * BLOCK_SIZE);
+    struct request writes[BLOCKS];
+    int count = 0;
+    int result = 0;
+
+    // The blocks are read one after the other, and written back together once the chain is walked
+    while (blockID != BLOCK_END && count < BLOCKS) {
+        char* block = blocks[count];
+
+        if (get_block(blockID, block)) {
+            fprintf(stderr, "Error retrieving file block.\n");
+            result = -1;
+            break;
+        }
+
+        int freed = dropReference(blockID, block);
+
+        if (freed < 0) {
+            break;
+        }
+
+        writes[count].blockID = blockID;
+        writes[count].write = WRITE_REQUEST;
+        writes[count++].buffer = block;
+
+        if (!freed) {
+            break;
+        }
+
+        // Get the next referenced block
+        blockID = decode_int(&block[NEXT_BLOCK]);
+    }
+
+    if (submitBatch(writes, count)) {
+        fprintf(stderr, "Error creating file block.\n");
+        result = -2;
+    }
+
+    free(blocks);
+    return result;
+}
@@ -0,0 +1,38 @@
+/*
+ * dedup.h
+ *
+ */
+
+#define INDEX_SIZE 1024
+#define MAX_REFS 255
+
+// Blocks written back by writeChain once the chain is final
+struct pending {
+    int blockID;                // where the block is written
+    int dirty;                  // whether the block differs from the disk
+    char block[BLOCK_SIZE];     // contents of the block
+};
+
+// Turns deduplication of file blocks on or off
+int setDedup(int enable);
+
+// Checks whether deduplication of file blocks is on
+int isDedup();
+
+// Checks whether a file block is referenced more than once
+int isDuplicated(const char* block);
+
+// Moves a file block referenced more than once to a private copy
+int splitBlock(int* blockID, char* block);
+
+// Points a chain at existing copies of its blocks wherever possible
+int dedupChain(struct pending* chain, int count);
+
+// Takes a pointer away from a file block, freeing the block once nothing refers to it
+int releaseBlock(int blockID, char* block);
+
+// Takes a pointer away from a file block in memory, leaving the write to the caller
+int dropReference(int blockID, char* block);
+
+// Releases a chain of file blocks, freeing the blocks no longer referenced
+int releaseChain(int blockID);
@@ -0,0 +1,440 @@
+/*
+ * defrag.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "blockio.h"
+#include "cache.h"
+#include "fileSystem.h"
+#include "dedup.h"
+#include "defrag.h"
+#include "dirTree.h"
+#include "entry.h"
+#include "fControl.h"
+#include "openFiles.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "storeInt.h"
+
+/*
+ * A file chain is fragmented wherever a block is not followed by the block right after it
+ * on disk. The fragmentation score is the share of the links of every chain in the live tree
+ * that jump, from 0 for contiguous chains to 1 for chains that jump at every block.
+ *
+ * A fragmented chain is copied into a run of free blocks, linked one after the other,
+ * and written with one request. Only then is its entry pointed at the copy and the old
+ * blocks freed, so a crash part way leaves either the old chain or the new one, never
+ * a mix. Open files follow their chain to the copy. Chains with blocks shared with a
+ * snapshot or deduplicated with another file are left where they are, and so is a chain
+ * for which no run of free blocks is long enough.
+ *
+ * Directories are moved to the free block nearest their parent, when it is nearer than
+ * where they are, so that a lookup sweeps forward instead of seeking back and forth.
+ */
+
+// Contents and location of the chain being walked
+static char chain[BLOCKS][BLOCK_SIZE];
+static int chainIDs[BLOCKS];
+
+/*
+ * walkChain: Reads a file chain into memory.
+ *
+ * @start       Integer     the starting block of the chain
+ *
+ * return int:              number of blocks in the chain
+ * return -1:               error retrieving file block
+ * return -2:               the chain loops or leaves the disk
+ */
+static int walkChain(int start) {
+    int count = 0;
+
+    for (int blockID = start; blockID != BLOCK_END; count++) {
+        if (count == BLOCKS || blockID < 0 || blockID >= BLOCKS) {
+            fprintf(stderr, "The chain starting at block %d is broken.\n", start);
+            return -2;
+        }
+
+        if (getCached(blockID, chain[count])) {
+            fprintf(stderr, "Error retrieving file block.\n");
+            return -1;
+        }
+
+        chainIDs[count] = blockID;
+        blockID = decode_int(&chain[count][NEXT_BLOCK]);
+    }
+
+    return count;
+}
+
+/*
+ * countBreaks: Counts the links of the chain just walked that jump.
+ */
+static int countBreaks(int count) {
+    int breaks = 0;
+
+    for (int k = 1; k < count; k++) {
+        breaks += chainIDs[k] != chainIDs[k - 1] + 1;
+    }
+
+    return breaks;
+}
+
+/*
+ * setStart: Points an entry of a fcb at a new starting block.
+ *
+ * @fcBlockID   Integer     the fcb
+ * @position    Integer     position of the entry in the fcb
+ * @start       Integer     the new starting block
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving the file control block
+ * return -2:               error creating file control block
+ */
+static int setStart(int fcBlockID, int position, int start) {
+    char fcb[BLOCK_SIZE];
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    char* code = encode_int(start);
+    fcb[position + START_P] = code[0];
+    fcb[position + START_P + 1] = code[1];
+    free(code);
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * measureDir: Counts the links, and the links that jump, of every file chain below a directory.
+ *
+ * @links       Integer Pointer     links counted so far
+ * @breaks      Integer Pointer     links that jump counted so far
+ * @fcBlockID   Integer             the directory
+ * @depth       Integer             how many directories lie above it
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving file block
+ * return -2:                       a chain or the tree loops
+ */
+static int measureDir(int* links, int* breaks, int fcBlockID, int depth) {
+    char fcb[BLOCK_SIZE];
+
+    if (depth == BLOCKS) {
+        fprintf(stderr, "The directory tree loops.\n");
+        return -2;
+    }
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        char* line = &fcb[i];
+
+        // Entries free or stored inline lead to no blocks
+        if ((line[TYPE_P] != FILE && line[TYPE_P] != DIRECTORY) || line[NAME_P] == '\0') {
+            continue;
+        }
+
+        int start = decode_int(&line[START_P]);
+        int result;
+
+        if (line[TYPE_P] == DIRECTORY) {
+            result = measureDir(links, breaks, start, depth + 1);
+        } else if ((result = walkChain(start)) > 0) {
+            *links += result - 1;
+            *breaks += countBreaks(result);
+            result = 0;
+        }
+
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * moveChain: Copies a fragmented file chain into a run of free blocks and frees the old blocks.
+ *
+ * @fcBlockID   Integer     the parent fcb of the file
+ * @position    Integer     position of the entry of the file in the fcb
+ * @start       Integer     the starting block of the file
+ *
+ * return  1:               the chain was moved
+ * return  0:               the chain is contiguous, shared, or has nowhere to go
+ * return -1:               error retrieving file block
+ * return -2:               error creating file block
+ */
+static int moveChain(int fcBlockID, int position, int start) {
+    int count = walkChain(start);
+
+    if (count < 0) {
+        return -1;
+    }
+
+    if (countBreaks(count) == 0) {
+        return 0;
+    }
+
+    for (int k = 0; k < count; k++) {
+        if (isShared(chain[k]) || isDuplicated(chain[k])) {
+            return 0;
+        }
+    }
+
+    int run[BLOCKS];
+
+    switch (getFreeRun(run, count, start)) {
+        case 0:
+            break;
+        case -1:
+            return 0;
+        default:
+            return -1;
+    }
+
+    // Link the copies one after the other
+    for (int k = 0; k < count; k++) {
+        char* next = encode_int(k + 1 < count ? run[k + 1] : BLOCK_END);
+        chain[k][NEXT_BLOCK] = next[0];
+        chain[k][NEXT_BLOCK + 1] = next[1];
+        free(next);
+    }
+
+    if (put_run(run[0], count, chain[0])) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -2;
+    }
+
+    int result = setStart(fcBlockID, position, run[0]);
+
+    if (result) {
+        return result;
+    }
+
+    renumber(start, run[0]);
+
+    // The old chain is unreachable now, and is freed in one batch
+    struct request writes[BLOCKS];
+
+    for (int k = 0; k < count; k++) {
+        chain[k][BLOCK_START] = FREE;
+
+        writes[k].blockID = chainIDs[k];
+        writes[k].write = WRITE_REQUEST;
+        writes[k].buffer = chain[k];
+    }
+
+    if (submitBatch(writes, count)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -2;
+    }
+
+    return 1;
+}
+
+/*
+ * moveDirectory: Moves a directory to the free block nearest its parent,
+ * if that is nearer than where it is.
+ *
+ * @fcBlockID   Integer     the parent fcb of the directory
+ * @position    Integer     position of the entry of the directory in the fcb
+ * @start       Integer     the block of the directory
+ *
+ * return  1:               the directory was moved
+ * return  0:               the directory is shared, or no nearer block is free
+ * return -1:               error retrieving file block
+ * return -2:               error creating file block
+ */
+static int moveDirectory(int fcBlockID, int position, int start) {
+    char block[BLOCK_SIZE];
+    int target;
+
+    if (getFCB(start, block)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    if (isShared(block)) {
+        return 0;
+    }
+
+    switch (getFreeBlock(&target, fcBlockID)) {
+        case 0:
+            break;
+        case -1:
+            return 0;
+        default:
+            return -1;
+    }
+
+    if (abs(target - fcBlockID) >= abs(start - fcBlockID)) {
+        return 0;
+    }
+
+    if (putFCB(target, block)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -2;
+    }
+
+    int result = setStart(fcBlockID, position, target);
+
+    if (result) {
+        return result;
+    }
+
+    // Open files stored inline in the directory move with it
+    renumber(start, target);
+
+    for (int j = ENTRY_START; j + ENTRY_LENGTH <= GEN_P; j += ENTRY_LENGTH) {
+        renumber(INLINE_ID(start, j), INLINE_ID(target, j));
+    }
+
+    block[BLOCK_START] = FREE;
+
+    if (putFCB(start, block)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -2;
+    }
+
+    return 1;
+}
+
+/*
+ * defragDir: Moves the fragmented chains, and optionally the directories, below a directory.
+ *
+ * @fcBlockID   Integer     the directory
+ * @directories Integer     1 to move directories nearer their parents as well
+ * @depth       Integer     how many directories lie above it
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving file block
+ * return -2:               error creating file block
+ */
+static int defragDir(int fcBlockID, int directories, int depth) {
+    char fcb[BLOCK_SIZE];
+
+    if (depth == BLOCKS) {
+        fprintf(stderr, "The directory tree loops.\n");
+        return -1;
+    }
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+
+        // The fcb is read again for every entry, since moving an entry rewrites it
+        if (getFCB(fcBlockID, fcb)) {
+            fprintf(stderr, "Error retrieving the file control block.\n");
+            return -1;
+        }
+
+        char* line = &fcb[i];
+
+        if ((line[TYPE_P] != FILE && line[TYPE_P] != DIRECTORY) || line[NAME_P] == '\0') {
+            continue;
+        }
+
+        int type = line[TYPE_P];
+        int start = decode_int(&line[START_P]);
+        int result = 0;
+
+        // The entries of a directory shared with a snapshot cannot be repointed
+        if (isShared(fcb)) {
+            result = 0;
+        } else if (type == FILE) {
+            result = moveChain(fcBlockID, i, start);
+        } else if (directories) {
+            result = moveDirectory(fcBlockID, i, start);
+        }
+
+        if (result < 0) {
+            return result;
+        }
+
+        if (type == DIRECTORY) {
+            // A directory that moved is walked at its new block
+            if (result == 1) {
+                if (getFCB(fcBlockID, fcb)) {
+                    fprintf(stderr, "Error retrieving the file control block.\n");
+                    return -1;
+                }
+
+                start = decode_int(&fcb[i + START_P]);
+            }
+
+            if ((result = defragDir(start, directories, depth + 1))) {
+                return result;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * measureFragmentation: Measures how fragmented the file chains of the live tree are.
+ *
+ * @score       Double Pointer  share of the links of every chain that jump, or NULL
+ *
+ * return  0:                   successful execution
+ * return -1:                   error retrieving file block
+ * return -2:                   a chain or the tree loops
+ */
+int measureFragmentation(double* score) {
+    int links = 0;
+    int breaks = 0;
+    int result = measureDir(&links, &breaks, getRoot(), 0);
+
+    if (result == 0 && score != NULL) {
+        *score = links > 0 ? (double) breaks / links : 0;
+    }
+
+    return result;
+}
+
+/*
+ * defragment: Rewrites the fragmented file chains of the live tree into contiguous runs,
+ * and optionally moves every directory nearer its parent.
+ *
+ * @directories Integer         1 to move directories as well as file chains
+ * @before      Double Pointer  the fragmentation score before, or NULL
+ * @after       Double Pointer  the fragmentation score after, or NULL
+ *
+ * return  0:                   successful execution
+ * return -1:                   error measuring the fragmentation
+ * return -2:                   error moving the blocks
+ */
+int defragment(int directories, double* before, double* after) {
+    if (measureFragmentation(before)) {
+        fprintf(stderr, "Error measuring the fragmentation.\n");
+        return -1;
+    }
+
+    if (defragDir(getRoot(), directories, 0)) {
+        fprintf(stderr, "Error moving the blocks.\n");
+        return -2;
+    }
+
+    // The deduplication index still points at the blocks that were moved
+    if (isDedup() && setDedup(1)) {
+        return -2;
+    }
+
+    if (measureFragmentation(after)) {
+        fprintf(stderr, "Error measuring the fragmentation.\n");
+        return -1;
+    }
+
+    return 0;
+}
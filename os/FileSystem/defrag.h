@@ -0,0 +1,10 @@
+/*
+ * defrag.h
+ *
+ */
+
+// Measures how fragmented the file chains of the live tree are
+int measureFragmentation(double* score);
+
+// Rewrites fragmented file chains, and optionally directories, into contiguous runs
+int defragment(int directories, double* before, double* after);
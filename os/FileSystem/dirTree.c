@@ -0,0 +1,190 @@
+/*
+ * dirTree.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "cache.h"
+#include "entry.h"
+#include "fControl.h"
+#include "fileSystem.h"
+#include "dirTree.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "storeInt.h"
+
+/*
+ * When preloading is on, every directory of the mounted tree is read once and kept in memory,
+ * indexed by block id. Lookups are then served from memory, and writes go through to disk.
+ * Directories outside the mounted tree are added the first time they are read.
+ *
+ * Every write to a directory block, including the one freeing it, goes through putFCB,
+ * so a block held in memory is never stale. Only directory blocks are held.
+ */
+
+// Whether the directory tree is on
+static int preload = 0;
+
+// Contents of the directory blocks held in memory
+static char tree[BLOCKS][BLOCK_SIZE];
+
+// Whether each block is held in memory
+static char held[BLOCKS];
+
+// Bumped whenever the copy of a block held in memory changes
+static unsigned int versions[BLOCKS];
+
+/*
+ * hold: Keeps a copy of a block in memory if it is a directory, dropping it otherwise.
+ */
+static void hold(int blockID, const char* block) {
+    held[blockID] = block[BLOCK_START] == DIRECTORY;
+    versions[blockID]++;
+
+    if (held[blockID]) {
+        memcpy(tree[blockID], block, BLOCK_SIZE);
+    }
+}
+
+/*
+ * loadDir: Reads a directory and every directory below it into memory.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the file control block
+ */
+static int loadDir(int fcBlockID) {
+    char fcb[BLOCK_SIZE];
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        char* line = &fcb[i];
+
+        if (line[TYPE_P] != DIRECTORY || line[NAME_P] == '\0') {
+            continue;
+        }
+
+        char start[2];
+        start[0] = line[START_P];
+        start[1] = line[START_P + 1];
+
+        if (loadDir(decode_int(start))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * setPreload: Turns the in-memory directory tree on or off.
+ * Turning it on reads every directory of the mounted tree in one pass.
+ *
+ * @enable      Integer     1 to hold the directory tree in memory, 0 to read every fcb from disk
+ *
+ * return  0:               successful execution
+ * return -1:               error reading the directory tree
+ */
+int setPreload(int enable) {
+    memset(held, 0, BLOCKS);
+    preload = enable;
+
+    if (enable && loadDir(getRoot())) {
+        memset(held, 0, BLOCKS);
+        preload = 0;
+
+        fprintf(stderr, "Error reading the directory tree.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * isPreloaded: Checks whether the in-memory directory tree is on.
+ *
+ * return 1:        lookups are served from memory
+ * return 0:        lookups read from disk
+ */
+int isPreloaded() {
+    return preload;
+}
+
+/*
+ * getFCB: Reads a fcb, from memory when the directory tree holds it.
+ * Any other block is read through the block cache.
+ *
+ * @blockID     Integer     the block to read
+ * @fcb         String      where the contents of the block are read to
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving the block
+ */
+int getFCB(int blockID, char* fcb) {
+    if (preload && blockID >= 0 && blockID < BLOCKS && held[blockID]) {
+        memcpy(fcb, tree[blockID], BLOCK_SIZE);
+        countCache(1);
+        return 0;
+    }
+
+    // The block cache counts its own hits and misses
+    if (getCached(blockID, fcb)) {
+        return -1;
+    }
+
+    if (preload) {
+        hold(blockID, fcb);
+    }
+
+    return 0;
+}
+
+/*
+ * putFCB: Writes a fcb through to disk, keeping the directory tree in step.
+ * A block that stops being a directory is dropped from memory.
+ *
+ * @blockID     Integer     the block to write
+ * @fcb         String      the new contents of the block
+ *
+ * return  0:               successful execution
+ * return -1:               error creating the block
+ */
+int putFCB(int blockID, char* fcb) {
+    if (put_block(blockID, fcb)) {
+        return -1;
+    }
+
+    if (preload) {
+        hold(blockID, fcb);
+    }
+
+    return 0;
+}
+
+/*
+ * getVersion: Gets the version of a fcb held in memory. Whatever is derived from a fcb
+ * held in memory stays valid for as long as its version does not change.
+ *
+ * @blockID     Integer     the block
+ *
+ * return unsigned int:     the version, never 0 for a block held in memory
+ * return 0:                the block is not held in memory
+ */
+unsigned int getVersion(int blockID) {
+    if (!preload || blockID < 0 || blockID >= BLOCKS || !held[blockID]) {
+        return 0;
+    }
+
+    // Skip 0 when the counter wraps around
+    if (versions[blockID] == 0) {
+        versions[blockID]++;
+    }
+
+    return versions[blockID];
+}
@@ -0,0 +1,19 @@
+/*
+ * dirTree.h
+ *
+ */
+
+// Turns the in-memory directory tree on or off
+int setPreload(int enable);
+
+// Checks whether the in-memory directory tree is on
+int isPreloaded();
+
+// Reads a fcb, from memory when the directory tree holds it
+int getFCB(int blockID, char* fcb);
+
+// Writes a fcb through to disk, keeping the directory tree in step
+int putFCB(int blockID, char* fcb);
+
+// Gets the version of a fcb held in memory, or 0
+unsigned int getVersion(int blockID);
@@ -3,341 +3,1512 @@
  *
  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "blockio.h"
+#include "cache.h"
 #include "entry.h"
 #include "fControl.h"
+#include "dirTree.h"
 #include "fileSystem.h"
+#include "openFiles.h"
 #include "pathUtils.h"
+#include "reclaim.h"
+#include "snapshot.h"
+#include "stats.h"
 #include "storeInt.h"
+#include "superblock.h"
+#include "trace.h"
 
 /*
- * getFreeBlock: find a free block in the file system
+ * A file smaller than INLINE_MAX bytes has no blocks of its own. Its entry is typed
+ * INLINE_FILE, holds the length of the file in place of the starting block, and is
+ * followed by just enough INLINE_DATA slots to hold the data:
+ *
+ *      INLINE_FILE     name    length
+ *      INLINE_DATA     8 bytes of data
+ *      ...
+ *
+ * An open inline file is identified by INLINE_ID, built from its fcb and the
+ * position of its entry, which is never a valid block id.
+ */
+
+/*
+ * Names are looked up in lanes: every slot of a fcb gets a 64-bit lane holding its name,
+ * zero-padded, with the last byte set when the slot names a file. The name searched for is
+ * padded the same way, so one compare per lane tells whether the slot is the file, and the
+ * lanes of a fcb are compared several at a time. Lanes of the fcbs held by the directory
+ * tree are kept, and rebuilt only when the fcb changes. Building them costs more than a
+ * plain scan of the slots, so a fcb that is not held in memory is scanned slot by slot.
+ */
+
+// Lanes of every fcb, and the version of the fcb they were built from
+static uint64_t lanes[BLOCKS][NAME_LANES];
+static unsigned int laneVersions[BLOCKS];
+
+/*
+ * laneOf: Pads a name into a lane.
+ *
+ * @name        String      the name, ended by a null char or after six chars
+ *
+ * return uint64_t:         the lane
+ */
+static uint64_t laneOf(const char* name) {
+    unsigned char bytes[sizeof(uint64_t)] = {0};
+
+    for (int i = 0; i < MAX_DIRNAME - 1 && name[i] != '\0'; i++) {
+        bytes[i] = name[i];
+    }
+
+    bytes[sizeof(uint64_t) - 1] = 1;
+
+    uint64_t lane;
+    memcpy(&lane, bytes, sizeof(uint64_t));
+
+    return lane;
+}
+
+/*
+ * buildLanes: Builds the lanes of a fcb. Slots that name no file get an empty lane,
+ * which never matches a name.
+ */
+static void buildLanes(uint64_t* slotLanes, const char* fcb) {
+    for (int k = 0; k < NAME_LANES; k++) {
+        slotLanes[k] = 0;
+
+        if (k >= ENTRY_SLOTS) {
+            continue;
+        }
+
+        const char* line = &fcb[ENTRY_START + k * ENTRY_LENGTH];
+
+        if (line[NAME_P] == '\0') {
+            continue;
+        }
+
+        if (line[TYPE_P] == FILE || line[TYPE_P] == DIRECTORY || line[TYPE_P] == INLINE_FILE) {
+            slotLanes[k] = laneOf(&line[NAME_P]);
+        }
+    }
+}
+
+/*
+ * matches: Checks whether an entry of a fcb names a file component.
+ * Names are stored zero-padded, so the whole name field is compared at once.
+ *
+ * @line        String      the entry
+ * @padded      String      name of the file component, zero-padded to START_P - NAME_P chars
+ *
+ * return 1:                the entry is the file component
+ * return 0:                the entry is free, holds inline data, or has another name
+ */
+static int matches(const char* line, const char* padded) {
+    if (line[TYPE_P] != FILE && line[TYPE_P] != DIRECTORY && line[TYPE_P] != INLINE_FILE) {
+        return 0;
+    }
+
+    return !memcmp(&line[NAME_P], padded, START_P - NAME_P);
+}
+
+/*
+ * scanLanes: Compares a lane against every lane of a fcb.
+ *
+ * return int:      the first slot whose lane is equal
+ * return -1:       no lane is equal
+ */
+static int scanLanes(const uint64_t* slotLanes, uint64_t key) {
+#if defined(__AVX2__)
+    __m256i keys = _mm256_set1_epi64x((long long) key);
+
+    for (int k = 0; k < NAME_LANES; k += 4) {
+        __m256i equal = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i*) &slotLanes[k]), keys);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(equal));
+
+        for (int j = 0; j < 4; j++) {
+            if (mask & (1 << j)) {
+                return k + j;
+            }
+        }
+    }
+#elif defined(__SSE2__)
+    __m128i keys = _mm_set1_epi64x((long long) key);
+
+    for (int k = 0; k < NAME_LANES; k += 2) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) &slotLanes[k]), keys));
+
+        if ((mask & 0xFF) == 0xFF) {
+            return k;
+        }
+
+        if ((mask & 0xFF00) == 0xFF00) {
+            return k + 1;
+        }
+    }
+#else
+    for (int k = 0; k < NAME_LANES; k++) {
+        if (slotLanes[k] == key) {
+            return k;
+        }
+    }
+#endif
+
+    return -1;
+}
+
+/*
+ * findEntry: Finds the entry of a fcb that names a file component.
+ *
+ * @fcb         String      the file control block
+ * @name        String      name of the file component
+ * @fcBlockID   Integer     the fcb as read from the directory tree, or -1 for a copy being changed
+ *
+ * return int:              position of the entry
+ * return -1:               no entry names the file component
+ */
+static int findEntry(const char* fcb, const char* name, int fcBlockID) {
+    if (name[0] == '\0' || strlen(name) > MAX_DIRNAME - 1) {
+        return -1;
+    }
+
+    unsigned int version = fcBlockID < 0 ? 0 : getVersion(fcBlockID);
+
+    // Lanes that would be thrown away after one lookup are not worth building
+    if (version == 0) {
+        char padded[START_P - NAME_P] = {0};
+        memcpy(padded, name, strlen(name));
+
+        for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+            if (matches(&fcb[i], padded)) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    uint64_t* slotLanes = lanes[fcBlockID];
+
+    if (laneVersions[fcBlockID] != version) {
+        buildLanes(slotLanes, fcb);
+        laneVersions[fcBlockID] = version;
+    }
+
+    int k = scanLanes(slotLanes, laneOf(name));
+
+    return k < 0 ? -1 : ENTRY_START + k * ENTRY_LENGTH;
+}
+
+/*
+ * isFree: Checks whether a slot of a fcb can take an entry.
+ * Slots past the end marker have never been written and are all zero.
+ */
+static int isFree(const char* line) {
+    return line[TYPE_P] == ENTRY_END || (line[TYPE_P] == FILE && line[NAME_P] == '\0');
+}
+
+/*
+ * markEnd: Marks a slot of a fcb as the end of the entries, if it has never been written.
+ */
+static void markEnd(char* fcb, int position) {
+    if (position + ENTRY_LENGTH <= GEN_P && fcb[position + TYPE_P] == FILE && fcb[position + NAME_P] == '\0') {
+        fcb[position] = ENTRY_END;
+    }
+}
+
+/*
+ * clearSlot: Frees a slot of a fcb.
+ */
+static void clearSlot(char* fcb, int position) {
+    fcb[position] = ENTRY_END;
+
+    for (int j = position + 1; j < position + ENTRY_LENGTH; j++) {
+        fcb[j] = '\0';
+    }
+}
+
+/*
+ * findRun: Finds consecutive free slots in a fcb.
+ *
+ * @position    Integer Pointer     position of the first slot of the run
+ * @fcb         String              the file control block
+ * @needed      Integer             how many slots are needed
+ * @preferred   Integer             position tried before any other
+ *
+ * return  0:                       successful execution
+ * return -1:                       no run of free slots is long enough
+ */
+static int findRun(int* position, const char* fcb, int needed, int preferred) {
+    int run = 0;
+
+    for (int i = preferred; i + ENTRY_LENGTH <= GEN_P && run < needed && isFree(&fcb[i]); i += ENTRY_LENGTH) {
+        run++;
+    }
+
+    if (run == needed) {
+        *position = preferred;
+        return 0;
+    }
+
+    run = 0;
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        if (!isFree(&fcb[i])) {
+            run = 0;
+            continue;
+        }
+
+        if (++run == needed) {
+            *position = i - (needed - 1) * ENTRY_LENGTH;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * slotsFor: Counts the INLINE_DATA slots needed to hold length bytes.
+ */
+static int slotsFor(int length) {
+    return (length + ENTRY_LENGTH - 2) / (ENTRY_LENGTH - 1);
+}
+
+/*
+ * fillInline: Stores the length and data of a file stored inline in its entry and the slots after it.
+ *
+ * precondition: the slots needed after the entry are free or already hold the data of the file
+ */
+static void fillInline(char* fcb, int position, const char* data, int length) {
+    int slots = slotsFor(length);
+
+    char* _length = encode_int(length);
+    fcb[position + START_P] = _length[0];
+    fcb[position + START_P + 1] = _length[1];
+
+    for (int k = 1; k <= slots; k++) {
+        char* line = &fcb[position + k * ENTRY_LENGTH];
+        int copied = (k - 1) * (ENTRY_LENGTH - 1);
+        int run = length - copied;
+
+        if (run > ENTRY_LENGTH - 1) {
+            run = ENTRY_LENGTH - 1;
+        }
+
+        memset(line, 0, ENTRY_LENGTH);
+        line[TYPE_P] = INLINE_DATA;
+        memcpy(&line[1], &data[copied], run);
+    }
+
+    markEnd(fcb, position + (slots + 1) * ENTRY_LENGTH);
+}
+
+/*
+ * locate: Retrieves the fcb holding a file stored inline.
+ *
+ * @fcb         String              contents of the fcb
+ * @fcBlockID   Integer Pointer     location of the fcb
+ * @position    Integer Pointer     position of the entry of the file in the fcb
+ * @blockID     Integer             the inline id of the file
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the file control block
+ * return -2:                       the entry does not hold a file stored inline
+ */
+static int locate(char* fcb, int* fcBlockID, int* position, int blockID) {
+    *fcBlockID = (blockID - BLOCKS) / BLOCK_SIZE;
+    *position = (blockID - BLOCKS) % BLOCK_SIZE;
+
+    if (getFCB(*fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    if (fcb[*position + TYPE_P] != INLINE_FILE) {
+        fprintf(stderr, "Error finding entry in the file control block.\n");
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * searchOrder: Orders the blocks of the disk by distance from a placement hint.
+ * The disk is split into groups of BLOCK_GROUP blocks. The group holding the hint
+ * comes first, starting at the hint, then the groups on either side of it,
+ * alternating outward. Within a group, blocks come in increasing order.
+ *
+ * @order       Integer Array       the blocks of the disk, BLOCKS long
+ * @hint        Integer             the block to search from
+ */
+static void searchOrder(int* order, int hint) {
+    int n = 0;
+
+    if (hint < ROOT_BLOCKID || hint >= BLOCKS) {
+        hint = ROOT_BLOCKID;
+    }
+
+    int group = hint / BLOCK_GROUP;
+
+    for (int i = hint; i < (group + 1) * BLOCK_GROUP && i < BLOCKS; i++) {
+        order[n++] = i;
+    }
+
+    for (int i = group * BLOCK_GROUP; i < hint; i++) {
+        order[n++] = i;
+    }
+
+    for (int distance = 1; n < BLOCKS; distance++) {
+        int sides[2] = {group + distance, group - distance};
+
+        for (int k = 0; k < 2; k++) {
+            if (sides[k] < 0 || sides[k] * BLOCK_GROUP >= BLOCKS) {
+                continue;
+            }
+
+            for (int i = sides[k] * BLOCK_GROUP; i < (sides[k] + 1) * BLOCK_GROUP && i < BLOCKS; i++) {
+                order[n++] = i;
+            }
+        }
+    }
+}
+
+/*
+ * getFreeBlock: find a free block in the file system, as close to a placement hint as possible
  *
  * @blockID     Integer Pointer     location of the next free block
+ * @hint        Integer             the block to search from: the parent fcb of a new entry,
+ *                                  or the previous block of a chain
+ *
+ * return  0:                       successful execution
+ * return -1:                       error finding free block
+ * return -2:                       error reading block
+ */
+int getFreeBlock(int* blockID, int hint) {
+    return getFreeBlocks(blockID, 1, hint);
+}
+
+/*
+ * getFreeBlocks: find several free blocks in the file system in a single pass,
+ * as close to a placement hint as possible. Orphaned chains are reclaimed when too few are free.
+ *
+ * @blockIDs    Integer Array       locations of the free blocks, nearest first
+ * @count       Integer             how many free blocks are needed
+ * @hint        Integer             the block to search from
+ *
+ * return  0:                       successful execution
+ * return -1:                       not enough free blocks
+ * return -2:                       error reading block
+ */
+int getFreeBlocks(int* blockIDs, int count, int hint) {
+    TRACE("getFreeBlocks");
+
+    char block[BLOCK_SIZE];
+    int order[BLOCKS];
+    int found = 0;
+
+    countAllocation();
+    searchOrder(order, hint);
+
+    for (int n = 0; n < BLOCKS && found < count; n++) {
+
+        // A block not formatted yet is free without being read
+        if (!isFormatted(order[n])) {
+            blockIDs[found++] = order[n];
+            continue;
+        }
+
+        if (get_block(order[n], block)) {
+            fprintf(stderr, "Error reading block %d.\n", order[n]);
+            return -2;
+        }
+
+        if (block[0] == FREE) {
+            blockIDs[found++] = order[n];
+        }
+    }
+
+    if (found < count) {
+
+        // Blocks of deleted files may still be waiting for the reclaimer
+        if (reclaimBlocks(0) > 0) {
+            return getFreeBlocks(blockIDs, count, hint);
+        }
+
+        return -1;
+    }
+
+    if (formatBlocks(blockIDs, count)) {
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * getFreeRun: find several consecutive free blocks in the file system,
+ * starting as close to a placement hint as possible
+ *
+ * @blockIDs    Integer Array       locations of the free blocks, in increasing order
+ * @count       Integer             how many free blocks are needed
+ * @hint        Integer             the block to search from
+ *
+ * return  0:                       successful execution
+ * return -1:                       no run of free blocks is long enough
+ * return -2:                       error reading block
+ */
+int getFreeRun(int* blockIDs, int count, int hint) {
+    TRACE("getFreeRun");
+
+    char block[BLOCK_SIZE];
+    int order[BLOCKS];
+
+    // Whether each block is free: -1 until the block is read
+    int freeAt[BLOCKS];
+
+    countAllocation();
+
+    for (int i = 0; i < BLOCKS; i++) {
+        freeAt[i] = -1;
+    }
+
+    searchOrder(order, hint);
+
+    for (int n = 0; n < BLOCKS; n++) {
+        int first = order[n];
+        int run = 0;
+
+        while (run < count && first + run < BLOCKS) {
+            int i = first + run;
+
+            if (freeAt[i] == -1 && !isFormatted(i)) {
+                freeAt[i] = 1;
+            } else if (freeAt[i] == -1) {
+                if (get_block(i, block)) {
+                    fprintf(stderr, "Error reading block %d.\n", i);
+                    return -2;
+                }
+
+                freeAt[i] = block[0] == FREE;
+            }
+
+            if (!freeAt[i]) {
+                break;
+            }
+
+            run++;
+        }
+
+        if (run == count) {
+            for (int i = 0; i < count; i++) {
+                blockIDs[i] = first + i;
+            }
+
+            if (formatBlocks(blockIDs, count)) {
+                return -2;
+            }
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * evictInline: Moves the data of one file stored inline in a fcb out to a block of its own,
+ * freeing its data slots. The fcb is written back, and open files follow the file.
+ *
+ * @fcb         String      the file control block, updated in place
+ * @fcBlockID   Integer     location of the file control block
+ *
+ * return  0:               successful execution
+ * return -1:               no file in the fcb holds inline data
+ * return -2:               error creating file block
+ */
+static int evictInline(char* fcb, int fcBlockID) {
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        if (fcb[i + TYPE_P] != INLINE_FILE || fcb[i + ENTRY_LENGTH + TYPE_P] != INLINE_DATA) {
+            continue;
+        }
+
+        char data[INLINE_MAX];
+        int length;
+        int start;
+
+        if (getInline(data, &length, INLINE_ID(fcBlockID, i)) || createBlock(&start, fcBlockID, data, length)) {
+            return -2;
+        }
+
+        for (int k = slotsFor(length); k > 0; k--) {
+            clearSlot(fcb, i + k * ENTRY_LENGTH);
+        }
+
+        char* _start = encode_int(start);
+        fcb[i + TYPE_P] = FILE;
+        fcb[i + START_P] = _start[0];
+        fcb[i + START_P + 1] = _start[1];
+
+        if (putFCB(fcBlockID, fcb)) {
+            fprintf(stderr, "Error creating file control block.\n");
+            return -2;
+        }
+
+        renumber(INLINE_ID(fcBlockID, i), start);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * getEntryPoint: find the next position in the file control block where entries can be added.
+ * Inline data is moved out to blocks until there is room.
+ *
+ * @position    Integer Pointer     position in the file control block
+ * @fcb         String              the file control block
+ * @fcBlockID   Integer             location of the file control block
+ * @slots       Integer             how many consecutive slots are needed
+ *
+ * return  0:                       successful execution
+ * return -1:                       error finding available entry point in the file control block
+ */
+int getEntryPoint(int* position, char* fcb, int fcBlockID, int slots) {
+    while (findRun(position, fcb, slots, ENTRY_START)) {
+        if (evictInline(fcb, fcBlockID)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * addEntry: Adds an entry to a fcb.
+ * The starting block of a directory is found close to the fcb; the caller creates it.
+ *
+ * @start:      Integer Pointer     location of the starting block
+ * @fcBlockID:  Integer             the target fcb id
+ * @name:       String              name of the entry
+ * @type:       Integer             type of the entry
+ *
+ * return  0:                       successful execution
+ * return -1:                       file already exists in directory
+ * return -2:                       error retrieving the parent file control block
+ * return -3:                       error looking for a free block
+ * return -4:                       error finding entry in the file control block
+ * return -5:                       error creating file control block
+ */
+int addEntry(int* start, int fcBlockID, char* name, int type) {
+    TRACE("addEntry");
+
+    return addEntries(start, fcBlockID, &name, 1, type);
+}
+
+/*
+ * linkEntry: Adds an entry for an existing starting block to a fcb.
+ *
+ * @start:      Integer             location of the starting block
+ * @fcBlockID:  Integer             the target fcb id
+ * @name:       String              name of the entry
+ * @type:       Integer             type of the entry
+ *
+ * return  0:                       successful execution
+ * return -1:                       file already exists in directory
+ * return -2:                       error retrieving the parent file control block
+ * return -3:                       error finding entry in the file control block
+ * return -4:                       error creating file control block
+ */
+int linkEntry(int start, int fcBlockID, char* name, int type) {
+    /* best case:
+     *      block: [1, a, b, c, d, e, f, ... ]
+     * average case:
+     *      block: [1, a, b, c, 0, 0, 0, ... ]
+     * worst case:
+     *      block: [1, 0, 0, 0, 0, 0, 0, ... ]
+     *
+     * Therefore, 7 chars must be skipped before any useful data is reached.
+     */
+
+    // A file stored inline carries its data along
+    if (isInline(start)) {
+        char data[INLINE_MAX];
+        int length;
+
+        if (getInline(data, &length, start)) {
+            fprintf(stderr, "Error retrieving the parent file control block.\n");
+            return -2;
+        }
+
+        int result = addInline(fcBlockID, name, data, length);
+
+        if (result != -3) {
+            return result;
+        }
+
+        // Without room for the data next to the entry, the file moves out to a block
+        if (createBlock(&start, fcBlockID, data, length)) {
+            fprintf(stderr, "Error finding entry in the file control block.\n");
+            return -3;
+        }
+
+        result = linkEntry(start, fcBlockID, name, type);
+
+        if (result) {
+            char block[BLOCK_SIZE];
+            memset(block, 0, BLOCK_SIZE);
+            block[BLOCK_START] = FREE;
+            put_block(start, block);
+        }
+
+        return result;
+    }
+
+    int existing;
+
+    if (getStart(&existing, fcBlockID, name) != -2) {
+        fprintf(stderr, "File already exists in directory.\n");
+        return -1;
+    }
+
+    char* fcb = malloc(BLOCK_SIZE);
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the parent file control block.\n");
+        return -2;
+    }
+
+    // Position in the file control block
+    int position;
+
+    if (getEntryPoint(&position, fcb, fcBlockID, 1)) {
+        fprintf(stderr, "Error finding entry in the file control block.\n");
+        return -3;
+    }
+
+    /*
+     * order of file attributes:
+     *      type    name    start
+     */
+
+    fcb[position++] = type;
+
+    for (unsigned int i = 0; i < strlen(name); i++) {
+        fcb[i + position] = name[i];
+    }
+
+    position += MAX_DIRNAME - 1;
+
+    char* _start = encode_int(start);
+
+    for (int i = 0; i < START; i++) {
+        fcb[i + position] = _start[i];
+    }
+
+    position += START;
+
+    // Mark the following slot as the end of the entries, if there is one
+    markEnd(fcb, position);
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -4;
+    }
+
+    return 0;
+}
+
+/*
+ * removeEntry: Removes an entry from a fcb.
+ *
+ * @start:      Integer Pointer     location of the starting block
+ * @fcBlockID:  Integer             the target fcb id
+ * @name:       String              name of the entry
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the parent file control block
+ * return -2:                       error finding entry in the file control block
+ * return -3:                       error creating file control block
+ */
+int removeEntry(int* start, int fcBlockID, const char* name) {
+    TRACE("removeEntry");
+
+    char* fcb = malloc(BLOCK_SIZE);
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the parent file control block.\n");
+        return -1;
+    }
+
+    int i = findEntry(fcb, name, fcBlockID);
+
+    if (i < 0) {
+        fprintf(stderr, "Error finding entry in the file control block.\n");
+        return -2;
+    }
+
+    char* line = &fcb[i];
+    char _start[2];
+    _start[0] = line[START_P];
+    _start[1] = line[START_P + 1];
+
+    *start = decode_int(_start);
+
+    // The data of a file stored inline goes with its entry
+    if (line[TYPE_P] == INLINE_FILE) {
+        for (int k = slotsFor(*start); k > 0; k--) {
+            clearSlot(fcb, i + k * ENTRY_LENGTH);
+        }
+
+        *start = INLINE_ID(fcBlockID, i);
+    }
+
+    clearSlot(fcb, i);
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -3;
+    }
+
+    return 0;
+}
+
+/*
+ * renameEntry: Gives an entry of a fcb a new name, leaving it in its slot.
+ * The entry keeps its starting block, and a file stored inline keeps its data slots.
+ *
+ * @fcBlockID:  Integer             the target fcb id
+ * @name:       String              name of the entry
+ * @newName:    String              the new name of the entry
+ *
+ * return  0:                       successful execution
+ * return -1:                       file already exists in directory
+ * return -2:                       error retrieving the parent file control block
+ * return -3:                       error finding entry in the file control block
+ * return -4:                       error creating file control block
+ */
+int renameEntry(int fcBlockID, const char* name, const char* newName) {
+    TRACE("renameEntry");
+
+    char fcb[BLOCK_SIZE];
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the parent file control block.\n");
+        return -2;
+    }
+
+    int i = findEntry(fcb, name, fcBlockID);
+
+    if (i < 0) {
+        fprintf(stderr, "Error finding entry in the file control block.\n");
+        return -3;
+    }
+
+    // Names are cut to fit an entry, so the cut name must not belong to another entry either
+    char padded[START_P - NAME_P + 1] = {0};
+    strncpy(padded, newName, START_P - NAME_P);
+
+    int existing = findEntry(fcb, padded, fcBlockID);
+
+    if (findEntry(fcb, newName, fcBlockID) >= 0 || (existing >= 0 && existing != i)) {
+        fprintf(stderr, "File already exists in directory.\n");
+        return -1;
+    }
+
+    memcpy(&fcb[i + NAME_P], padded, START_P - NAME_P);
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -4;
+    }
+
+    return 0;
+}
+
+/*
+ * unshareEntry: Points an entry of a fcb at a private copy of its starting block.
+ * Nothing is copied if the starting block is not shared with a snapshot.
+ *
+ * precondition: the fcb itself is not shared with a snapshot
+ *
+ * @start:      Integer Pointer     location of the private starting block
+ * @fcBlockID:  Integer             the target fcb id
+ * @name:       String              name of the entry
+ *
+ * return  0:                       successful execution
+ * return -1:                       error finding entry in the file control block
+ * return -2:                       error retrieving file block
+ * return -3:                       error copying the starting block
+ * return -4:                       error creating file control block
+ */
+int unshareEntry(int* start, int fcBlockID, const char* name) {
+    TRACE("unshareEntry");
+
+    char* fcb = malloc(BLOCK_SIZE);
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -2;
+    }
+
+    int i = findEntry(fcb, name, fcBlockID);
+
+    if (i < 0) {
+        fprintf(stderr, "Error finding entry in the file control block.\n");
+        return -1;
+    }
+
+    char* line = &fcb[i];
+
+    // A file stored inline is private along with its fcb
+    if (line[TYPE_P] == INLINE_FILE) {
+        *start = INLINE_ID(fcBlockID, i);
+        return 0;
+    }
+
+    char _start[2];
+    _start[0] = line[START_P];
+    _start[1] = line[START_P + 1];
+
+    *start = decode_int(_start);
+
+    char block[BLOCK_SIZE];
+
+    if (getCached(*start, block)) {
+        fprintf(stderr, "Error retrieving file block.\n");
+        return -2;
+    }
+
+    if (!isShared(block)) {
+        return 0;
+    }
+
+    int shared = *start;
+
+    if (copyOnWrite(start, block)) {
+        fprintf(stderr, "Error copying the starting block.\n");
+        return -3;
+    }
+
+    // Open files stored inline in a copied directory move with it
+    if (block[BLOCK_START] == DIRECTORY) {
+        for (int j = ENTRY_START; j + ENTRY_LENGTH <= GEN_P; j += ENTRY_LENGTH) {
+            renumber(INLINE_ID(shared, j), INLINE_ID(*start, j));
+        }
+    }
+
+    char* copy = encode_int(*start);
+    line[START_P] = copy[0];
+    line[START_P + 1] = copy[1];
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -4;
+    }
+
+    return 0;
+}
+
+/*
+ * getType: Get the file type
+ *
+ * @type        Integer Pointer     the file type
+ * @blockID     Integer             the starting block id of the file
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the parent file control block
+ */
+int getType(int* type, int blockID) {
+    if (isInline(blockID)) {
+        *type = FILE;
+        return 0;
+    }
+
+    char* block = malloc(BLOCK_SIZE);
+
+    if (getFCB(blockID, block)) {
+        fprintf(stderr, "Error retrieving the parent file control block.\n");
+        return -1;
+    }
+
+    *type = block[BLOCK_START];
+
+    return 0;
+}
+
+/*
+ * getTypeFromFCB: Get the file type of a file from the fcb
+ *
+ * precondition: length of name is of valid length
+ *
+ * @type        Integer Pointer     file type
+ * @fcBlockID   Integer             location of the file control block
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the file control block
+ * return -2:                       error finding entry in the file control block
+ */
+int getTypeFromFCB(int* type, int fcBlockID, const char* name) {
+    TRACE("getTypeFromFCB");
+
+    if (fcBlockID == ROOT_BLOCKID && !strcmp(name, ROOT)) {
+        *type = DIRECTORY;
+        return 0;
+    } else {
+        char* fcb = malloc(BLOCK_SIZE);
+
+        if (getFCB(fcBlockID, fcb)) {
+            fprintf(stderr, "Error retrieving the file control block.\n");
+            return -1;
+        }
+
+        int i = findEntry(fcb, name, fcBlockID);
+
+        if (i >= 0) {
+            *type = fcb[i + TYPE_P] == INLINE_FILE ? FILE : fcb[i + TYPE_P];
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Error finding entry in the file control block.\n");
+    return -2;
+}
+
+/*
+ * getStart: Get the starting block of the file path component from the file control block.
+ *
+ * precondition: length of name is of valid length
+ *
+ * @block       Integer Pointer     starting block id of the file component
+ * @fcBlock     Integer             the file control block id
+ * @name        String              the file component
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the file control block
+ * return -2:                       error finding entry in the file control block
+ */
+int getStart(int* blockID, int fcBlockID, const char* name) {
+    TRACE("getStart");
+
+    if (fcBlockID == ROOT_BLOCKID && !strcmp(name, ROOT)) {
+        *blockID = ROOT_BLOCKID;
+        return 0;
+    }
+
+    char* fcb = malloc(BLOCK_SIZE);
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    int i = findEntry(fcb, name, fcBlockID);
+
+    if (i < 0) {
+        return -2;
+    }
+
+    if (fcb[i + TYPE_P] == INLINE_FILE) {
+        *blockID = INLINE_ID(fcBlockID, i);
+        return 0;
+    }
+
+    char start[2];
+    start[0] = fcb[i + START_P];
+    start[1] = fcb[i + START_P + 1];
+
+    *blockID = decode_int(start);
+    return 0;
+}
+
+/*
+ * getSize: Get file size of a regular file.
+ *
+ * precondition: length of name is of valid length
+ *
+ * @size      Integer Pointer   file size
+ * @blockID   Integer           location of the starting block of a file
  *
- * return  0:                       successful execution
- * return -1:                       error finding free block
- * return -2:                       error reading block
+ * return  0:                   successful execution
+ * return -1:                   error retrieving the file control block
  */
-int getFreeBlock(int* blockID) {
-    char* block = malloc(BLOCK_SIZE);
+int getSize(int* size, int blockID) {
+    TRACE("getSize");
 
-    for (int i = ROOT_BLOCKID; i < BLOCKS; i++) {
-        if (get_block(i, block)) {
-            fprintf(stderr, "Error reading block %d.\n", i);
-            return -2;
-        }
+    if (isInline(blockID)) {
+        char data[INLINE_MAX];
+        return getInline(data, size, blockID) ? -1 : 0;
+    }
 
-        if (block[0] == FREE) {
-            *blockID = i;
-            return 0;
+    *size = 0;
+    char block[BLOCK_SIZE];
+    char next[2];
+
+    // Every block records how many of its data bytes are in use
+    do {
+        if (getCached(blockID, block)) {
+            fprintf(stderr, "Error retrieving the file control block.\n");
+            return -1;
         }
-    }
 
-    return -1;
+        *size += (unsigned char) block[FILL_P];
+
+        next[0] = block[NEXT_BLOCK];
+        next[1] = block[NEXT_BLOCK + 1];
+
+        blockID = decode_int(next);
+    } while (blockID != BLOCK_END);
+
+    return 0;
 }
 
 /*
- * getEntryPoint: find the next position in the file control block where entries can be added.
+ * isInline: Checks whether a file is stored inline in its parent fcb.
  *
- * @position    Integer Pointer     position in the file control block
- * @fcb         String              the file control block
+ * @blockID     Integer     the starting block id, or inline id, of a file
  *
- * return  0:                       successful execution
- * return -1:                       error finding available entry point in the file control block
+ * return 1:                the file is stored inline
+ * return 0:                the file has a chain of blocks
  */
-int getEntryPoint(int* position, char* fcb) {
-
-    for (int i = ENTRY_START; i < BLOCK_SIZE; i += ENTRY_LENGTH) {
-        if (fcb[i] == ENTRY_END) {
-            *position = i;
-            return 0;
-        }
-    }
-
-    return -1;
+int isInline(int blockID) {
+    return blockID >= BLOCKS;
 }
 
 /*
- * addEntry: Adds an entry to a fcb.
+ * addInline: Adds an entry for a file stored inline to a fcb.
+ * The entry and its data slots take consecutive free slots.
+ *
+ * precondition: length is at most INLINE_MAX
  *
- * @start:      Integer Pointer     location of the starting block
  * @fcBlockID:  Integer             the target fcb id
  * @name:       String              name of the entry
- * @type:       Integer             type of the entry
+ * @data:       String              the data of the file
+ * @length:     Integer             length of the data
  *
  * return  0:                       successful execution
  * return -1:                       file already exists in directory
  * return -2:                       error retrieving the parent file control block
- * return -3:                       error looking for a free block
- * return -4:                       error finding entry in the file control block
- * return -5:                       error creating file control block
+ * return -3:                       error finding entry in the file control block
+ * return -4:                       error creating file control block
  */
-int addEntry(int* start, int fcBlockID, char* name, int type) {
-    /* best case:
-     *      block: [1, a, b, c, d, e, f, ... ]
-     * average case:
-     *      block: [1, a, b, c, 0, 0, 0, ... ]
-     * worst case:
-     *      block: [1, 0, 0, 0, 0, 0, 0, ... ]
-     *
-     * Therefore, 7 chars must be skipped before any useful data is reached.
-     */
+int addInline(int fcBlockID, char* name, const char* data, int length) {
+    int existing;
 
-    if (getStart(malloc(1), fcBlockID, name) != -2) {
+    if (getStart(&existing, fcBlockID, name) != -2) {
         fprintf(stderr, "File already exists in directory.\n");
         return -1;
     }
 
-    char* fcb = malloc(BLOCK_SIZE);
+    char fcb[BLOCK_SIZE];
 
-    if (get_block(fcBlockID, fcb)) {
+    if (getFCB(fcBlockID, fcb)) {
         fprintf(stderr, "Error retrieving the parent file control block.\n");
         return -2;
     }
 
-    if (getFreeBlock(start)) {
-        fprintf(stderr, "Error looking for a free block.\n");
+    int position;
+
+    if (getEntryPoint(&position, fcb, fcBlockID, 1 + slotsFor(length))) {
+        fprintf(stderr, "Error finding entry in the file control block.\n");
         return -3;
     }
 
-    // Position in the file control block
-    int position;
+    char* line = &fcb[position];
+    memset(line, 0, ENTRY_LENGTH);
+    line[TYPE_P] = INLINE_FILE;
+    strncpy(&line[NAME_P], name, MAX_DIRNAME - 1);
 
-    if (getEntryPoint(&position, fcb)) {
-        fprintf(stderr, "Error finding entry in the file control block.\n");
+    fillInline(fcb, position, data, length);
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
         return -4;
     }
 
-    /*
-     * order of file attributes:
-     *      type    name    start
-     */
+    return 0;
+}
 
-    fcb[position++] = type;
+/*
+ * getInline: Reads the data of a file stored inline.
+ *
+ * @data        String              where the data is read to, at least INLINE_MAX bytes long
+ * @length      Integer Pointer     length of the data
+ * @blockID     Integer             the inline id of the file
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the file control block
+ */
+int getInline(char* data, int* length, int blockID) {
+    char fcb[BLOCK_SIZE];
+    int fcBlockID;
+    int position;
 
-    for (unsigned int i = 0; i < strlen(name); i++) {
-        fcb[i + position] = name[i];
+    if (locate(fcb, &fcBlockID, &position, blockID)) {
+        return -1;
     }
 
-    position += MAX_DIRNAME - 1;
+    char _length[2];
+    _length[0] = fcb[position + START_P];
+    _length[1] = fcb[position + START_P + 1];
 
-    char* _start = encode_int(*start);
+    *length = decode_int(_length);
 
-    for (int i = 0; i < START; i++) {
-        fcb[i + position] = _start[i];
-    }
+    for (int copied = 0; copied < *length; copied += ENTRY_LENGTH - 1) {
+        position += ENTRY_LENGTH;
 
-    position += START;
+        int run = *length - copied;
 
-    if (fcb[position + 1] == '\0') {
-        fcb[position] = ENTRY_END;
-    }
+        if (run > ENTRY_LENGTH - 1) {
+            run = ENTRY_LENGTH - 1;
+        }
 
-    if (put_block(fcBlockID, fcb)) {
-        fprintf(stderr, "Error creating file control block.\n");
-        return -5;
+        memcpy(&data[copied], &fcb[position + 1], run);
     }
 
     return 0;
 }
 
 /*
- * removeEntry: Removes an entry from a fcb.
+ * setInline: Replaces the data of a file stored inline.
+ * The data stays next to the entry if the slots after it are free. Otherwise the
+ * entry moves to the first run of free slots in the fcb that can hold the data.
  *
- * @start:      Integer Pointer     location of the starting block
- * @fcBlockID:  Integer             the target fcb id
- * @name:       String              name of the entry
+ * precondition: length is at most INLINE_MAX
+ *
+ * @data        String              the new data of the file
+ * @length      Integer             length of the data
+ * @blockID     Integer Pointer     the inline id of the file, replaced if the entry moves
  *
  * return  0:                       successful execution
- * return -1:                       error retrieving the parent file control block
- * return -2:                       error finding entry in the file control block
- * return -3:                       error creating file control block
+ * return -1:                       error retrieving the file control block
+ * return -2:                       error creating file control block
+ * return -3:                       no room for the data in the file control block
  */
-int removeEntry(int* start, int fcBlockID, const char* name) {
-    char* fcb = malloc(BLOCK_SIZE);
+int setInline(const char* data, int length, int* blockID) {
+    char fcb[BLOCK_SIZE];
+    int fcBlockID;
+    int position;
 
-    if (get_block(fcBlockID, fcb)) {
-        fprintf(stderr, "Error retrieving the parent file control block.\n");
+    if (locate(fcb, &fcBlockID, &position, *blockID)) {
         return -1;
     }
 
-    for (int i = ENTRY_START; i < BLOCK_SIZE; i += ENTRY_LENGTH) {
-        char* line = &fcb[i];
-        char entryName[MAX_DIRNAME - 1];
-        strncpy(entryName, &line[NAME_P], MAX_DIRNAME - 1);
+    char entry[ENTRY_LENGTH];
+    memcpy(entry, &fcb[position], ENTRY_LENGTH);
 
-        if (!strcmp(entryName, name)) {
-            char _start[2];
-            _start[0] = line[START_P];
-            _start[1] = line[START_P + 1];
+    char _length[2];
+    _length[0] = entry[START_P];
+    _length[1] = entry[START_P + 1];
 
-            *start = decode_int(_start);
+    // The slots of the file are free to take again
+    for (int k = slotsFor(decode_int(_length)); k >= 0; k--) {
+        clearSlot(fcb, position + k * ENTRY_LENGTH);
+    }
 
-            fcb[i] = ENTRY_END;
+    int moved;
 
-            for (int j = i + 1; j < i + ENTRY_LENGTH + 1; j++) {
-                fcb[j] = '\0';
-            }
+    if (findRun(&moved, fcb, 1 + slotsFor(length), position)) {
+        fprintf(stderr, "No room for the data in the file control block.\n");
+        return -3;
+    }
 
-            if (put_block(fcBlockID, fcb)) {
-                fprintf(stderr, "Error creating file control block.\n");
-                return -3;
-            }
+    memcpy(&fcb[moved], entry, ENTRY_LENGTH);
+    fillInline(fcb, moved, data, length);
 
-            return 0;
-        }
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -2;
     }
 
-    fprintf(stderr, "Error finding entry in the file control block.\n");
-    return -2;
+    *blockID = INLINE_ID(fcBlockID, moved);
+
+    return 0;
 }
 
 /*
- * getType: Get the file type
+ * pointEntry: Points the entry of a file stored inline at a starting block.
+ * The data slots of the file are given back to the fcb.
  *
- * @type        Integer Pointer     the file type
- * @blockID     Integer             the starting block id of the file
+ * @blockID     Integer     the inline id of the file
+ * @start       Integer     location of the new starting block of the file
  *
- * return  0:                       successful execution
- * return -1:                       error retrieving the parent file control block
+ * return  0:               successful execution
+ * return -1:               error retrieving the file control block
+ * return -2:               error creating file control block
  */
-int getType(int* type, int blockID) {
-    char* block = malloc(BLOCK_SIZE);
+int pointEntry(int blockID, int start) {
+    char fcb[BLOCK_SIZE];
+    int fcBlockID;
+    int position;
 
-    if (get_block(blockID, block)) {
-        fprintf(stderr, "Error retrieving the parent file control block.\n");
+    if (locate(fcb, &fcBlockID, &position, blockID)) {
         return -1;
     }
 
-    *type = block[BLOCK_START];
+    char _length[2];
+    _length[0] = fcb[position + START_P];
+    _length[1] = fcb[position + START_P + 1];
+
+    for (int k = slotsFor(decode_int(_length)); k > 0; k--) {
+        clearSlot(fcb, position + k * ENTRY_LENGTH);
+    }
+
+    char* _start = encode_int(start);
+    fcb[position + TYPE_P] = FILE;
+    fcb[position + START_P] = _start[0];
+    fcb[position + START_P + 1] = _start[1];
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -2;
+    }
 
     return 0;
 }
 
 /*
- * getTypeFromFCB: Get the file type of a file from the fcb
+ * createBlock: Stores the data of a file stored inline in a fresh starting block,
+ * placed close to the fcb of the file.
  *
- * precondition: length of name is of valid length
+ * @start       Integer Pointer     location of the new starting block
+ * @fcBlockID   Integer             the fcb holding the file
+ * @data        String              the data of the file
+ * @length      Integer             length of the data
  *
- * @type        Integer Pointer     file type
- * @fcBlockID   Integer             location of the file control block
+ * return  0:                       successful execution
+ * return -1:                       error looking for a free block
+ * return -2:                       error creating file block
+ */
+int createBlock(int* start, int fcBlockID, const char* data, int length) {
+    if (getFreeBlock(start, fcBlockID)) {
+        fprintf(stderr, "Error looking for a free block.\n");
+        return -1;
+    }
+
+    char block[BLOCK_SIZE];
+    memset(block, 0, BLOCK_SIZE);
+
+    block[BLOCK_START] = FILE;
+    block[FILL_P] = length;
+    block[REFS_P] = 1;
+    block[GEN_P] = getGeneration();
+
+    char* next = encode_int(BLOCK_END);
+    block[NEXT_BLOCK] = next[0];
+    block[NEXT_BLOCK + 1] = next[1];
+
+    memcpy(&block[DATA_P], data, length);
+
+    if (put_block(*start, block)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * addEntries: Adds entries for several new files to a fcb, writing the fcb once.
+ * New regular files are stored inline. The starting blocks of new directories
+ * are allocated in a single pass over the disk; the caller creates them.
+ *
+ * @starts      Integer Array       locations of the starting blocks, or inline ids, of the files
+ * @fcBlockID   Integer             the target fcb id
+ * @names       Array of Strings    names of the entries
+ * @count       Integer             number of entries
+ * @type        Integer             type of every entry
  *
  * return  0:                       successful execution
- * return -1:                       error retrieving the file control block
- * return -2:                       error finding entry in the file control block
+ * return -1:                       file already exists in directory
+ * return -2:                       error retrieving the parent file control block
+ * return -3:                       error looking for free blocks
+ * return -4:                       error finding entry in the file control block
+ * return -5:                       error creating file control block
  */
-int getTypeFromFCB(int* type, int fcBlockID, const char* name) {
-    if (fcBlockID == ROOT_BLOCKID && !strcmp(name, ROOT)) {
-        *type = DIRECTORY;
-        return 0;
-    } else {
-        char* fcb = malloc(BLOCK_SIZE);
+int addEntries(int* starts, int fcBlockID, char** names, int count, int type) {
+    TRACE("addEntries");
 
-        if (get_block(fcBlockID, fcb)) {
-            fprintf(stderr, "Error retrieving the file control block.\n");
+    char fcb[BLOCK_SIZE];
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the parent file control block.\n");
+        return -2;
+    }
+
+    for (int n = 0; n < count; n++) {
+        if (findEntry(fcb, names[n], fcBlockID) >= 0) {
+            fprintf(stderr, "File already exists in directory.\n");
             return -1;
         }
 
-        for (int i = ENTRY_START; i < BLOCK_SIZE; i += ENTRY_LENGTH) {
-            char* line = &fcb[i];
-            char entryName[MAX_DIRNAME - 1];
-            strncpy(entryName, &line[NAME_P], MAX_DIRNAME - 1);
-
-            if (!strcmp(entryName, name)) {
-                *type = line[TYPE_P];
-                return 0;
+        for (int m = 0; m < n; m++) {
+            if (!strcmp(names[m], names[n])) {
+                fprintf(stderr, "File already exists in directory.\n");
+                return -1;
             }
         }
     }
 
-    fprintf(stderr, "Error finding entry in the file control block.\n");
-    return -2;
+    // Slots are claimed first, since making room may take blocks of its own
+    int* positions = malloc(count * sizeof(int));
+    int claimed = 0;
+    int result = 0;
+
+    for (; claimed < count; claimed++) {
+        if (getEntryPoint(&positions[claimed], fcb, fcBlockID, 1)) {
+            fprintf(stderr, "Error finding entry in the file control block.\n");
+            result = -4;
+            break;
+        }
+
+        char* line = &fcb[positions[claimed]];
+        memset(line, 0, ENTRY_LENGTH);
+        line[TYPE_P] = type == DIRECTORY ? DIRECTORY : INLINE_FILE;
+        strncpy(&line[NAME_P], names[claimed], MAX_DIRNAME - 1);
+        fillInline(fcb, positions[claimed], "", 0);
+    }
+
+    if (result == 0 && type == DIRECTORY && getFreeBlocks(starts, count, fcBlockID)) {
+        fprintf(stderr, "Error looking for free blocks.\n");
+        result = -3;
+    }
+
+    if (result) {
+        // Inline data moved out to make room stays moved out
+        for (int n = 0; n < claimed; n++) {
+            clearSlot(fcb, positions[n]);
+        }
+
+        putFCB(fcBlockID, fcb);
+        free(positions);
+        return result;
+    }
+
+    for (int n = 0; n < count; n++) {
+        char* line = &fcb[positions[n]];
+
+        if (type == DIRECTORY) {
+            char* _start = encode_int(starts[n]);
+            line[START_P] = _start[0];
+            line[START_P + 1] = _start[1];
+        } else {
+            starts[n] = INLINE_ID(fcBlockID, positions[n]);
+        }
+    }
+
+    free(positions);
+
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -5;
+    }
+
+    return 0;
 }
 
 /*
- * getStart: Get the starting block of the file path component from the file control block.
- *
- * precondition: length of name is of valid length
+ * findEntries: Finds the starting blocks and types of several entries of a fcb in one read.
  *
- * @block       Integer Pointer     starting block id of the file component
- * @fcBlock     Integer             the file control block id
- * @name        String              the file component
+ * @starts      Integer Array       locations of the starting blocks, or inline ids, of the files
+ * @types       Integer Array       types of the files
+ * @fcBlockID   Integer             the fcb id
+ * @names       Array of Strings    names of the entries
+ * @count       Integer             number of entries
  *
  * return  0:                       successful execution
  * return -1:                       error retrieving the file control block
  * return -2:                       error finding entry in the file control block
  */
-int getStart(int* blockID, int fcBlockID, const char* name) {
-    if (fcBlockID == ROOT_BLOCKID && !strcmp(name, ROOT)) {
-        *blockID = ROOT_BLOCKID;
-        return 0;
-    }
+int findEntries(int* starts, int* types, int fcBlockID, char** names, int count) {
+    TRACE("findEntries");
 
-    char* fcb = malloc(BLOCK_SIZE);
+    char fcb[BLOCK_SIZE];
 
-    if (get_block(fcBlockID, fcb)) {
+    if (getFCB(fcBlockID, fcb)) {
         fprintf(stderr, "Error retrieving the file control block.\n");
         return -1;
     }
 
-    for (int i = ENTRY_START; i < BLOCK_SIZE; i += ENTRY_LENGTH) {
-        char* line = &fcb[i];
-        char entryName[MAX_DIRNAME - 1];
-        strncpy(entryName, &line[NAME_P], MAX_DIRNAME - 1);
-
-        if (!strcmp(entryName, name)) {
-            char start[2];
-            start[0] = line[START_P];
-            start[1] = line[START_P + 1];
+    for (int n = 0; n < count; n++) {
+        int i = findEntry(fcb, names[n], fcBlockID);
 
-            *blockID = decode_int(start);
-            return 0;
+        if (i < 0) {
+            fprintf(stderr, "Error finding entry in the file control block.\n");
+            return -2;
         }
+
+        char* line = &fcb[i];
+        char start[2];
+        start[0] = line[START_P];
+        start[1] = line[START_P + 1];
+
+        starts[n] = line[TYPE_P] == INLINE_FILE ? INLINE_ID(fcBlockID, i) : decode_int(start);
+        types[n] = line[TYPE_P] == INLINE_FILE ? FILE : line[TYPE_P];
     }
 
-    return -2;
+    return 0;
 }
 
 /*
- * getSize: Get file size of a regular file.
+ * removeEntries: Removes several entries from a fcb, writing the fcb once.
+ * Nothing is removed unless every entry is found.
  *
- * precondition: length of name is of valid length
- *
- * @size      Integer Pointer   file size
- * @blockID   Integer           location of the starting block of a file
+ * @fcBlockID   Integer             the target fcb id
+ * @names       Array of Strings    names of the entries
+ * @count       Integer             number of entries
  *
- * return  0:                   successful execution
- * return -1:                   error retrieving the file control block
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the parent file control block
+ * return -2:                       error finding entry in the file control block
+ * return -3:                       error creating file control block
  */
-int getSize(int* size, int blockID) {
-    *size = 0;
-    char* block;
-    char next[2];
+int removeEntries(int fcBlockID, char** names, int count) {
+    TRACE("removeEntries");
 
-    do {
-        block = malloc(BLOCK_SIZE);
+    char fcb[BLOCK_SIZE];
 
-        if (get_block(blockID, block)) {
-            fprintf(stderr, "Error retrieving the file control block.\n");
-            return -1;
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the parent file control block.\n");
+        return -1;
+    }
+
+    for (int n = 0; n < count; n++) {
+
+        // The fcb changes as entries are removed, so its lanes are built afresh
+        int i = findEntry(fcb, names[n], -1);
+
+        if (i < 0) {
+            fprintf(stderr, "Error finding entry in the file control block.\n");
+            return -2;
         }
 
-        next[0] = block[NEXT_BLOCK];
-        next[1] = block[NEXT_BLOCK + 1];
+        char* line = &fcb[i];
 
-        blockID = decode_int(next);
-    } while (blockID != BLOCK_END && (*size += BLOCK_SIZE - 3));
+        // The data of a file stored inline goes with its entry
+        if (line[TYPE_P] == INLINE_FILE) {
+            char _length[2];
+            _length[0] = line[START_P];
+            _length[1] = line[START_P + 1];
 
-    int p = BLOCK_SIZE - 1;
+            for (int k = slotsFor(decode_int(_length)); k > 0; k--) {
+                clearSlot(fcb, i + k * ENTRY_LENGTH);
+            }
+        }
 
-    while (block[p--] == '\0') {
+        clearSlot(fcb, i);
     }
 
-    *size += --p;
+    if (putFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -3;
+    }
 
     return 0;
 }
@@ -11,17 +11,54 @@
 #define TYPE_P 0
 #define NAME_P 1
 #define START_P 7
-#define DATA_P 3
+#define FILL_P 3
+#define REFS_P 4
+#define DATA_P 5
+#define GEN_P (BLOCK_SIZE - 1)
 
-// Find a free block in the file system
-int getFreeBlock(int* blockID);
+#define BLOCK_GROUP 32
+#define ENTRY_SLOTS ((GEN_P - ENTRY_START) / ENTRY_LENGTH)
+#define NAME_LANES 16
+
+#define INLINE_FILE 3
+#define INLINE_DATA 4
+#define INLINE_SLOTS 3
+#define INLINE_MAX (INLINE_SLOTS * (ENTRY_LENGTH - 1))
+#define INLINE_ID(fcBlockID, position) (BLOCKS + (fcBlockID) * BLOCK_SIZE + (position))
+
+// Find a free block in the file system, close to a placement hint
+int getFreeBlock(int* blockID, int hint);
+
+// Find several free blocks in the file system in a single pass, close to a placement hint
+int getFreeBlocks(int* blockIDs, int count, int hint);
+
+// Find several consecutive free blocks in the file system, close to a placement hint
+int getFreeRun(int* blockIDs, int count, int hint);
 
 // Adds an entry to a fcb
 int addEntry(int* start, int fcBlockID, char* name, int type);
 
+// Adds an entry for an existing starting block to a fcb
+int linkEntry(int start, int fcBlockID, char* name, int type);
+
 // Removes an entry from a fcb
 int removeEntry(int* start, int fcBlockID, const char* name);
 
+// Gives an entry of a fcb a new name in place
+int renameEntry(int fcBlockID, const char* name, const char* newName);
+
+// Adds entries for several new files to a fcb, writing the fcb once
+int addEntries(int* starts, int fcBlockID, char** names, int count, int type);
+
+// Finds the starting blocks and types of several entries of a fcb in one read
+int findEntries(int* starts, int* types, int fcBlockID, char** names, int count);
+
+// Removes several entries from a fcb, writing the fcb once
+int removeEntries(int fcBlockID, char** names, int count);
+
+// Points an entry of a fcb at a private copy of its starting block
+int unshareEntry(int* start, int fcBlockID, const char* name);
+
 // Get the file type
 int getType(int* type, int blockID);
 
@@ -33,3 +70,21 @@ int getStart(int* blockID, int fcBlockID, const char* name);
 
 // Get file size of a regular file
 int getSize(int* size, int blockID);
+
+// Checks whether a file is stored inline in its parent fcb
+int isInline(int blockID);
+
+// Adds an entry for a file stored inline to a fcb
+int addInline(int fcBlockID, char* name, const char* data, int length);
+
+// Reads the data of a file stored inline
+int getInline(char* data, int* length, int blockID);
+
+// Replaces the data of a file stored inline, moving its entry if needed
+int setInline(const char* data, int length, int* blockID);
+
+// Points the entry of a file stored inline at a starting block
+int pointEntry(int blockID, int start);
+
+// Stores the data of a file stored inline in a fresh starting block
+int createBlock(int* start, int fcBlockID, const char* data, int length);
@@ -7,12 +7,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include "blockio.h"
+#include "cache.h"
 #include "fControl.h"
+#include "dirTree.h"
 #include "fileSystem.h"
 #include "openFiles.h"
 #include "pathUtils.h"
+#include "dedup.h"
+#include "reclaim.h"
+#include "snapshot.h"
 #include "storeInt.h"
 #include "entry.h"
+#include "scheduler.h"
+#include "trace.h"
 
 /*
  * createRoot: Creates the root directory.
@@ -21,12 +28,13 @@
  * return -1:       error creating file block
  */
 int createRoot() {
-    char* block = malloc(BLOCK_SIZE);
+    char* block = calloc(BLOCK_SIZE, 1);
 
     block[BLOCK_START] = DIRECTORY;
     block[ENTRY_START] = ENTRY_END;
+    block[GEN_P] = getGeneration();
 
-    if (put_block(ROOT_BLOCKID, block)) {
+    if (putFCB(ROOT_BLOCKID, block)) {
         fprintf(stderr, "Error creating file block.\n");
         return -1;
     }
@@ -48,6 +56,8 @@ int createRoot() {
  * return -3:                       error creating file block
  */
 int createFCB(int parentFCBID, char* name) {
+    TRACE("createFCB");
+
     if (parentFCBID == ROOT_BLOCKID && !strcmp(name, ROOT)) {
         if (createRoot()) {
             fprintf(stderr, "Error in creating root directory.\n");
@@ -64,12 +74,13 @@ int createFCB(int parentFCBID, char* name) {
         return -2;
     }
 
-    char* block = malloc(BLOCK_SIZE);
+    char* block = calloc(BLOCK_SIZE, 1);
 
     block[BLOCK_START] = DIRECTORY;
     block[ENTRY_START] = ENTRY_END;
+    block[GEN_P] = getGeneration();
 
-    if (put_block(startingBlockID, block)) {
+    if (putFCB(startingBlockID, block)) {
         fprintf(stderr, "Error creating file block.\n");
         return -3;
     }
@@ -79,6 +90,7 @@ int createFCB(int parentFCBID, char* name) {
 
 /*
  * createFile: Creates a file.
+ * A new file is empty, so it is stored inline in the fcb and takes no block.
  *
  * precondition: length of name is of valid length
  *
@@ -87,30 +99,15 @@ int createFCB(int parentFCBID, char* name) {
  *
  * return  0:               successful execution
  * return -1:               error adding entry to file control block
- * return -2:               error creating file block
  */
 int createFile(int fcBlockID, char* name) {
-    int startingBlockID;
+    TRACE("createFile");
 
-    if (addEntry(&startingBlockID, fcBlockID, name, 0)) {
+    if (addInline(fcBlockID, name, "", 0)) {
         fprintf(stderr, "Error adding entry to file control block.\n");
         return -1;
     }
 
-    char* block = malloc(BLOCK_SIZE);
-
-    block[BLOCK_START] = FILE;
-
-    char* next = encode_int(BLOCK_END);
-
-    block[NEXT_BLOCK] = next[0];
-    block[NEXT_BLOCK + 1] = next[1];
-
-    if (put_block(startingBlockID, block)) {
-        fprintf(stderr, "Error creating file block.\n");
-        return -2;
-    }
-
     return 0;
 }
 
@@ -130,6 +127,8 @@ int createFile(int fcBlockID, char* name) {
  * return -5:               error removing entry from the file control block
  */
 int deleteDir(int fcBlockID, const char* name) {
+    TRACE("deleteDir");
+
     int blockID;
 
     if (getStart(&blockID, fcBlockID, name)) {
@@ -139,23 +138,26 @@ int deleteDir(int fcBlockID, const char* name) {
 
     char* block = malloc(BLOCK_SIZE);
 
-    if (get_block(blockID, block)) {
+    if (getFCB(blockID, block)) {
         fprintf(stderr, "Error retrieving the file block.\n");
         return -2;
     }
 
-    for (int i = ENTRY_START; i < BLOCK_SIZE; i++) {
+    for (int i = ENTRY_START; i < GEN_P; i++) {
         if (block[i] != ENTRY_END && block[i] != '\0') {
             fprintf(stderr, "Directory is not empty.\n");
             return -3;
         }
     }
 
-    block[BLOCK_START] = FREE;
+    // A directory shared with a snapshot stays in place for the snapshot
+    if (!isShared(block)) {
+        block[BLOCK_START] = FREE;
 
-    if (put_block(blockID, block)) {
-        fprintf(stderr, "Error creating file block.\n");
-        return -4;
+        if (putFCB(blockID, block)) {
+            fprintf(stderr, "Error creating file block.\n");
+            return -4;
+        }
     }
 
     if (fcBlockID != ROOT_BLOCKID || strcmp(name, ROOT)) {
@@ -185,6 +187,8 @@ int deleteDir(int fcBlockID, const char* name) {
  * return -3:               error creating file block
  */
 int deleteFile(int fcBlockID, const char* name) {
+    TRACE("deleteFile");
+
     int currentBlock;
 
     // Remove references to the file from the parent file control block
@@ -196,31 +200,170 @@ int deleteFile(int fcBlockID, const char* name) {
     // Remove all entries referencing the deleted file from the file open table
     deleteAll(currentBlock);
 
-    do {
-        char* block = malloc(BLOCK_SIZE);
+    // A file stored inline went with its entry
+    if (isInline(currentBlock)) {
+        return 0;
+    }
 
-        if (get_block(currentBlock, block)) {
-            fprintf(stderr, "Error retrieving file block.\n");
+    // The blocks of the chain are freed later by the reclaimer
+    switch (orphanChain(currentBlock)) {
+        case 0:
+            break;
+        case -1:
             return -2;
-        }
+        default:
+            return -3;
+    }
 
-        // Label the block as free
-        block[BLOCK_START] = FREE;
+    return 0;
+}
+
+/*
+ * createBatch: Creates several files in the same directory.
+ * The fcb is written once, and the blocks of new directories are found in a single pass.
+ *
+ * precondition: length of every name is of valid length
+ *
+ * @fcBlockID   Integer             the parent file control block
+ * @names       Array of Strings    names of the files
+ * @count       Integer             number of files
+ * @type        Integer             type of every file
+ *
+ * return  0:                       successful execution
+ * return -1:                       error adding entries to file control block
+ * return -2:                       error creating file block
+ */
+int createBatch(int fcBlockID, char** names, int count, int type) {
+    TRACE("createBatch");
+
+    int* starts = malloc(count * sizeof(int));
+
+    if (addEntries(starts, fcBlockID, names, count, type)) {
+        fprintf(stderr, "Error adding entries to file control block.\n");
+        free(starts);
+        return -1;
+    }
+
+    char block[BLOCK_SIZE];
+
+    for (int n = 0; n < count && type == DIRECTORY; n++) {
+        memset(block, 0, BLOCK_SIZE);
+
+        block[BLOCK_START] = DIRECTORY;
+        block[ENTRY_START] = ENTRY_END;
+        block[GEN_P] = getGeneration();
 
-        if (put_block(currentBlock, block)) {
+        if (putFCB(starts[n], block)) {
             fprintf(stderr, "Error creating file block.\n");
-            return -3;
+            free(starts);
+            return -2;
         }
+    }
 
-        char next[2];
-        next[0] = block[NEXT_BLOCK];
-        next[1] = block[NEXT_BLOCK + 1];
+    free(starts);
+    return 0;
+}
+
+/*
+ * deleteBatch: Deletes several files from the same directory.
+ * The fcb is written once. Nothing is deleted if a file is missing or a directory is not empty.
+ *
+ * precondition: length of every name is of valid length
+ *
+ * @fcBlockID   Integer             the parent file control block
+ * @names       Array of Strings    names of the files
+ * @count       Integer             number of files
+ *
+ * return  0:                       successful execution
+ * return -1:                       error finding the position of the file block
+ * return -2:                       error retrieving the file block
+ * return -3:                       directory is not empty
+ * return -4:                       error creating file block
+ * return -5:                       error removing entries from the file control block
+ */
+int deleteBatch(int fcBlockID, char** names, int count) {
+    TRACE("deleteBatch");
 
-        // Get the next referenced block
-        currentBlock = decode_int(next);
-    } while (currentBlock != BLOCK_END);
+    int* starts = malloc(count * sizeof(int));
+    int* types = malloc(count * sizeof(int));
+    int result = 0;
 
-    return 0;
+    if (findEntries(starts, types, fcBlockID, names, count)) {
+        fprintf(stderr, "Error finding the position of the file block.\n");
+        result = -1;
+    }
+
+    char block[BLOCK_SIZE];
+
+    for (int n = 0; n < count && result == 0; n++) {
+        if (types[n] != DIRECTORY) {
+            continue;
+        }
+
+        if (getFCB(starts[n], block)) {
+            fprintf(stderr, "Error retrieving the file block.\n");
+            result = -2;
+            break;
+        }
+
+        for (int i = ENTRY_START; i < GEN_P; i++) {
+            if (block[i] != ENTRY_END && block[i] != '\0') {
+                fprintf(stderr, "Directory is not empty.\n");
+                result = -3;
+                break;
+            }
+        }
+    }
+
+    if (result == 0 && removeEntries(fcBlockID, names, count)) {
+        fprintf(stderr, "Error removing entries from the file control block.\n");
+        result = -5;
+    }
+
+    for (int n = 0; n < count && result == 0; n++) {
+
+        // Remove all entries referencing the deleted file from the file open table
+        deleteAll(starts[n]);
+
+        if (isInline(starts[n])) {
+            continue;
+        }
+
+        if (types[n] == FILE) {
+            switch (orphanChain(starts[n])) {
+                case 0:
+                    break;
+                case -1:
+                    result = -2;
+                    break;
+                default:
+                    result = -4;
+                    break;
+            }
+
+            continue;
+        }
+
+        if (getFCB(starts[n], block)) {
+            fprintf(stderr, "Error retrieving the file block.\n");
+            result = -2;
+            break;
+        }
+
+        // A directory shared with a snapshot stays in place for the snapshot
+        if (!isShared(block)) {
+            block[BLOCK_START] = FREE;
+
+            if (putFCB(starts[n], block)) {
+                fprintf(stderr, "Error creating file block.\n");
+                result = -4;
+            }
+        }
+    }
+
+    free(starts);
+    free(types);
+    return result;
 }
 
 /*
@@ -249,250 +392,1036 @@ int writeFile(const char* mem_pointer, int blockID, int start, unsigned int leng
         return -2;
     }
 
-    /*
-     * while start is > DATA_SIZE:
-     *      - get a free block -> nextBlockID
-     *      - get_block with blockID
-     *      - write encode_int(nextBlockID) to NEXT_BLOCK and NEXT_BLOCK + 1
-     *      - put_block with blockID
-     *      - blockID = nextBlockID
-     *      - start -= DATA_SIZE
-     */
-
-    char* block;
-    int nextBlockID;
-    char* next;
-
-    while (start > DATA_SIZE) {
-        if (getFreeBlock(&nextBlockID)) {
-            fprintf(stderr, "Can't find a free block.\n");
+    switch (writeBytes(mem_pointer, blockID, start, length)) {
+        case 0:
+            return 0;
+        case -1:
             return -3;
-        }
-
-        block = malloc(BLOCK_SIZE);
-
-        if (get_block(blockID, block)) {
-            fprintf(stderr, "Error retrieving file block.\n");
+        case -2:
             return -4;
-        }
-
-        next = encode_int(nextBlockID);
-        block[NEXT_BLOCK] = next[0];
-        block[NEXT_BLOCK + 1] = next[1];
-
-        if (put_block(blockID, block)) {
-            fprintf(stderr, "Error creating file block.\n");
+        default:
             return -5;
-        }
+    }
+}
 
-        blockID = nextBlockID;
-        start -= DATA_SIZE;
+/*
+ * readFile: reads a file
+ *
+ * @mem_pointer     String      where the contents of the file are read to
+ * @blockID         Integer     location of the starting block of a file
+ * @start           Integer     position in the file
+ * @length          Integer     length of mem_pointer
+ *
+ * return  0:                   successful execution
+ * return -1:                   invalid start value
+ * return -2:                   error retrieving file block
+ * return -3:                   error reading the file from that position
+ */
+int readFile(char* mem_pointer, int blockID, int start, int length) {
+    if (start < 0) {
+        fprintf(stderr, "Invalid start value.\n");
+        return -1;
     }
 
-    block = malloc(BLOCK_SIZE);
+    if (length < 0) {
+        fprintf(stderr, "Error reading the file from that position.\n");
+        return -3;
+    }
 
-    if (get_block(blockID, block)) {
-        fprintf(stderr, "Error retrieving file block.\n");
-        return -4;
+    switch (readBytes(mem_pointer, blockID, start, length)) {
+        case 0:
+            return 0;
+        case -1:
+            return -2;
+        default:
+            return -3;
     }
+}
 
-    // Next character in mem_pointer to write
-    int c = 0;
+/*
+ * fitsFile: checks that a range of bytes lies within the largest file the disk can hold.
+ * A range whose end does not fit in a size_t is never within it.
+ *
+ * @start           Integer     position of the range in the file
+ * @length          Integer     how many bytes the range holds
+ *
+ * return 1:                    the range fits
+ * return 0:                    the range reaches past the largest file
+ */
+int fitsFile(size_t start, size_t length) {
+    return start <= MAX_FILE_SIZE && length <= MAX_FILE_SIZE - start;
+}
 
-    // Current position in the file block
-    int p = DATA_P + start;
+/*
+ * vectorLength: adds up the lengths of the elements of an io vector.
+ *
+ * @length          Integer Pointer     the total length
+ * @iov             Array of iovec      the io vector
+ * @iovcnt          Integer             number of elements in iov
+ *
+ * return  0:                           successful execution
+ * return -1:                           the io vector holds more bytes than the largest file
+ */
+int vectorLength(size_t* length, const struct iovec* iov, int iovcnt) {
+    *length = 0;
 
-    /*
-     * while length > 0
-     *      block[BLOCK_START] = FILE
-     *
-     *      while p < BLOCK_SIZE and length > 0
-     *          block[p++] = mem_pointer[c++]
-     *          length--
-     *
-     *      if length > 0
-     *          - get a free block -> nextBlockID
-     *          - write encode_int(nextBlockID) to NEXT_BLOCK and NEXT_BLOCK + 1
-     *          - put_block with blockID
-     *          - blockID = nextBlockID
-     *          - block = malloc(BLOCK_SIZE)
-     *          - get_block with blockID
-     *          - p = DATA_P
-     *
-     * write encode_int(BLOCK_END) to NEXT_BLOCK and NEXT_BLOCK + 1
-     * put_block with blockID
-     * return 0
-     */
+    for (int i = 0; i < iovcnt; i++) {
+        if (!fitsFile(*length, iov[i].iov_len)) {
+            return -1;
+        }
 
-    while (length > 0) {
-        block[BLOCK_START] = FILE;
+        *length += iov[i].iov_len;
+    }
 
-        while (p < BLOCK_SIZE && length > 0) {
-            block[p++] = mem_pointer[c++];
-            length--;
-        }
+    return 0;
+}
 
-        if (length > 0) {
-            if (getFreeBlock(&nextBlockID)) {
-                fprintf(stderr, "Can't find a free block.\n");
-                return -3;
-            }
+/*
+ * Where writeChain takes its bytes from: either an io vector supplied by the caller,
+ * or the chain of blocks of another file.
+ */
+struct source {
+    const struct iovec* iov;    // the io vector, or NULL when copying from a file
+    int index;                  // the current element of the io vector
+    size_t offset;              // position in the current element, or in the data of the current block
+    int blockID;                // the current block of the file being copied
+    char block[BLOCK_SIZE];     // contents of the current block of the file being copied
+};
 
-            next = encode_int(nextBlockID);
-            block[NEXT_BLOCK] = next[0];
-            block[NEXT_BLOCK + 1] = next[1];
+/*
+ * gather: copies the next length bytes of a source into a block.
+ *
+ * @dest        String              where the bytes are copied to
+ * @length      Integer             how many bytes to copy
+ * @src         source Pointer      where the bytes are copied from
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving file block
+ * return -2:                       reached the end of the file being copied
+ */
+static int gather(char* dest, size_t length, struct source* src) {
+    while (length > 0) {
+        if (src->iov == NULL && src->offset == DATA_SIZE) {
+            char next[2];
+            next[0] = src->block[NEXT_BLOCK];
+            next[1] = src->block[NEXT_BLOCK + 1];
+            src->blockID = decode_int(next);
 
-            if (put_block(blockID, block)) {
-                fprintf(stderr, "Error creating file block.\n");
-                return -5;
+            if (src->blockID == BLOCK_END) {
+                fprintf(stderr, "Error reading the file from that position.\n");
+                return -2;
             }
 
-            blockID = nextBlockID;
-            block = malloc(BLOCK_SIZE);
-
-            if (get_block(blockID, block)) {
+            if (get_block(src->blockID, src->block)) {
                 fprintf(stderr, "Error retrieving file block.\n");
-                return -4;
+                return -1;
             }
 
-            p = DATA_P;
+            src->offset = 0;
+        }
+
+        size_t run;
+        const char* from;
 
+        if (src->iov == NULL) {
+            run = DATA_SIZE - src->offset;
+            from = &src->block[DATA_P + src->offset];
+        } else {
+            run = src->iov[src->index].iov_len - src->offset;
+            from = (const char*) src->iov[src->index].iov_base + src->offset;
         }
-    }
 
-    next = encode_int(BLOCK_END);
-    block[NEXT_BLOCK] = next[0];
-    block[NEXT_BLOCK + 1] = next[1];
+        if (run > length) {
+            run = length;
+        }
 
-    if (put_block(blockID, block)) {
-        fprintf(stderr, "Error creating file block.\n");
-        return -5;
+        memcpy(dest, from, run);
+        dest += run;
+        length -= run;
+        src->offset += run;
+
+        if (src->iov != NULL && src->offset == src->iov[src->index].iov_len) {
+            src->index++;
+            src->offset = 0;
+        }
     }
 
     return 0;
 }
 
 /*
- * readFile: reads a file
- *
- * @mem_pointer     String      where the contents of the file are read to
- * @blockID         Integer     location of the starting block of a file
- * @start           Integer     position in the file
- * @length          Integer     length of mem_pointer
+ * scatter: copies the next length bytes of a block into an io vector.
  *
- * return  0:                   successful execution
- * return -1:                   invalid start value
- * return -2:                   error retrieving file block
- * return -3:                   error reading the file from that position
+ * @src         String              where the bytes are copied from
+ * @length      Integer             how many bytes to copy
+ * @iov         Array of iovec      the io vector
+ * @index       Integer Pointer     the current element of the io vector
+ * @offset      Integer Pointer     the position in the current element
  */
-int readFile(char* mem_pointer, int blockID, int start, int length) {
-    if (start < 0) {
-        fprintf(stderr, "Invalid start value.\n");
-        return -1;
+static void scatter(const char* src, size_t length, const struct iovec* iov, int* index, size_t* offset) {
+    while (length > 0) {
+        size_t run = iov[*index].iov_len - *offset;
+
+        if (run > length) {
+            run = length;
+        }
+
+        memcpy((char*) iov[*index].iov_base + *offset, src, run);
+        src += run;
+        length -= run;
+        *offset += run;
+
+        if (*offset == iov[*index].iov_len) {
+            (*index)++;
+            *offset = 0;
+        }
     }
+}
 
-    char* block;
-    int nextBlockID;
-    char next[2];
+static int writeChain(struct source* src, size_t length, int blockID, size_t start);
 
-    /*
-     * do
-     *      get_block with blockID
-     *      read nextBlockID from NEXT_BLOCK and NEXT_BLOCK + 1
-     *      if start > DATA_SIZE && nextBlockID is BLOCK_END
-     *          return with -3
-     * while (start > DATA_SIZE && (blockID = nextBlockID) && (start -= DATA_SIZE))
-     */
+/*
+ * writeInline: writes length bytes taken from a source to a file stored inline.
+ * When the data no longer fits in the fcb, the file is moved out to a block of
+ * its own. Every open file table entry follows the file wherever it moves.
+ *
+ * @src             source Pointer      where the bytes are taken from
+ * @length          Integer             how many bytes to write
+ * @blockID         Integer             the inline id of the file
+ * @start           Integer             position in the file
+ *
+ * return  0:                           successful execution
+ * return -1:                           can't find enough free blocks
+ * return -2:                           error retrieving file block
+ * return -3:                           error creating file block
+ * return -4:                           the source ended before length bytes were taken
+ */
+static int writeInline(struct source* src, size_t length, int blockID, size_t start) {
+    char data[DATA_SIZE];
+    int size;
 
-    do {
-        block = malloc(BLOCK_SIZE);
+    memset(data, 0, DATA_SIZE);
 
-        if (get_block(blockID, block)) {
-            fprintf(stderr, "Error retrieving file block.\n");
-            return -2;
+    if (getInline(data, &size, blockID)) {
+        return -2;
+    }
+
+    // Written so that a range whose end does not fit in a size_t is never taken as inline
+    if (length <= INLINE_MAX && start <= INLINE_MAX - length) {
+        if (gather(&data[start], length, src)) {
+            return -4;
         }
 
-        next[0] = block[NEXT_BLOCK];
-        next[1] = block[NEXT_BLOCK + 1];
-        nextBlockID = decode_int(next);
+        if (start + length > (size_t) size) {
+            size = start + length;
+        }
 
-        if (start > DATA_SIZE && nextBlockID == BLOCK_END) {
-            fprintf(stderr, "Error reading the file from that position.\n");
-            return -3;
+        int moved = blockID;
+
+        switch (setInline(data, size, &moved)) {
+            case 0:
+                renumber(blockID, moved);
+                return 0;
+            case -3:
+                break;
+            default:
+                return -3;
         }
 
-    } while (start > DATA_SIZE && (blockID = nextBlockID) && (start -= DATA_SIZE));
+        // The data is all in the buffer, so the block is complete once written
+        length = 0;
+    }
 
-    // Next character in mem_pointer to read from
-    int c = 0;
+    int startingBlockID;
 
-    // Current position in the file block
-    int p = DATA_P + start;
+    switch (createBlock(&startingBlockID, (blockID - BLOCKS) / BLOCK_SIZE, data, size)) {
+        case 0:
+            break;
+        case -1:
+            fprintf(stderr, "Can't find a free block.\n");
+            return -1;
+        default:
+            return -3;
+    }
 
-    /*
-     * do
-     *      while p < BLOCK_SIZE and length > 0
-     *          mem_pointer[c++] = block[p++]
-     *          length--
-     *
-     *      if length > 0
-     *          read blockID from NEXT_BLOCK and NEXT_BLOCK + 1
-     *
-     *          if blockID is BLOCK_END
-     *              return with -3
-     *
-     *          get_block with blockID
-     *          p = DATA_P
-     * while length > 0
-     *
-     * return 0
-     */
+    if (pointEntry(blockID, startingBlockID)) {
+        fprintf(stderr, "Error creating file control block.\n");
+        return -3;
+    }
 
-    do {
-        while (p < BLOCK_SIZE && length > 0) {
-            mem_pointer[c++] = block[p++];
-            length--;
-        }
+    renumber(blockID, startingBlockID);
 
-        if (length > 0) {
-            next[0] = block[NEXT_BLOCK];
-            next[1] = block[NEXT_BLOCK + 1];
-            blockID = decode_int(next);
+    return writeChain(src, length, startingBlockID, start);
+}
 
-            if (blockID == BLOCK_END) {
-                fprintf(stderr, "Error reading the file from that position.\n");
-                return -3;
-            }
+/*
+ * planChain: walks the chain of a file as far as a write reaches, without changing it,
+ * to learn how many blocks the write must allocate before any block is written.
+ *
+ * Every block walked past the first is rewritten by the write if it is shared with a
+ * snapshot or another chain, and splitting a block shared with another chain makes the
+ * block after it shared in turn. Every block from the first shared one on is counted
+ * as a copy, which is exact for the chains of snapshots and an upper bound otherwise.
+ *
+ * @last            Integer Pointer     the last block walked
+ * @copies          Integer Pointer     how many blocks walked must be copied
+ * @blockID         Integer             location of the starting block of a file
+ * @blocks          Integer             how many blocks the write reaches from the start of the file
+ *
+ * return int:                          how many blocks of the chain the write reaches
+ * return -1:                           error retrieving file block
+ */
+static int planChain(int* last, int* copies, int blockID, size_t blocks) {
+    char block[BLOCK_SIZE];
+    int walked = 0;
 
-            block = malloc(BLOCK_SIZE);
+    *copies = 0;
 
-            if (get_block(blockID, block)) {
-                fprintf(stderr, "Error retrieving file block.\n");
-                return -2;
-            }
+    while ((size_t) walked < blocks && blockID != BLOCK_END) {
+        if (getCached(blockID, block)) {
+            return -1;
+        }
 
-            p = DATA_P;
+        if (walked > 0 && (*copies > 0 || isShared(block) || isDuplicated(block))) {
+            (*copies)++;
         }
-    } while (length > 0);
 
-    return 0;
+        *last = blockID;
+        walked++;
+
+        char next[2];
+        next[0] = block[NEXT_BLOCK];
+        next[1] = block[NEXT_BLOCK + 1];
+        blockID = decode_int(next);
+    }
+
+    return walked;
 }
 
 /*
- * readDir: reads a directory
+ * writeChain: writes length bytes taken from a source to a file.
+ * The chain is walked once, each touched block is written once,
+ * and any blocks needed to extend the file are allocated in a single pass.
  *
- * @mem_pointer:    String      where the contents of the directory are read to
- * @blockID         Integer     the block id of the directory
- * @step            Integer     how far through the directory has been scanned
+ * @src             source Pointer      where the bytes are taken from
+ * @length          Integer             how many bytes to write
+ * @blockID         Integer             location of the starting block of a file
+ * @start           Integer             position in the file
+ *
+ * return  0:                           successful execution
+ * return -1:                           can't find enough free blocks
+ * return -2:                           error retrieving file block
+ * return -3:                           error creating file block
+ * return -4:                           the source ended before length bytes were taken
+ * return -5:                           the range reaches past the largest file
+ */
+static int writeChain(struct source* src, size_t length, int blockID, size_t start) {
+    if (length == 0) {
+        return 0;
+    }
+
+    if (!fitsFile(start, length)) {
+        fprintf(stderr, "The range lies past the largest file.\n");
+        return -5;
+    }
+
+    if (isInline(blockID)) {
+        return writeInline(src, length, blockID, start);
+    }
+
+    // Blocks touched by the write, from the starting block of the file on
+    struct pending* chain = malloc(BLOCKS * sizeof(struct pending));
+    int count = 1;
+
+    chain[0].blockID = blockID;
+    chain[0].dirty = 0;
+
+    if (getCached(blockID, chain[0].block)) {
+        fprintf(stderr, "Error retrieving file block.\n");
+        free(chain);
+        return -2;
+    }
+
+    // Blocks allocated to extend the file, used in order
+    int fresh[BLOCKS];
+    int freshCount = 0;
+    int freshUsed = 0;
+
+    int last = blockID;
+    int copies;
+    int reached = planChain(&last, &copies, blockID, (start + length + DATA_SIZE - 1) / DATA_SIZE);
+
+    if (reached < 0) {
+        fprintf(stderr, "Error retrieving file block.\n");
+        free(chain);
+        return -2;
+    }
+
+    int missing = (start + length + DATA_SIZE - 1) / DATA_SIZE - reached;
+
+    /*
+     * No block is changed until the blocks the write needs are known to be free. Without
+     * copies to make, the blocks that extend the file are taken now. Copies are allocated as
+     * the chain is walked, and could land on blocks taken early, so the disk is only checked
+     * for room, and the blocks that extend the file are taken once the copies are made.
+     */
+    if (missing > 0 && copies == 0) {
+        freshCount = missing;
+
+        // Extend the chain right after its last block, in one run if there is room
+        if (getFreeRun(fresh, freshCount, last) && getFreeBlocks(fresh, freshCount, last)) {
+            fprintf(stderr, "Can't find enough free blocks.\n");
+            free(chain);
+            return -1;
+        }
+    } else if (missing + copies > 0 && getFreeBlocks(fresh, missing + copies, last)) {
+        fprintf(stderr, "Can't find enough free blocks.\n");
+        free(chain);
+        return -1;
+    }
+
+    int result = 0;
+
+    /*
+     * for each block from the start of the file
+     *      if start lies past this block, the block is entirely before the data: fill it out
+     *      otherwise copy the next run of bytes into it
+     *
+     *      if bytes are left
+     *          - follow NEXT_BLOCK, copying shared blocks,
+     *            or at the end of the chain link in a fresh block
+     *
+     * share blocks with identical existing blocks, then put_block every changed block
+     */
+
+    while (result == 0) {
+        char* block = chain[count - 1].block;
+        size_t fill = (unsigned char) block[FILL_P];
+        size_t end = DATA_SIZE;
+
+        if (start < DATA_SIZE) {
+            size_t run = DATA_SIZE - start;
+
+            if (run > length) {
+                run = length;
+            }
+
+            end = start + run;
+
+            // Never expose stale bytes between the old end of data and the new data
+            if (fill < start) {
+                memset(&block[DATA_P + fill], 0, start - fill);
+            }
+
+            switch (gather(&block[DATA_P + start], run, src)) {
+                case 0:
+                    break;
+                case -1:
+                    result = -2;
+                    break;
+                default:
+                    result = -4;
+                    break;
+            }
+
+            chain[count - 1].dirty = 1;
+            length -= run;
+            start = 0;
+        } else {
+            if (fill < DATA_SIZE) {
+                memset(&block[DATA_P + fill], 0, DATA_SIZE - fill);
+                chain[count - 1].dirty = 1;
+            }
+
+            start -= DATA_SIZE;
+        }
+
+        if (end > fill) {
+            block[FILL_P] = end;
+        }
+
+        if (length == 0 || result) {
+            break;
+        }
+
+        char next[2];
+        next[0] = block[NEXT_BLOCK];
+        next[1] = block[NEXT_BLOCK + 1];
+        int nextBlockID = decode_int(next);
+
+        struct pending* following = &chain[count];
+        following->dirty = 1;
+
+        if (nextBlockID == BLOCK_END) {
+            if (freshCount == 0) {
+                freshCount = (start + length + DATA_SIZE - 1) / DATA_SIZE;
+
+                // Extend the chain right after its last block, in one run if there is room
+                if (getFreeRun(fresh, freshCount, chain[count - 1].blockID) &&
+                        getFreeBlocks(fresh, freshCount, chain[count - 1].blockID)) {
+                    fprintf(stderr, "Can't find enough free blocks.\n");
+                    result = -1;
+                    break;
+                }
+            }
+
+            nextBlockID = fresh[freshUsed++];
+
+            memset(following->block, 0, BLOCK_SIZE);
+            following->block[BLOCK_START] = FILE;
+            following->block[REFS_P] = 1;
+            following->block[GEN_P] = getGeneration();
+
+            char* _next = encode_int(BLOCK_END);
+            following->block[NEXT_BLOCK] = _next[0];
+            following->block[NEXT_BLOCK + 1] = _next[1];
+            free(_next);
+        } else {
+            if (getCached(nextBlockID, following->block)) {
+                fprintf(stderr, "Error retrieving file block.\n");
+                result = -2;
+                break;
+            }
+
+            following->dirty = 0;
+
+            // Blocks shared with a snapshot or with other chains are copied before they are written
+            if (isShared(following->block)) {
+                result = copyOnWrite(&nextBlockID, following->block);
+                following->dirty = 1;
+            } else if (isDuplicated(following->block)) {
+                result = splitBlock(&nextBlockID, following->block);
+                following->dirty = 1;
+            }
+
+            if (result) {
+                fprintf(stderr, "Can't find a free block.\n");
+                result = -1;
+                break;
+            }
+        }
+
+        if (nextBlockID != decode_int(next)) {
+            char* _next = encode_int(nextBlockID);
+            block[NEXT_BLOCK] = _next[0];
+            block[NEXT_BLOCK + 1] = _next[1];
+            chain[count - 1].dirty = 1;
+            free(_next);
+        }
+
+        following->blockID = nextBlockID;
+        count++;
+    }
+
+    if (result == 0 && dedupChain(chain, count)) {
+        result = -3;
+    }
+
+    // Blocks linked in so far are written even when the write fails part way through
+    struct request* writes = malloc(count * sizeof(struct request));
+    int writeCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (chain[i].dirty) {
+            writes[writeCount].blockID = chain[i].blockID;
+            writes[writeCount].write = WRITE_REQUEST;
+            writes[writeCount++].buffer = chain[i].block;
+        }
+    }
+
+    if (submitBatch(writes, writeCount)) {
+        fprintf(stderr, "Error creating file block.\n");
+        result = -3;
+    }
+
+    free(writes);
+    free(chain);
+    return result;
+}
+
+/*
+ * writeVector: writes the contents of an io vector to a file, one element after the other.
+ * The data may contain null chars.
+ *
+ * @iov             Array of iovec      the buffers to write
+ * @iovcnt          Integer             number of elements in iov
+ * @blockID         Integer             location of the starting block of a file
+ * @start           Integer             position in the file
+ *
+ * return  0:                           successful execution
+ * return -1:                           can't find enough free blocks
+ * return -2:                           error retrieving file block
+ * return -3:                           error creating file block
+ * return -5:                           the range reaches past the largest file
+ */
+int writeVector(const struct iovec* iov, int iovcnt, int blockID, size_t start) {
+    TRACE("writeVector");
+
+    struct source src;
+    src.iov = iov;
+    src.index = 0;
+    src.offset = 0;
+
+    size_t length;
+
+    if (vectorLength(&length, iov, iovcnt)) {
+        fprintf(stderr, "The range lies past the largest file.\n");
+        return -5;
+    }
+
+    return writeChain(&src, length, blockID, start);
+}
+
+/*
+ * copyRange: copies a range of one file into the same range of another file.
+ * Both files use the same block layout, so each block of the source is copied
+ * straight into the matching block of the destination without an intermediate buffer.
+ *
+ * @inBlockID       Integer     location of the starting block of the file to copy from
+ * @outBlockID      Integer     location of the starting block of the file to copy to
+ * @start           Integer     position of the range in both files
+ * @length          Integer     how many bytes to copy
  *
- * return  1:                   Reached end of directory
+ * return  0:                   successful execution
+ * return -1:                   can't find enough free blocks
+ * return -2:                   error retrieving file block
+ * return -3:                   error creating file block
+ * return -4:                   error reading the file from that position
+ * return -5:                   the range reaches past the largest file
+ */
+int copyRange(int inBlockID, int outBlockID, size_t start, size_t length) {
+    TRACE("copyRange");
+
+    if (!fitsFile(start, length)) {
+        fprintf(stderr, "The range lies past the largest file.\n");
+        return -5;
+    }
+
+    if (inBlockID == outBlockID || length == 0) {
+        return 0;
+    }
+
+    int size;
+
+    if (getSize(&size, inBlockID)) {
+        return -2;
+    }
+
+    // Nothing is read past the end of the file being copied
+    if (start + length > (size_t) size) {
+        fprintf(stderr, "Error reading the file from that position.\n");
+        return -4;
+    }
+
+    struct source src;
+
+    // A file stored inline is copied from a buffer holding its data
+    if (isInline(inBlockID)) {
+        char data[DATA_SIZE];
+
+        memset(data, 0, DATA_SIZE);
+
+        if (getInline(data, &size, inBlockID)) {
+            return -2;
+        }
+
+        struct iovec iov;
+        iov.iov_base = &data[start];
+        iov.iov_len = length;
+
+        src.iov = &iov;
+        src.index = 0;
+        src.offset = 0;
+
+        return writeChain(&src, length, outBlockID, start);
+    }
+
+    src.iov = NULL;
+    src.blockID = inBlockID;
+    src.offset = start;
+
+    if (get_block(src.blockID, src.block)) {
+        fprintf(stderr, "Error retrieving file block.\n");
+        return -2;
+    }
+
+    // Position the source on the block holding start
+    while (src.offset > DATA_SIZE) {
+        char next[2];
+        next[0] = src.block[NEXT_BLOCK];
+        next[1] = src.block[NEXT_BLOCK + 1];
+        src.blockID = decode_int(next);
+
+        if (src.blockID == BLOCK_END) {
+            fprintf(stderr, "Error reading the file from that position.\n");
+            return -4;
+        }
+
+        if (get_block(src.blockID, src.block)) {
+            fprintf(stderr, "Error retrieving file block.\n");
+            return -2;
+        }
+
+        src.offset -= DATA_SIZE;
+    }
+
+    return writeChain(&src, length, outBlockID, start);
+}
+
+/*
+ * allocateRange: makes sure a range of a file is backed by blocks.
+ * Whatever lies past the end of the file is written with zeros, and the blocks
+ * added are taken in a single run where possible. Later writes into the range
+ * only fill blocks that already exist.
+ *
+ * @blockID         Integer     location of the starting block of a file
+ * @start           Integer     position of the range in the file
+ * @length          Integer     length of the range
+ *
+ * return  0:                   successful execution
+ * return -1:                   can't find enough free blocks
+ * return -2:                   error retrieving file block
+ * return -3:                   error creating file block
+ * return -4:                   the range reaches past the largest file
+ * return -5:                   not enough memory for the zeros
+ */
+int allocateRange(int blockID, size_t start, size_t length) {
+    TRACE("allocateRange");
+
+    if (!fitsFile(start, length)) {
+        fprintf(stderr, "The range lies past the largest file.\n");
+        return -4;
+    }
+
+    int size;
+
+    if (getSize(&size, blockID)) {
+        return -2;
+    }
+
+    if (start + length <= (size_t) size) {
+        return 0;
+    }
+
+    size_t missing = start + length - size;
+    char* zeros = calloc(missing, 1);
+
+    if (zeros == NULL) {
+        fprintf(stderr, "Not enough memory.\n");
+        return -5;
+    }
+
+    struct iovec iov;
+    iov.iov_base = zeros;
+    iov.iov_len = missing;
+
+    int result = writeVector(&iov, 1, blockID, size);
+
+    free(zeros);
+    return result;
+}
+
+/*
+ * truncateFile: changes the size of a file.
+ * Shrinking walks only to the new last block, ends the chain there, and
+ * releases the tail. Growing writes zeros, as allocateRange does.
+ *
+ * @blockID         Integer     location of the starting block of a file
+ * @length          Integer     the new size of the file
+ *
+ * return  0:                   successful execution
+ * return -1:                   can't find enough free blocks
+ * return -2:                   error retrieving file block
+ * return -3:                   error creating file block
+ * return -4:                   the size reaches past the largest file
+ * return -5:                   not enough memory for the zeros
+ */
+int truncateFile(int blockID, size_t length) {
+    TRACE("truncateFile");
+
+    if (!fitsFile(0, length)) {
+        fprintf(stderr, "The size lies past the largest file.\n");
+        return -4;
+    }
+
+    if (isInline(blockID)) {
+        char data[INLINE_MAX];
+        int size;
+
+        if (getInline(data, &size, blockID)) {
+            return -2;
+        }
+
+        if (length > (size_t) size) {
+            return allocateRange(blockID, 0, length);
+        }
+
+        int moved = blockID;
+
+        if (setInline(data, length, &moved)) {
+            return -3;
+        }
+
+        renumber(blockID, moved);
+        return 0;
+    }
+
+    // Every block before the last one is full
+    size_t last = length == 0 ? 0 : (length - 1) / DATA_SIZE;
+    size_t fill = length - last * DATA_SIZE;
+
+    char block[BLOCK_SIZE];
+    char next[2];
+    int current = blockID;
+
+    if (get_block(current, block)) {
+        fprintf(stderr, "Error retrieving file block.\n");
+        return -2;
+    }
+
+    /*
+     * walk to the new last block
+     *      - blocks shared with a snapshot or with other chains are copied,
+     *        and the block before them is pointed at the copy
+     *      - if the chain ends first, the file is growing
+     */
+
+    for (size_t i = 0; i < last; i++) {
+        next[0] = block[NEXT_BLOCK];
+        next[1] = block[NEXT_BLOCK + 1];
+
+        int nextBlockID = decode_int(next);
+
+        if (nextBlockID == BLOCK_END) {
+            return allocateRange(blockID, 0, length);
+        }
+
+        char following[BLOCK_SIZE];
+
+        if (get_block(nextBlockID, following)) {
+            fprintf(stderr, "Error retrieving file block.\n");
+            return -2;
+        }
+
+        int copy = nextBlockID;
+        int result = 0;
+
+        if (isShared(following)) {
+            result = copyOnWrite(&copy, following);
+        } else if (isDuplicated(following)) {
+            result = splitBlock(&copy, following);
+        }
+
+        if (result) {
+            fprintf(stderr, "Can't find a free block.\n");
+            return -1;
+        }
+
+        if (copy != nextBlockID) {
+            char* _next = encode_int(copy);
+            block[NEXT_BLOCK] = _next[0];
+            block[NEXT_BLOCK + 1] = _next[1];
+            free(_next);
+
+            if (put_block(current, block)) {
+                fprintf(stderr, "Error creating file block.\n");
+                return -3;
+            }
+        }
+
+        current = copy;
+        memcpy(block, following, BLOCK_SIZE);
+    }
+
+    next[0] = block[NEXT_BLOCK];
+    next[1] = block[NEXT_BLOCK + 1];
+
+    int tail = decode_int(next);
+
+    if (tail == BLOCK_END && (size_t) (unsigned char) block[FILL_P] < fill) {
+        return allocateRange(blockID, 0, length);
+    }
+
+    // End the chain here, without leaving stale bytes past the new end
+    char* end = encode_int(BLOCK_END);
+    block[NEXT_BLOCK] = end[0];
+    block[NEXT_BLOCK + 1] = end[1];
+    free(end);
+
+    memset(&block[DATA_P + fill], 0, DATA_SIZE - fill);
+    block[FILL_P] = fill;
+
+    if (put_block(current, block)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -3;
+    }
+
+    switch (releaseChain(tail)) {
+        case 0:
+            return 0;
+        case -1:
+            return -2;
+        default:
+            return -3;
+    }
+}
+
+/*
+ * readVector: reads a file into an io vector, filling one element after the other.
+ * The chain is walked once and runs of data are copied out of each block with memcpy.
+ * Reading past the end of the file, as given by the fill of each block, is an error.
+ *
+ * @iov             Array of iovec      the buffers to read into
+ * @iovcnt          Integer             number of elements in iov
+ * @blockID         Integer             location of the starting block of a file
+ * @start           Integer             position in the file
+ *
+ * return  0:                           successful execution
+ * return -1:                           error retrieving file block
+ * return -2:                           error reading the file from that position
+ */
+int readVector(const struct iovec* iov, int iovcnt, int blockID, size_t start) {
+    TRACE("readVector");
+
+    size_t length;
+
+    // No file reaches that far, so nothing can be read there
+    if (vectorLength(&length, iov, iovcnt) || !fitsFile(start, length)) {
+        fprintf(stderr, "Error reading the file from that position.\n");
+        return -2;
+    }
+
+    char block[BLOCK_SIZE];
+    char next[2];
+
+    // Position in the io vector
+    int index = 0;
+    size_t offset = 0;
+
+    // A file stored inline reads like a single block holding its data
+    if (isInline(blockID)) {
+        int size;
+
+        memset(block, 0, BLOCK_SIZE);
+
+        if (getInline(&block[DATA_P], &size, blockID)) {
+            return -1;
+        }
+
+        if (start + length > (size_t) size) {
+            fprintf(stderr, "Error reading the file from that position.\n");
+            return -2;
+        }
+
+        scatter(&block[DATA_P + start], length, iov, &index, &offset);
+        return 0;
+    }
+
+    while (1) {
+        if (getCached(blockID, block)) {
+            fprintf(stderr, "Error retrieving file block.\n");
+            return -1;
+        }
+
+        if (start < DATA_SIZE) {
+            size_t run = DATA_SIZE - start;
+
+            if (run > length) {
+                run = length;
+            }
+
+            // Bytes past the fill of a block lie past the end of the file
+            if (start + run > (size_t) (unsigned char) block[FILL_P]) {
+                fprintf(stderr, "Error reading the file from that position.\n");
+                return -2;
+            }
+
+            scatter(&block[DATA_P + start], run, iov, &index, &offset);
+            length -= run;
+            start = 0;
+        } else {
+            start -= DATA_SIZE;
+        }
+
+        if (length == 0) {
+            return 0;
+        }
+
+        next[0] = block[NEXT_BLOCK];
+        next[1] = block[NEXT_BLOCK + 1];
+        blockID = decode_int(next);
+
+        if (blockID == BLOCK_END) {
+            fprintf(stderr, "Error reading the file from that position.\n");
+            return -2;
+        }
+    }
+}
+
+/*
+ * writeBytes: writes an exact number of bytes to a file.
+ *
+ * @mem_pointer     String      the bytes to write, may contain null chars
+ * @blockID         Integer     location of the starting block of a file
+ * @start           Integer     position in the file
+ * @length          Integer     how many bytes to write
+ *
+ * return  0:                   successful execution
+ * return -1:                   can't find enough free blocks
+ * return -2:                   error retrieving file block
+ * return -3:                   error creating file block
+ * return -5:                   the range reaches past the largest file
+ */
+int writeBytes(const char* mem_pointer, int blockID, size_t start, size_t length) {
+    TRACE("writeBytes");
+
+    struct iovec iov;
+    iov.iov_base = (void*) mem_pointer;
+    iov.iov_len = length;
+
+    return writeVector(&iov, 1, blockID, start);
+}
+
+/*
+ * readBytes: reads an exact number of bytes from a file.
+ * Nothing past length is touched in mem_pointer.
+ *
+ * @mem_pointer     String      where the contents of the file are read to
+ * @blockID         Integer     location of the starting block of a file
+ * @start           Integer     position in the file
+ * @length          Integer     how many bytes to read
+ *
+ * return  0:                   successful execution
+ * return -1:                   error retrieving file block
+ * return -2:                   error reading the file from that position
+ */
+int readBytes(char* mem_pointer, int blockID, size_t start, size_t length) {
+    TRACE("readBytes");
+
+    struct iovec iov;
+    iov.iov_base = mem_pointer;
+    iov.iov_len = length;
+
+    return readVector(&iov, 1, blockID, start);
+}
+
+/*
+ * readDir: reads a directory
+ *
+ * @mem_pointer:    String      where the contents of the directory are read to
+ * @blockID         Integer     the block id of the directory
+ * @step            Integer     how far through the directory has been scanned
+ *
+ * return  1:                   Reached end of directory
  * return  0:                   successful execution
  * return -1:                   error retrieving file block
  */
 int readDir(char* mem_pointer, int blockID, int step) {
+    TRACE("readDir");
+
     char* block = malloc(BLOCK_SIZE);
 
-    if (get_block(blockID, block)) {
+    if (getFCB(blockID, block)) {
         fprintf(stderr, "Error retrieving file block.\n");
         return -1;
     }
@@ -500,8 +1429,8 @@ int readDir(char* mem_pointer, int blockID, int step) {
     int final = 0;
     int p = 0;
 
-    for (int i = ENTRY_START; i < BLOCK_SIZE; i += ENTRY_LENGTH) {
-        if (block[i] != ENTRY_END && step-- == 0) {
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        if (block[i] != ENTRY_END && block[i] != INLINE_DATA && step-- == 0) {
             for (int j = i + NAME_P; j < i + MAX_DIRNAME; j++) {
                 if (block[j] != '\0') {
                     mem_pointer[p++] = block[j];
@@ -3,17 +3,21 @@
  *
  */
 
+#include <stddef.h>
+#include <sys/uio.h>
 #include "fileSystem.h"
 
 #define DIRECTORY 1
 #define FILE 0
 #define FREE -1
+#define META 2
 
 #define NEXT_BLOCK 1
 #define BLOCK_END -1
 #define ROOT "/"
 
-#define DATA_SIZE BLOCK_SIZE - DATA_P
+#define DATA_SIZE (GEN_P - DATA_P)
+#define MAX_FILE_SIZE ((size_t) BLOCKS * DATA_SIZE)
 
 // Creates a File Control Block
 int createFCB(int parentFCBID, char* name);
@@ -27,11 +31,44 @@ int deleteDir(int fcBlockID, const char* name);
 // Deletes a file
 int deleteFile(int fcBlockID, const char* name);
 
+// Creates several files in the same directory
+int createBatch(int fcBlockID, char** names, int count, int type);
+
+// Deletes several files from the same directory
+int deleteBatch(int fcBlockID, char** names, int count);
+
 // Writes to a file
 int writeFile(const char* mem_pointer, int blockID, int start, unsigned int length);
 
 // Reads a file
 int readFile(char* mem_pointer, int blockID, int start, int length);
 
+// Checks that a range of bytes lies within the largest file the disk can hold
+int fitsFile(size_t start, size_t length);
+
+// Adds up the lengths of the elements of an io vector
+int vectorLength(size_t* length, const struct iovec* iov, int iovcnt);
+
+// Writes an exact number of bytes to a file
+int writeBytes(const char* mem_pointer, int blockID, size_t start, size_t length);
+
+// Reads an exact number of bytes from a file
+int readBytes(char* mem_pointer, int blockID, size_t start, size_t length);
+
+// Writes the contents of an io vector to a file
+int writeVector(const struct iovec* iov, int iovcnt, int blockID, size_t start);
+
+// Reads a file into an io vector
+int readVector(const struct iovec* iov, int iovcnt, int blockID, size_t start);
+
+// Copies a range of one file into the same range of another file
+int copyRange(int inBlockID, int outBlockID, size_t start, size_t length);
+
+// Makes sure a range of a file is backed by blocks
+int allocateRange(int blockID, size_t start, size_t length);
+
+// Changes the size of a file
+int truncateFile(int blockID, size_t length);
+
 // Reads a directory
 int readDir(char* mem_pointer, int blockID, int step);
@@ -7,11 +7,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include "blockio.h"
+#include "cache.h"
 #include "entry.h"
 #include "fControl.h"
+#include "dirTree.h"
 #include "fileSystem.h"
+#include "dedup.h"
+#include "defrag.h"
+#include "fsck.h"
 #include "openFiles.h"
 #include "pathUtils.h"
+#include "reclaim.h"
+#include "seal.h"
+#include "snapshot.h"
+#include "stats.h"
+#include "superblock.h"
+#include "trace.h"
 
 /* sfs_open: Opens a file descriptor to the file.
  *
@@ -22,8 +33,8 @@
  * return -2:               error traversing the file system
  * return -3:               error adding block id to the file open table
  */
-int sfs_open(char* pathname) {
-    char** path = malloc(MAX_PATH);
+static int doOpen(char* pathname) {
+    char** path = malloc(MAX_PATH * sizeof(char*));
 
     for (int i = 0; i < MAX_PATH; i++) {
         path[i] = malloc(MAX_DIRNAME);
@@ -54,6 +65,21 @@ int sfs_open(char* pathname) {
     return fd;
 }
 
+/*
+ * followReads: Sets how far the next read of an open file reads ahead,
+ * from how sequential the reads of the file have been.
+ *
+ * @fd          Integer     the file descriptor being read
+ * @start       Integer     where the read starts
+ * @length      Integer     how many bytes it reads
+ */
+static void followReads(int fd, size_t start, size_t length) {
+    int window = 0;
+
+    followStream(&window, fd, start, length);
+    setReadAhead(window);
+}
+
 /*
  * sfs_read: Copies data stored in a regular file into a specified memory pointer.
  *
@@ -66,9 +92,9 @@ int sfs_open(char* pathname) {
  * return -1:                   error finding opened block id from the file open table
  * return -2:                   error getting file type
  * return -3:                   file is not a regular file
- * return -4:                   error reading file
+ * return -4:                   error reading file, or reading past its end
  */
-int sfs_read(int fd, int start, int length, char* mem_pointer) {
+static int doRead(int fd, int start, int length, char* mem_pointer) {
     int blockID;
 
     // Find the block id corresponding to the file descriptor from the file open table
@@ -89,15 +115,18 @@ int sfs_read(int fd, int start, int length, char* mem_pointer) {
         return -3;
     }
 
-    for (int i = 0; i < MAX_IO_LENGTH + 1; i++) {
-        mem_pointer[i] = '\0';
-    }
+    followReads(fd, start, length);
+
+    int result = readFile(mem_pointer, blockID, start, length);
+    setReadAhead(0);
 
-    if (readFile(mem_pointer, blockID, start, length)) {
+    if (result) {
         fprintf(stderr, "Error reading file.\n");
         return -4;
     }
 
+    mem_pointer[length] = '\0';
+
     return 1;
 }
 
@@ -114,8 +143,15 @@ int sfs_read(int fd, int start, int length, char* mem_pointer) {
  * return -2:                   error getting file type
  * return -3:                   file is not a regular file
  * return -4:                   error writing file
+ * return -5:                   file system is mounted read-only
+ * return -6:                   error copying the file out of a snapshot
  */
-int sfs_write(int fd, int start, int length, char* mem_pointer) {
+static int doWrite(int fd, int start, int length, char* mem_pointer) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -5;
+    }
+
     int blockID;
 
     // Find the block id corresponding to the file descriptor from the file open table
@@ -136,6 +172,12 @@ int sfs_write(int fd, int start, int length, char* mem_pointer) {
         return -3;
     }
 
+    // Blocks shared with a snapshot must not be written in place
+    if (unshareFile(&blockID)) {
+        fprintf(stderr, "Error copying the file out of a snapshot.\n");
+        return -6;
+    }
+
     if (writeFile(mem_pointer, blockID, start, length)) {
         fprintf(stderr, "Error writing file.\n");
         return -4;
@@ -144,6 +186,251 @@ int sfs_write(int fd, int start, int length, char* mem_pointer) {
     return 1;
 }
 
+/*
+ * sfs_pread: Copies an exact number of bytes stored in a regular file into a specified memory pointer.
+ * Unlike sfs_read, the length is not limited to MAX_IO_LENGTH and nothing past length is written.
+ *
+ * @fd              Integer     the file descriptor pointing to the file to read from
+ * @start           Integer     the starting byte to read from the file
+ * @length          Integer     how many bytes to read from the file
+ * @mem_pointer     String      the buffer to read into, at least length bytes long
+ *
+ * return  1:                   successful execution
+ * return -1:                   error finding opened block id from the file open table
+ * return -2:                   error getting file type
+ * return -3:                   file is not a regular file
+ * return -4:                   error reading file, or reading past its end
+ */
+static int doPread(int fd, size_t start, size_t length, char* mem_pointer) {
+    int blockID;
+
+    // Find the block id corresponding to the file descriptor from the file open table
+    if (find(&blockID, fd)) {
+        fprintf(stderr, "Error finding opened block id from the file open table.\n");
+        return -1;
+    }
+
+    int type;
+
+    if (getType(&type, blockID)) {
+        fprintf(stderr, "Error getting file type.\n");
+        return -2;
+    }
+
+    if (type != FILE) {
+        fprintf(stderr, "File is not a regular file.\n");
+        return -3;
+    }
+
+    followReads(fd, start, length);
+
+    int result = readBytes(mem_pointer, blockID, start, length);
+    setReadAhead(0);
+
+    if (result) {
+        fprintf(stderr, "Error reading file.\n");
+        return -4;
+    }
+
+    return 1;
+}
+
+/*
+ * sfs_pwrite: Writes an exact number of bytes stored in a memory location into a file.
+ * The data may contain null chars, and the length is not limited to MAX_IO_LENGTH.
+ *
+ * @fd              Integer     the file descriptor pointing to the file to write to
+ * @start           Integer     the starting byte to write in the file
+ * @length          Integer     how many bytes to write to the file
+ * @mem_pointer     String      the buffer to write from
+ *
+ * return  1:                   successful execution
+ * return -1:                   error finding opened block id from the file open table
+ * return -2:                   error getting file type
+ * return -3:                   file is not a regular file
+ * return -4:                   error writing file, or writing past the largest file
+ * return -5:                   file system is mounted read-only
+ * return -6:                   error copying the file out of a snapshot
+ */
+static int doPwrite(int fd, size_t start, size_t length, const char* mem_pointer) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -5;
+    }
+
+    int blockID;
+
+    // Find the block id corresponding to the file descriptor from the file open table
+    if (find(&blockID, fd)) {
+        fprintf(stderr, "Error finding opened block id from the file open table.\n");
+        return -1;
+    }
+
+    int type;
+
+    if (getType(&type, blockID)) {
+        fprintf(stderr, "Error getting file type.\n");
+        return -2;
+    }
+
+    if (type != FILE) {
+        fprintf(stderr, "File is not a regular file.\n");
+        return -3;
+    }
+
+    // A range past the largest file is refused before anything is copied or written
+    if (!fitsFile(start, length)) {
+        fprintf(stderr, "Error writing file.\n");
+        return -4;
+    }
+
+    // Blocks shared with a snapshot must not be written in place
+    if (unshareFile(&blockID)) {
+        fprintf(stderr, "Error copying the file out of a snapshot.\n");
+        return -6;
+    }
+
+    if (writeBytes(mem_pointer, blockID, start, length)) {
+        fprintf(stderr, "Error writing file.\n");
+        return -4;
+    }
+
+    return 1;
+}
+
+/*
+ * sfs_readv: Fills an io vector from a regular file in a single pass over its blocks.
+ * The elements of iov are filled one after the other with consecutive bytes of the file.
+ *
+ * @fd              Integer             the file descriptor pointing to the file to read from
+ * @start           Integer             the starting byte to read from the file
+ * @iov             Array of iovec      the buffers to read into
+ * @iovcnt          Integer             number of elements in iov
+ *
+ * return  1:                           successful execution
+ * return -1:                           error finding opened block id from the file open table
+ * return -2:                           error getting file type
+ * return -3:                           file is not a regular file
+ * return -4:                           error reading file, or reading past its end
+ * return -5:                           invalid io vector
+ */
+static int doReadv(int fd, size_t start, const struct iovec* iov, int iovcnt) {
+    if (iovcnt < 0 || (iovcnt > 0 && iov == NULL)) {
+        fprintf(stderr, "Invalid io vector.\n");
+        return -5;
+    }
+
+    int blockID;
+
+    // Find the block id corresponding to the file descriptor from the file open table
+    if (find(&blockID, fd)) {
+        fprintf(stderr, "Error finding opened block id from the file open table.\n");
+        return -1;
+    }
+
+    int type;
+
+    if (getType(&type, blockID)) {
+        fprintf(stderr, "Error getting file type.\n");
+        return -2;
+    }
+
+    if (type != FILE) {
+        fprintf(stderr, "File is not a regular file.\n");
+        return -3;
+    }
+
+    size_t length;
+
+    if (vectorLength(&length, iov, iovcnt)) {
+        fprintf(stderr, "Error reading file.\n");
+        return -4;
+    }
+
+    followReads(fd, start, length);
+
+    int result = readVector(iov, iovcnt, blockID, start);
+    setReadAhead(0);
+
+    if (result) {
+        fprintf(stderr, "Error reading file.\n");
+        return -4;
+    }
+
+    return 1;
+}
+
+/*
+ * sfs_writev: Drains an io vector into a file in a single pass over its blocks.
+ * The elements of iov are written one after the other as consecutive bytes of the file.
+ *
+ * @fd              Integer             the file descriptor pointing to the file to write to
+ * @start           Integer             the starting byte to write in the file
+ * @iov             Array of iovec      the buffers to write from
+ * @iovcnt          Integer             number of elements in iov
+ *
+ * return  1:                           successful execution
+ * return -1:                           error finding opened block id from the file open table
+ * return -2:                           error getting file type
+ * return -3:                           file is not a regular file
+ * return -4:                           error writing file, or writing past the largest file
+ * return -5:                           invalid io vector
+ * return -6:                           file system is mounted read-only
+ * return -7:                           error copying the file out of a snapshot
+ */
+static int doWritev(int fd, size_t start, const struct iovec* iov, int iovcnt) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -6;
+    }
+
+    if (iovcnt < 0 || (iovcnt > 0 && iov == NULL)) {
+        fprintf(stderr, "Invalid io vector.\n");
+        return -5;
+    }
+
+    int blockID;
+
+    // Find the block id corresponding to the file descriptor from the file open table
+    if (find(&blockID, fd)) {
+        fprintf(stderr, "Error finding opened block id from the file open table.\n");
+        return -1;
+    }
+
+    int type;
+
+    if (getType(&type, blockID)) {
+        fprintf(stderr, "Error getting file type.\n");
+        return -2;
+    }
+
+    if (type != FILE) {
+        fprintf(stderr, "File is not a regular file.\n");
+        return -3;
+    }
+
+    size_t length;
+
+    // A range past the largest file is refused before anything is copied or written
+    if (vectorLength(&length, iov, iovcnt) || !fitsFile(start, length)) {
+        fprintf(stderr, "Error writing file.\n");
+        return -4;
+    }
+
+    // Blocks shared with a snapshot must not be written in place
+    if (unshareFile(&blockID)) {
+        fprintf(stderr, "Error copying the file out of a snapshot.\n");
+        return -7;
+    }
+
+    if (writeVector(iov, iovcnt, blockID, start)) {
+        fprintf(stderr, "Error writing file.\n");
+        return -4;
+    }
+
+    return 1;
+}
+
 /*
  * sfs_readdir: Reads a directory's contents into a memory pointer.
  *
@@ -160,7 +447,7 @@ int sfs_write(int fd, int start, int length, char* mem_pointer) {
  * return -6:                   error resetting the step through the directory
  * return -7:                   error reading directory contents
  */
-int sfs_readdir(int fd, char* mem_pointer) {
+static int doReaddir(int fd, char* mem_pointer) {
     int blockID;
 
     for (int i = 0; i < MAX_IO_LENGTH + 1; i++) {
@@ -216,7 +503,7 @@ int sfs_readdir(int fd, char* mem_pointer) {
  * return  1:               successful execution
  * return -1:               error deleting entry in the file open table corresponding to fd
  */
-int sfs_close(int fd) {
+static int doClose(int fd) {
 
     // Delete entry in the file open table
     if (delete(fd)) {
@@ -238,9 +525,15 @@ int sfs_close(int fd) {
  * return -4:               error getting the file type
  * return -5:               error deleting directory
  * return -6:               error deleting file
+ * return -7:               file system is mounted read-only
  */
-int sfs_delete(char* pathname) {
-    char** path = malloc(MAX_PATH);
+static int doDelete(char* pathname) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -7;
+    }
+
+    char** path = malloc(MAX_PATH * sizeof(char*));
 
     for (int i = 0; i < MAX_PATH; i++) {
         path[i] = malloc(MAX_DIRNAME);
@@ -252,7 +545,7 @@ int sfs_delete(char* pathname) {
         return -1;
     }
 
-    char** parent = malloc(MAX_PATH);
+    char** parent = malloc(MAX_PATH * sizeof(char*));
 
     for (int i = 0; i < MAX_PATH - 1; i++) {
         parent[i] = malloc(MAX_DIRNAME);
@@ -266,8 +559,8 @@ int sfs_delete(char* pathname) {
 
     int blockID;
 
-    // Traverse the file system for blockID of the last component
-    if (traverse(&blockID, parent)) {
+    // Traverse the file system for blockID of the directory containing the component
+    if (traverseForWrite(&blockID, parent)) {
         fprintf(stderr, "Error traversing the file system.\n");
         return -3;
     }
@@ -309,9 +602,15 @@ int sfs_delete(char* pathname) {
  * return -3:               error traversing the file system
  * return -4:               error creating the file control block
  * return -5:               error creating file
+ * return -6:               file system is mounted read-only
  */
-int sfs_create(char* pathname, int type) {
-    char** path = malloc(MAX_PATH);
+static int doCreate(char* pathname, int type) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -6;
+    }
+
+    char** path = malloc(MAX_PATH * sizeof(char*));
 
     for (int i = 0; i < MAX_PATH; i++) {
         path[i] = malloc(MAX_DIRNAME);
@@ -323,7 +622,7 @@ int sfs_create(char* pathname, int type) {
         return -1;
     }
 
-    char** parent = malloc(MAX_PATH);
+    char** parent = malloc(MAX_PATH * sizeof(char*));
 
     for (int i = 0; i < MAX_PATH - 1; i++) {
         parent[i] = malloc(MAX_DIRNAME);
@@ -338,7 +637,7 @@ int sfs_create(char* pathname, int type) {
     int parentBlock;
 
     // Traverse the file system for blockID of the directory containing the component
-    if (traverse(&parentBlock, parent)) {
+    if (traverseForWrite(&parentBlock, parent)) {
         fprintf(stderr, "Error traversing the file system.\n");
         return -3;
     }
@@ -358,107 +657,1288 @@ int sfs_create(char* pathname, int type) {
     return 1;
 }
 
-/* sfs_getsize: Gets the size of a file.
+/*
+ * parseBatch: Parses a list of pathnames for a batch operation.
+ * The root directory cannot be part of a batch.
  *
- * @pathname    String      a path to a file.
+ * @paths       Array of Arrays of Strings      the parsed paths
+ * @pathnames   Array of Strings                the unparsed paths
+ * @count       Integer                         number of paths
  *
- * return  size (> -1):     successful execution, file size
- * return           -1:     error parsing the path
- * return           -2:     error finding the parent directory of the file
- * return           -3:     error traversing the file system
- * return           -4:     error getting file size
+ * return  0:                                   successful execution
+ * return -1:                                   error parsing a path
  */
-int sfs_getsize(char* pathname) {
-    char** path = malloc(MAX_PATH);
+static int parseBatch(char*** paths, char** pathnames, int count) {
+    for (int n = 0; n < count; n++) {
+        paths[n] = malloc(MAX_PATH * sizeof(char*));
 
-    for (int i = 0; i < MAX_PATH; i++) {
-        path[i] = malloc(MAX_DIRNAME);
-    }
+        for (int i = 0; i < MAX_PATH; i++) {
+            paths[n][i] = malloc(MAX_DIRNAME + 1);
+        }
 
-    // Parse the pathname
-    if (parsePath(path, pathname)) {
-        fprintf(stderr, "Error parsing the path.\n");
-        return -1;
+        if (parsePath(paths[n], pathnames[n]) || arrayLen(paths[n]) < 2) {
+            fprintf(stderr, "Error parsing the path %s.\n", pathnames[n]);
+            return -1;
+        }
     }
 
-    int blockID;
+    return 0;
+}
 
-    // Traverse the file system for blockID of the last component
-    if (traverse(&blockID, path)) {
-        fprintf(stderr, "Error traversing the file system.\n");
-        return -3;
+/*
+ * freeBatch: Releases the paths parsed by parseBatch.
+ */
+static void freeBatch(char*** paths, int count) {
+    for (int n = 0; n < count; n++) {
+        if (paths[n] == NULL) {
+            continue;
+        }
+
+        for (int i = 0; i < MAX_PATH; i++) {
+            free(paths[n][i]);
+        }
+
+        free(paths[n]);
     }
 
-    int size;
+    free(paths);
+}
 
-    if (getSize(&size, blockID)) {
-        fprintf(stderr, "Error getting file size.\n");
-        return -4;
+/*
+ * sameParent: Checks whether two parsed paths lie in the same directory.
+ */
+static int sameParent(char** a, char** b) {
+    int length = arrayLen(a);
+
+    if (arrayLen(b) != length) {
+        return 0;
     }
 
-    return size;
+    for (int i = 0; i < length - 1; i++) {
+        if (strcmp(a[i], b[i])) {
+            return 0;
+        }
+    }
+
+    return 1;
 }
 
-/* sfs_gettype: Gets the type of a file.
+/*
+ * nextBatch: Picks the next path of a batch to group, by depth.
+ * Creating goes from the shallowest paths down, so directories exist before their
+ * contents; deleting goes from the deepest up, so directories are emptied first.
  *
- * @pathname    String      a path to a file.
+ * @paths       Array of Arrays of Strings      the parsed paths
+ * @done        Integer Array                   which paths are already in a group
+ * @count       Integer                         number of paths
+ * @deepest     Integer                         1 to pick the deepest path, 0 the shallowest
  *
- * return  0:               successful execution, file is a regular file
- * return  1:               successful execution, file is a directory
- * return -1:               error parsing the path
- * return -3:               error traversing the file system
- * return -4:               error getting the file type
+ * return  n (>= 0):                            the path to group next
+ * return -1:                                   every path is in a group
  */
-int sfs_gettype(char* pathname) {
-    char** path = malloc(MAX_PATH);
+static int nextBatch(char*** paths, int* done, int count, int deepest) {
+    int next = -1;
+    int depth = 0;
 
-    for (int i = 0; i < MAX_PATH; i++) {
-        path[i] = malloc(MAX_DIRNAME);
-    }
+    for (int n = 0; n < count; n++) {
+        if (done[n]) {
+            continue;
+        }
 
-    // Parse the pathname
-    if (parsePath(path, pathname)) {
-        fprintf(stderr, "Error parsing the path.\n");
-        return -1;
+        int length = arrayLen(paths[n]);
+
+        if (next == -1 || (deepest ? length > depth : length < depth)) {
+            next = n;
+            depth = length;
+        }
     }
 
-    int blockID;
+    return next;
+}
 
-    // Traverse the file system for blockID of the last component
-    if (traverse(&blockID, path)) {
+/*
+ * groupBatch: Collects the names of every path of a batch lying in the same directory as a first path.
+ * The parent directory is traversed once for the whole group.
+ *
+ * @parent      Integer Pointer                 blockID of the parent directory
+ * @names       Array of Strings                the last components of the paths of the group
+ * @paths       Array of Arrays of Strings      the parsed paths
+ * @done        Integer Array                   which paths are already in a group
+ * @first       Integer                         the first path of the group
+ * @count       Integer                         number of paths
+ *
+ * return  n (> 0):                             successful execution, size of the group
+ * return -1:                                   error traversing the file system
+ */
+static int groupBatch(int* parent, char** names, char*** paths, int* done, int first, int count) {
+    char** dir = malloc(MAX_PATH * sizeof(char*));
+    char* last = malloc(MAX_DIRNAME + 1);
+    int length = arrayLen(paths[first]);
+
+    for (int i = 0; i < length - 1; i++) {
+        dir[i] = paths[first][i];
+    }
+
+    dir[length - 1] = last;
+    last[0] = '\0';
+
+    int result = traverseForWrite(parent, dir);
+    int type;
+
+    free(dir);
+    free(last);
+
+    if (result || getType(&type, *parent) || type != DIRECTORY) {
         fprintf(stderr, "Error traversing the file system.\n");
+        return -1;
+    }
+
+    int n = 0;
+
+    for (int j = first; j < count; j++) {
+        if (!done[j] && sameParent(paths[first], paths[j])) {
+            names[n++] = paths[j][arrayLen(paths[j]) - 1];
+            done[j] = 1;
+        }
+    }
+
+    return n;
+}
+
+/* sfs_create_batch: Creates several files of the same type.
+ * The paths are grouped by parent directory. Each parent is traversed once,
+ * its file control block is written once, and the blocks needed by the group
+ * are found in a single pass. Shallower directories are created first, so a
+ * directory and its contents may be created in one batch. Groups created
+ * before a failing group stay in place.
+ *
+ * @pathnames   Array of Strings    paths to the files.
+ * @count       Integer             number of paths.
+ * @type        Integer             type of every file.
+ *                                      - 0 if regular file
+ *                                      - 1 if directory
+ *
+ * return  1:                       successful execution
+ * return -1:                       error parsing the path
+ * return -3:                       error traversing the file system
+ * return -4:                       error creating the files
+ * return -6:                       file system is mounted read-only
+ */
+static int doCreateBatch(char** pathnames, int count, int type) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -6;
+    }
+
+    char*** paths = calloc(count, sizeof(char**));
+
+    if (parseBatch(paths, pathnames, count)) {
+        freeBatch(paths, count);
+        return -1;
+    }
+
+    int* done = calloc(count, sizeof(int));
+    char** names = malloc(count * sizeof(char*));
+    int result = 1;
+
+    for (int first = nextBatch(paths, done, count, 0); first >= 0 && result == 1; first = nextBatch(paths, done, count, 0)) {
+        int parent;
+        int n = groupBatch(&parent, names, paths, done, first, count);
+
+        if (n < 0) {
+            result = -3;
+        } else if (createBatch(parent, names, n, type)) {
+            fprintf(stderr, "Error creating the files.\n");
+            result = -4;
+        }
+    }
+
+    free(done);
+    free(names);
+    freeBatch(paths, count);
+    return result;
+}
+
+/* sfs_delete_batch: Deletes several files.
+ * The paths are grouped by parent directory. Each parent is traversed once,
+ * and its file control block is written once. Deeper directories are emptied
+ * first, so a directory and its contents may be deleted in one batch. Groups
+ * deleted before a failing group stay deleted.
+ *
+ * @pathnames   Array of Strings    paths to the files.
+ * @count       Integer             number of paths.
+ *
+ * return  1:                       successful execution
+ * return -1:                       error parsing the path
+ * return -3:                       error traversing the file system
+ * return -5:                       error deleting the files
+ * return -7:                       file system is mounted read-only
+ */
+static int doDeleteBatch(char** pathnames, int count) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -7;
+    }
+
+    char*** paths = calloc(count, sizeof(char**));
+
+    if (parseBatch(paths, pathnames, count)) {
+        freeBatch(paths, count);
+        return -1;
+    }
+
+    int* done = calloc(count, sizeof(int));
+    char** names = malloc(count * sizeof(char*));
+    int result = 1;
+
+    for (int first = nextBatch(paths, done, count, 1); first >= 0 && result == 1; first = nextBatch(paths, done, count, 1)) {
+        int parent;
+        int n = groupBatch(&parent, names, paths, done, first, count);
+
+        if (n < 0) {
+            result = -3;
+        } else if (deleteBatch(parent, names, n)) {
+            fprintf(stderr, "Error deleting the files.\n");
+            result = -5;
+        }
+    }
+
+    free(done);
+    free(names);
+    freeBatch(paths, count);
+    return result;
+}
+
+/* sfs_rename: Renames a file without touching its data blocks.
+ * The entry is moved from the file control block of the old parent directory
+ * to the file control block of the new parent directory. A file stored inline
+ * moves with its data. Within one directory the entry is renamed in place.
+ *
+ * @oldpath     String      a path to an existing file.
+ * @newpath     String      the path the file is moved to, which must not exist.
+ *
+ * return  1:               successful execution
+ * return -1:               error parsing the path
+ * return -2:               error finding the parent directory of the file
+ * return -3:               error traversing the file system
+ * return -4:               error getting the file type
+ * return -5:               cannot move the root directory or move a directory into itself
+ * return -6:               error adding entry to the file control block
+ * return -7:               error removing entry from the file control block; the new entry is undone
+ * return -8:               file system is mounted read-only
+ */
+static int doRename(char* oldpath, char* newpath) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -8;
+    }
+
+    char** from = malloc(MAX_PATH * sizeof(char*));
+    char** to = malloc(MAX_PATH * sizeof(char*));
+
+    // parsePath writes a char past the longest name it accepts before it checks the length
+    for (int i = 0; i < MAX_PATH; i++) {
+        from[i] = malloc(MAX_DIRNAME + 1);
+        to[i] = malloc(MAX_DIRNAME + 1);
+    }
+
+    // Parse the pathnames
+    if (parsePath(from, oldpath) || parsePath(to, newpath)) {
+        fprintf(stderr, "Error parsing the path.\n");
+        return -1;
+    }
+
+    int fromLength = arrayLen(from);
+    int toLength = arrayLen(to);
+
+    if (fromLength == 1 || toLength == 1) {
+        fprintf(stderr, "Cannot move the root directory.\n");
+        return -5;
+    }
+
+    char** fromParent = malloc(MAX_PATH * sizeof(char*));
+    char** toParent = malloc(MAX_PATH * sizeof(char*));
+
+    for (int i = 0; i < MAX_PATH - 1; i++) {
+        fromParent[i] = malloc(MAX_DIRNAME + 1);
+        toParent[i] = malloc(MAX_DIRNAME + 1);
+    }
+
+    // Find the parent directories
+    if (dirname(fromParent, from) || dirname(toParent, to)) {
+        fprintf(stderr, "Error finding the parent directory of the file.\n");
         return -2;
     }
 
+    int fromBlock;
+    int toBlock;
+
+    // Traverse the file system for the blockIDs of the directories containing the components
+    if (traverseForWrite(&fromBlock, fromParent) || traverseForWrite(&toBlock, toParent)) {
+        fprintf(stderr, "Error traversing the file system.\n");
+        return -3;
+    }
+
     int type;
+    int start;
 
-    // Get the file type of the file component
-    if (getType(&type, blockID)) {
+    if (getTypeFromFCB(&type, fromBlock, from[fromLength - 1]) || getStart(&start, fromBlock, from[fromLength - 1])) {
         fprintf(stderr, "Error getting the file type.\n");
+        return -4;
+    }
+
+    // A directory cannot become its own descendant
+    if (type == DIRECTORY && toLength > fromLength) {
+        int inside = 1;
+
+        for (int i = 1; i < fromLength && inside; i++) {
+            inside = !strcmp(from[i], to[i]);
+        }
+
+        if (inside) {
+            fprintf(stderr, "Cannot move a directory into itself.\n");
+            return -5;
+        }
+    }
+
+    // Within one directory only the name changes, so no other file is moved out to make room
+    if (fromBlock == toBlock) {
+        if (renameEntry(fromBlock, from[fromLength - 1], to[toLength - 1])) {
+            fprintf(stderr, "Error adding entry to the file control block.\n");
+            return -6;
+        }
+
+        return 1;
+    }
+
+    if (linkEntry(start, toBlock, to[toLength - 1], type)) {
+        fprintf(stderr, "Error adding entry to the file control block.\n");
+        return -6;
+    }
+
+    int removed;
+
+    if (removeEntry(&removed, fromBlock, from[fromLength - 1])) {
+        fprintf(stderr, "Error removing entry from the file control block.\n");
+
+        // Take the new entry back out, so the file keeps the one entry it had
+        int linked;
+
+        if (removeEntry(&linked, toBlock, to[toLength - 1]) == 0 && isInline(start) && !isInline(linked)) {
+            // The inline data had been copied out to a block of its own
+            releaseChain(linked);
+        }
+
+        return -7;
+    }
+
+    // A file stored inline is identified by its entry, which has moved
+    if (isInline(removed)) {
+        int moved;
+
+        if (getStart(&moved, toBlock, to[toLength - 1]) == 0) {
+            renumber(removed, moved);
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * sfs_copy_range: Copies a range of one file into the same range of another file inside the file system.
+ * Data moves block to block without passing through a caller buffer.
+ *
+ * @fd_in           Integer     the file descriptor pointing to the file to copy from
+ * @fd_out          Integer     the file descriptor pointing to the file to copy to
+ * @start           Integer     the starting byte of the range in both files
+ * @length          Integer     how many bytes to copy
+ *
+ * return  1:                   successful execution
+ * return -1:                   error finding opened block id from the file open table
+ * return -2:                   error getting file type
+ * return -3:                   file is not a regular file
+ * return -4:                   error copying file, reading past the end of fd_in, or a range past the largest file
+ * return -5:                   file system is mounted read-only
+ * return -6:                   error copying the file out of a snapshot
+ */
+static int doCopyRange(int fd_in, int fd_out, size_t start, size_t length) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -5;
+    }
+
+    int inBlockID;
+    int outBlockID;
+
+    // Find the block ids corresponding to the file descriptors from the file open table
+    if (find(&inBlockID, fd_in) || find(&outBlockID, fd_out)) {
+        fprintf(stderr, "Error finding opened block id from the file open table.\n");
+        return -1;
+    }
+
+    int inType;
+    int outType;
+
+    if (getType(&inType, inBlockID) || getType(&outType, outBlockID)) {
+        fprintf(stderr, "Error getting file type.\n");
+        return -2;
+    }
+
+    if (inType != FILE || outType != FILE) {
+        fprintf(stderr, "File is not a regular file.\n");
         return -3;
     }
 
-    return type;
+    // A range past the largest file is refused before anything is copied or written
+    if (!fitsFile(start, length)) {
+        fprintf(stderr, "Error copying file.\n");
+        return -4;
+    }
+
+    // Blocks shared with a snapshot must not be written in place
+    if (unshareFile(&outBlockID)) {
+        fprintf(stderr, "Error copying the file out of a snapshot.\n");
+        return -6;
+    }
+
+    if (copyRange(inBlockID, outBlockID, start, length)) {
+        fprintf(stderr, "Error copying file.\n");
+        return -4;
+    }
+
+    return 1;
 }
 
-/* sfs_initialize: Initializes the file system.
+/*
+ * sfs_fallocate: Reserves the blocks of a range of a file up front.
+ * As with posix_fallocate, the file grows to cover the range, and the bytes
+ * added read as zeros. The new blocks are taken in one contiguous run when the
+ * disk has one, so later writes into the range do no allocation.
  *
- * @erase       Integer     If equal to 1 to erase disk while initializing,
- *                          otherwise just initialize the disk
+ * @fd              Integer     the file descriptor pointing to the file
+ * @offset          Integer     the starting byte of the range
+ * @length          Integer     how many bytes the range covers
  *
- * return  1:               successful execution
+ * return  1:                   successful execution
+ * return -1:                   error finding opened block id from the file open table
+ * return -2:                   error getting file type
+ * return -3:                   file is not a regular file
+ * return -4:                   error allocating blocks, or a range past the largest file
+ * return -5:                   file system is mounted read-only
+ * return -6:                   error copying the file out of a snapshot
  */
-int sfs_initialize(int erase) {
-    if (erase == 1) {
-        char* empty = malloc(BLOCK_SIZE);
-        empty[0] = FREE;
+static int doFallocate(int fd, size_t offset, size_t length) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -5;
+    }
 
-        for (int i = 0; i < BLOCKS; i++) {
-            put_block(i, empty);
-        }
+    int blockID;
+
+    // Find the block id corresponding to the file descriptor from the file open table
+    if (find(&blockID, fd)) {
+        fprintf(stderr, "Error finding opened block id from the file open table.\n");
+        return -1;
+    }
+
+    int type;
+
+    if (getType(&type, blockID)) {
+        fprintf(stderr, "Error getting file type.\n");
+        return -2;
+    }
+
+    if (type != FILE) {
+        fprintf(stderr, "File is not a regular file.\n");
+        return -3;
+    }
+
+    // A range past the largest file is refused before anything is copied or written
+    if (!fitsFile(offset, length)) {
+        fprintf(stderr, "Error allocating blocks.\n");
+        return -4;
+    }
+
+    // Blocks shared with a snapshot must not be written in place
+    if (unshareFile(&blockID)) {
+        fprintf(stderr, "Error copying the file out of a snapshot.\n");
+        return -6;
+    }
+
+    if (allocateRange(blockID, offset, length)) {
+        fprintf(stderr, "Error allocating blocks.\n");
+        return -4;
+    }
+
+    return 1;
+}
+
+/*
+ * sfs_truncate: Changes the size of a file.
+ * Shrinking costs time proportional to the part of the file kept: the chain is
+ * ended at the new last block and the blocks after it are freed. Growing adds
+ * zeros, as sfs_fallocate does.
+ *
+ * @fd              Integer     the file descriptor pointing to the file
+ * @length          Integer     the new size of the file
+ *
+ * return  1:                   successful execution
+ * return -1:                   error finding opened block id from the file open table
+ * return -2:                   error getting file type
+ * return -3:                   file is not a regular file
+ * return -4:                   error truncating file, or a size past the largest file
+ * return -5:                   file system is mounted read-only
+ * return -6:                   error copying the file out of a snapshot
+ */
+static int doTruncate(int fd, size_t length) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -5;
+    }
+
+    int blockID;
+
+    // Find the block id corresponding to the file descriptor from the file open table
+    if (find(&blockID, fd)) {
+        fprintf(stderr, "Error finding opened block id from the file open table.\n");
+        return -1;
+    }
+
+    int type;
+
+    if (getType(&type, blockID)) {
+        fprintf(stderr, "Error getting file type.\n");
+        return -2;
+    }
+
+    if (type != FILE) {
+        fprintf(stderr, "File is not a regular file.\n");
+        return -3;
+    }
+
+    // A size past the largest file is refused before anything is copied or written
+    if (!fitsFile(0, length)) {
+        fprintf(stderr, "Error truncating file.\n");
+        return -4;
     }
 
-    sfs_create("/", 1);
+    // Blocks shared with a snapshot must not be written in place
+    if (unshareFile(&blockID)) {
+        fprintf(stderr, "Error copying the file out of a snapshot.\n");
+        return -6;
+    }
+
+    if (truncateFile(blockID, length)) {
+        fprintf(stderr, "Error truncating file.\n");
+        return -4;
+    }
 
     return 1;
 }
+
+/* sfs_getsize: Gets the size of a file.
+ *
+ * @pathname    String      a path to a file.
+ *
+ * return  size (> -1):     successful execution, file size
+ * return           -1:     error parsing the path
+ * return           -2:     error finding the parent directory of the file
+ * return           -3:     error traversing the file system
+ * return           -4:     error getting file size
+ */
+static int doGetsize(char* pathname) {
+    char** path = malloc(MAX_PATH * sizeof(char*));
+
+    for (int i = 0; i < MAX_PATH; i++) {
+        path[i] = malloc(MAX_DIRNAME);
+    }
+
+    // Parse the pathname
+    if (parsePath(path, pathname)) {
+        fprintf(stderr, "Error parsing the path.\n");
+        return -1;
+    }
+
+    int blockID;
+    int type;
+    int size;
+
+    // The index of a sealed disk records the size along with the path
+    if (isSealed() && getRoot() == ROOT_BLOCKID) {
+        if (findSealed(&blockID, &type, &size, path)) {
+            fprintf(stderr, "Error traversing the file system.\n");
+            return -3;
+        }
+
+        return size;
+    }
+
+    // Traverse the file system for blockID of the last component
+    if (traverse(&blockID, path)) {
+        fprintf(stderr, "Error traversing the file system.\n");
+        return -3;
+    }
+
+    if (getSize(&size, blockID)) {
+        fprintf(stderr, "Error getting file size.\n");
+        return -4;
+    }
+
+    return size;
+}
+
+/* sfs_gettype: Gets the type of a file.
+ *
+ * @pathname    String      a path to a file.
+ *
+ * return  0:               successful execution, file is a regular file
+ * return  1:               successful execution, file is a directory
+ * return -1:               error parsing the path
+ * return -3:               error traversing the file system
+ * return -4:               error getting the file type
+ */
+static int doGettype(char* pathname) {
+    char** path = malloc(MAX_PATH * sizeof(char*));
+
+    for (int i = 0; i < MAX_PATH; i++) {
+        path[i] = malloc(MAX_DIRNAME);
+    }
+
+    // Parse the pathname
+    if (parsePath(path, pathname)) {
+        fprintf(stderr, "Error parsing the path.\n");
+        return -1;
+    }
+
+    int blockID;
+
+    // Traverse the file system for blockID of the last component
+    if (traverse(&blockID, path)) {
+        fprintf(stderr, "Error traversing the file system.\n");
+        return -2;
+    }
+
+    int type;
+
+    // Get the file type of the file component
+    if (getType(&type, blockID)) {
+        fprintf(stderr, "Error getting the file type.\n");
+        return -3;
+    }
+
+    return type;
+}
+
+/* sfs_initialize: Initializes the file system.
+ * The live tree is mounted, and every open file is closed.
+ *
+ * Erasing writes only the reserved blocks; the rest of the disk is formatted
+ * a block at a time as the allocator first hands it out.
+ *
+ * @erase       Integer     If equal to 1 to erase disk while initializing,
+ *                          otherwise just initialize the disk
+ *
+ * return  1:               successful execution
+ * return -1:               error formatting the disk
+ * return -2:               error loading the snapshot table
+ * return -3:               error reclaiming the blocks of deleted files
+ * return -4:               error reading the directory tree
+ */
+static int doInitialize(int erase) {
+    int preload = isPreloaded();
+
+    // Nothing held in memory survives a fresh disk or a crash
+    setPreload(0);
+    clearCache();
+
+    // The hot blocks of the last session are read back first, so the mount itself is served from memory
+    if (erase == 1) {
+        remove(HOT_FILE);
+    } else if (isWarmup()) {
+        warmCache(HOT_FILE);
+    }
+
+    if (erase == 1) {
+        if (formatDisk() || loadSeal() || createSnapshotTable() || createOrphanList()) {
+            fprintf(stderr, "Error formatting the disk.\n");
+            return -1;
+        }
+    } else if (loadBitmap() || loadSeal() || loadGeneration()) {
+        fprintf(stderr, "Error loading the snapshot table.\n");
+        return -2;
+    } else if (reclaimBlocks(0) < 0) {
+        // Finish the reclamation left over from the last session
+        fprintf(stderr, "Error reclaiming the blocks of deleted files.\n");
+        return -3;
+    }
+
+    // Descriptors opened on the disk as it was are stale
+    openTable.length = 0;
+    mountSnapshot(NULL);
+
+    // Reindex the mounted tree
+    setDedup(isDedup());
+
+    int type;
+
+    // Keep the root directory of a disk that is already initialized
+    if (erase == 1 || getType(&type, ROOT_BLOCKID) || type != DIRECTORY) {
+        sfs_create("/", 1);
+    }
+
+    if (setPreload(preload)) {
+        fprintf(stderr, "Error reading the directory tree.\n");
+        return -4;
+    }
+
+    return 1;
+}
+
+/* sfs_snapshot: Freezes the live tree under a name.
+ * Only the root directory is copied; everything else is shared with the
+ * snapshot until the live tree writes it, and is not freed before the
+ * snapshot is deleted. Generations are counted in a byte, so at most 254
+ * snapshots can be taken before every snapshot has been deleted again.
+ *
+ * @name        String      name of the snapshot, at most six characters
+ *
+ * return  1:               successful execution
+ * return -1:               file system is mounted read-only
+ * return -2:               error creating the snapshot
+ * return -3:               no generations left until every snapshot is deleted
+ */
+static int doSnapshot(char* name) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -1;
+    }
+
+    // Orphaned blocks would otherwise be shared with the snapshot and never freed
+    if (reclaimBlocks(0) < 0) {
+        fprintf(stderr, "Error reclaiming the blocks of deleted files.\n");
+        return -2;
+    }
+
+    switch (createSnapshot(name)) {
+        case 0:
+            return 1;
+        case -6:
+            return -3;
+        default:
+            fprintf(stderr, "Error creating the snapshot.\n");
+            return -2;
+    }
+}
+
+/* sfs_delete_snapshot: Deletes a snapshot, freeing the blocks only it held.
+ * The disk is swept as sfs_fsck does with repair, so every block that nothing
+ * reaches any more is freed, and every reference count is brought down to
+ * the pointers left.
+ *
+ * @name        String      name of the snapshot
+ *
+ * return  1:               successful execution
+ * return -1:               file system is mounted read-only
+ * return -2:               no such snapshot
+ * return -3:               error freeing the blocks of the snapshot
+ */
+static int doDeleteSnapshot(char* name) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -1;
+    }
+
+    switch (deleteSnapshot(name)) {
+        case 0:
+            break;
+        case -1:
+            return -2;
+        default:
+            fprintf(stderr, "Error freeing the blocks of the snapshot.\n");
+            return -3;
+    }
+
+    // The blocks were restamped or freed behind everything held in memory
+    clearCache();
+
+    struct sfs_fsck report;
+
+    if (checkImage(1, &report) || setPreload(isPreloaded()) || setDedup(isDedup())) {
+        fprintf(stderr, "Error freeing the blocks of the snapshot.\n");
+        return -3;
+    }
+
+    return 1;
+}
+
+/* sfs_mount: Mounts a snapshot read-only, or the live tree.
+ * Every open file must be closed first, since its descriptor points into
+ * the tree mounted now.
+ *
+ * @name        String      name of the snapshot, or NULL for the live tree
+ *
+ * return  1:               successful execution
+ * return -1:               error mounting the snapshot
+ * return -2:               files are still open
+ */
+static int doMount(char* name) {
+    if (openTable.length > 0) {
+        fprintf(stderr, "Files are still open.\n");
+        return -2;
+    }
+
+    if (mountSnapshot(name)) {
+        fprintf(stderr, "Error mounting the snapshot.\n");
+        return -1;
+    }
+
+    // Reindex the mounted tree
+    setDedup(isDedup());
+    setPreload(isPreloaded());
+
+    return 1;
+}
+
+/* sfs_dedup: Turns deduplication of file blocks on or off.
+ * While it is on, every file block written that is identical to a block already
+ * on disk is replaced by a reference to that block. Turning it on indexes the
+ * mounted tree in one pass.
+ *
+ * @enable      Integer     1 to turn deduplication on, 0 to turn it off
+ *
+ * return  1:               successful execution
+ * return -1:               error indexing the file blocks
+ */
+static int doDedup(int enable) {
+    if (setDedup(enable)) {
+        fprintf(stderr, "Error indexing the file blocks.\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+/* sfs_reclaim: Frees the blocks of deleted files.
+ * Deleting a file only hands its chain over to the reclaimer; the blocks are
+ * freed here, a batch at a time, or when the allocator runs out of free blocks.
+ *
+ * @blocks      Integer     how many blocks to release at most, or 0 for all of them
+ *
+ * return >=0:              number of blocks released
+ * return -1:               error reclaiming the blocks
+ */
+static int doReclaim(int blocks) {
+    int released = reclaimBlocks(blocks);
+
+    if (released < 0) {
+        fprintf(stderr, "Error reclaiming the blocks of deleted files.\n");
+        return -1;
+    }
+
+    return released;
+}
+
+/* sfs_preload: Holds every directory of the mounted tree in memory.
+ * The directories are read in one pass, now and whenever a tree is mounted;
+ * lookups are then served from memory, and changes are written through to disk.
+ *
+ * @enable      Integer     1 to hold the directory tree in memory, 0 to read every directory from disk
+ *
+ * return  1:               successful execution
+ * return -1:               error reading the directory tree
+ */
+static int doPreload(int enable) {
+    if (setPreload(enable)) {
+        fprintf(stderr, "Error reading the directory tree.\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+/* sfs_seal: Seals the disk, which is read-only from then on.
+ * Every path of the live tree is indexed with a perfect hash, so that opening
+ * a file or getting its size reads at most one block. Only erasing the disk
+ * makes it writable again.
+ *
+ * return  1:               successful execution
+ * return -1:               file system is mounted read-only
+ * return -2:               error building the index
+ */
+static int doSeal() {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -1;
+    }
+
+    if (sealImage()) {
+        fprintf(stderr, "Error building the index.\n");
+        return -2;
+    }
+
+    return 1;
+}
+
+/* sfs_defrag: Rewrites the fragmented file chains of the live tree into contiguous runs,
+ * so that reading a file sweeps the disk forward. Open files follow their chains.
+ * The fragmentation score is the share of the links between the blocks of every file
+ * chain that jump to a block other than the next one, from 0 to 1.
+ *
+ * @directories Integer         1 to also move every directory nearer its parent
+ * @before      Double Pointer  the fragmentation score before, or NULL
+ * @after       Double Pointer  the fragmentation score after, or NULL
+ *
+ * return  1:                   successful execution
+ * return -1:                   file system is mounted read-only
+ * return -2:                   error moving the blocks
+ */
+static int doDefrag(int directories, double* before, double* after) {
+    if (isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -1;
+    }
+
+    if (defragment(directories, before, after)) {
+        fprintf(stderr, "Error moving the blocks.\n");
+        return -2;
+    }
+
+    return 1;
+}
+
+/* sfs_fsck: Checks the consistency of the disk. The disk is read once, in order, and every
+ * block is checked to be reachable from the root directory, the snapshots or the orphan list
+ * exactly as often as it should be: chains that loop, blocks claimed by more files than refer
+ * to them, blocks in use that nothing reaches, and entries or links that lead to free blocks
+ * are counted in the report. A repair cuts the bad pointers and frees the leaked blocks.
+ *
+ * @repair      Integer             1 to repair the problems found
+ * @report      sfs_fsck Pointer    the problems found, or NULL
+ *
+ * return  1:                       successful execution
+ * return -1:                       file system is mounted read-only
+ * return -2:                       error reading the disk
+ * return -3:                       error writing the repairs
+ */
+static int doFsck(int repair, struct sfs_fsck* report) {
+    struct sfs_fsck found;
+
+    if (repair && isReadOnly()) {
+        fprintf(stderr, "File system is mounted read-only.\n");
+        return -1;
+    }
+
+    switch (checkImage(repair, report != NULL ? report : &found)) {
+        case 0:
+            return 1;
+        case -1:
+            fprintf(stderr, "Error reading the disk.\n");
+            return -2;
+        default:
+            fprintf(stderr, "Error writing the repairs.\n");
+            return -3;
+    }
+}
+
+/* sfs_warmup: Keeps the cache warm across restarts. On a clean shutdown the blocks used
+ * most are listed in a side file next to the disk, and the next time the disk is initialized
+ * without erasing it they are read back into the cache before the first lookup.
+ *
+ * @enable      Integer     1 to save and reload the hot blocks, 0 to start every mount cold
+ *
+ * return  1:               successful execution
+ */
+static int doWarmup(int enable) {
+    setWarmup(enable);
+
+    return 1;
+}
+
+/* sfs_shutdown: Shuts the file system down cleanly. Every file descriptor is closed and,
+ * with warm-up on, the hot blocks of the cache are saved for the next mount.
+ * Everything else is already on disk, since every write goes through.
+ *
+ * return  1:               successful execution
+ * return -1:               error saving the hot blocks
+ */
+static int doShutdown() {
+    openTable.length = 0;
+
+    if (isWarmup() && saveHotBlocks(HOT_FILE)) {
+        fprintf(stderr, "Error saving the hot blocks.\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+/*
+ * The public operations: each one runs the implementation above,
+ * is timed and counted in the statistics, and is a span of the trace.
+ */
+int sfs_open(char* pathname) {
+    TRACE("sfs_open");
+    long began = beginOp(OP_OPEN);
+
+    return endOp(OP_OPEN, began, doOpen(pathname));
+}
+
+int sfs_read(int fd, int start, int length, char* mem_pointer) {
+    TRACE("sfs_read");
+    long began = beginOp(OP_READ);
+
+    return endOp(OP_READ, began, doRead(fd, start, length, mem_pointer));
+}
+
+int sfs_write(int fd, int start, int length, char* mem_pointer) {
+    TRACE("sfs_write");
+    long began = beginOp(OP_WRITE);
+
+    return endOp(OP_WRITE, began, doWrite(fd, start, length, mem_pointer));
+}
+
+int sfs_pread(int fd, size_t start, size_t length, char* mem_pointer) {
+    TRACE("sfs_pread");
+    long began = beginOp(OP_PREAD);
+
+    return endOp(OP_PREAD, began, doPread(fd, start, length, mem_pointer));
+}
+
+int sfs_pwrite(int fd, size_t start, size_t length, const char* mem_pointer) {
+    TRACE("sfs_pwrite");
+    long began = beginOp(OP_PWRITE);
+
+    return endOp(OP_PWRITE, began, doPwrite(fd, start, length, mem_pointer));
+}
+
+int sfs_readv(int fd, size_t start, const struct iovec* iov, int iovcnt) {
+    TRACE("sfs_readv");
+    long began = beginOp(OP_READV);
+
+    return endOp(OP_READV, began, doReadv(fd, start, iov, iovcnt));
+}
+
+int sfs_writev(int fd, size_t start, const struct iovec* iov, int iovcnt) {
+    TRACE("sfs_writev");
+    long began = beginOp(OP_WRITEV);
+
+    return endOp(OP_WRITEV, began, doWritev(fd, start, iov, iovcnt));
+}
+
+int sfs_readdir(int fd, char* mem_pointer) {
+    TRACE("sfs_readdir");
+    long began = beginOp(OP_READDIR);
+
+    return endOp(OP_READDIR, began, doReaddir(fd, mem_pointer));
+}
+
+int sfs_close(int fd) {
+    TRACE("sfs_close");
+    long began = beginOp(OP_CLOSE);
+
+    return endOp(OP_CLOSE, began, doClose(fd));
+}
+
+int sfs_delete(char* pathname) {
+    TRACE("sfs_delete");
+    long began = beginOp(OP_DELETE);
+
+    return endOp(OP_DELETE, began, doDelete(pathname));
+}
+
+int sfs_create(char* pathname, int type) {
+    TRACE("sfs_create");
+    long began = beginOp(OP_CREATE);
+
+    return endOp(OP_CREATE, began, doCreate(pathname, type));
+}
+
+int sfs_create_batch(char** pathnames, int count, int type) {
+    TRACE("sfs_create_batch");
+    long began = beginOp(OP_CREATE_BATCH);
+
+    return endOp(OP_CREATE_BATCH, began, doCreateBatch(pathnames, count, type));
+}
+
+int sfs_delete_batch(char** pathnames, int count) {
+    TRACE("sfs_delete_batch");
+    long began = beginOp(OP_DELETE_BATCH);
+
+    return endOp(OP_DELETE_BATCH, began, doDeleteBatch(pathnames, count));
+}
+
+int sfs_rename(char* oldpath, char* newpath) {
+    TRACE("sfs_rename");
+    long began = beginOp(OP_RENAME);
+
+    return endOp(OP_RENAME, began, doRename(oldpath, newpath));
+}
+
+int sfs_copy_range(int fd_in, int fd_out, size_t start, size_t length) {
+    TRACE("sfs_copy_range");
+    long began = beginOp(OP_COPY_RANGE);
+
+    return endOp(OP_COPY_RANGE, began, doCopyRange(fd_in, fd_out, start, length));
+}
+
+int sfs_fallocate(int fd, size_t offset, size_t length) {
+    TRACE("sfs_fallocate");
+    long began = beginOp(OP_FALLOCATE);
+
+    return endOp(OP_FALLOCATE, began, doFallocate(fd, offset, length));
+}
+
+int sfs_truncate(int fd, size_t length) {
+    TRACE("sfs_truncate");
+    long began = beginOp(OP_TRUNCATE);
+
+    return endOp(OP_TRUNCATE, began, doTruncate(fd, length));
+}
+
+int sfs_getsize(char* pathname) {
+    TRACE("sfs_getsize");
+    long began = beginOp(OP_GETSIZE);
+
+    return endOp(OP_GETSIZE, began, doGetsize(pathname));
+}
+
+int sfs_gettype(char* pathname) {
+    TRACE("sfs_gettype");
+    long began = beginOp(OP_GETTYPE);
+
+    return endOp(OP_GETTYPE, began, doGettype(pathname));
+}
+
+int sfs_initialize(int erase) {
+    TRACE("sfs_initialize");
+    long began = beginOp(OP_INITIALIZE);
+
+    return endOp(OP_INITIALIZE, began, doInitialize(erase));
+}
+
+int sfs_snapshot(char* name) {
+    TRACE("sfs_snapshot");
+    long began = beginOp(OP_SNAPSHOT);
+
+    return endOp(OP_SNAPSHOT, began, doSnapshot(name));
+}
+
+int sfs_delete_snapshot(char* name) {
+    TRACE("sfs_delete_snapshot");
+    long began = beginOp(OP_DELETE_SNAPSHOT);
+
+    return endOp(OP_DELETE_SNAPSHOT, began, doDeleteSnapshot(name));
+}
+
+int sfs_mount(char* name) {
+    TRACE("sfs_mount");
+    long began = beginOp(OP_MOUNT);
+
+    return endOp(OP_MOUNT, began, doMount(name));
+}
+
+int sfs_dedup(int enable) {
+    TRACE("sfs_dedup");
+    long began = beginOp(OP_DEDUP);
+
+    return endOp(OP_DEDUP, began, doDedup(enable));
+}
+
+int sfs_reclaim(int blocks) {
+    TRACE("sfs_reclaim");
+    long began = beginOp(OP_RECLAIM);
+
+    return endOp(OP_RECLAIM, began, doReclaim(blocks));
+}
+
+int sfs_preload(int enable) {
+    TRACE("sfs_preload");
+    long began = beginOp(OP_PRELOAD);
+
+    return endOp(OP_PRELOAD, began, doPreload(enable));
+}
+
+int sfs_seal() {
+    TRACE("sfs_seal");
+    long began = beginOp(OP_SEAL);
+
+    return endOp(OP_SEAL, began, doSeal());
+}
+
+int sfs_defrag(int directories, double* before, double* after) {
+    TRACE("sfs_defrag");
+    long began = beginOp(OP_DEFRAG);
+
+    return endOp(OP_DEFRAG, began, doDefrag(directories, before, after));
+}
+
+int sfs_fsck(int repair, struct sfs_fsck* report) {
+    TRACE("sfs_fsck");
+    long began = beginOp(OP_FSCK);
+
+    return endOp(OP_FSCK, began, doFsck(repair, report));
+}
+
+int sfs_warmup(int enable) {
+    TRACE("sfs_warmup");
+    long began = beginOp(OP_WARMUP);
+
+    return endOp(OP_WARMUP, began, doWarmup(enable));
+}
+
+int sfs_shutdown() {
+    TRACE("sfs_shutdown");
+    long began = beginOp(OP_SHUTDOWN);
+
+    return endOp(OP_SHUTDOWN, began, doShutdown());
+}
+
+/* sfs_stats: Takes a snapshot of the statistics of every public operation: how many
+ * times it ran and failed, the blocks it read and wrote, its calls to the allocator,
+ * the directory blocks it found in memory or had to read, and a histogram of its latencies.
+ * Operations called from inside another are counted as part of the outer one.
+ *
+ * @stats       sfs_stats Pointer   where the statistics are copied to, or NULL
+ * @reset       Integer             1 to start counting again from zero
+ *
+ * return  1:                       successful execution
+ */
+int sfs_stats(struct sfs_stats* stats, int reset) {
+    getStats(stats, reset);
+
+    return 1;
+}
+
+/* sfs_percentile: Gets a percentile of the latencies of an operation, to within
+ * 1/LATENCY_SUBBUCKETS of its value.
+ *
+ * @op          sfs_opstats Pointer     the statistics of the operation
+ * @fraction    Double                  the percentile, between 0 and 1
+ *
+ * return unsigned long:                the latency in nanoseconds, or 0 if the operation never ran
+ */
+unsigned long sfs_percentile(const struct sfs_opstats* op, double fraction) {
+    return getPercentile(op, fraction);
+}
+
+/* sfs_trace: Writes every span traced so far to a file, as Chrome trace events that
+ * a trace viewer loads as they are. Spans are only traced when the file system is
+ * compiled with -DSFS_TRACE, and each thread keeps the most recent TRACE_EVENTS of them.
+ *
+ * @filename    String      the file to write
+ *
+ * return  1:               successful execution
+ * return -1:               the file system was compiled without tracing
+ * return -2:               error writing the file
+ */
+int sfs_trace(const char* filename) {
+    switch (exportTrace(filename)) {
+        case 0:
+            return 1;
+        case -1:
+            return -1;
+        default:
+            fprintf(stderr, "Error writing the trace.\n");
+            return -2;
+    }
+}
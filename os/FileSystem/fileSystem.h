@@ -7,6 +7,51 @@
 #define BLOCK_SIZE      128
 #define MAX_IO_LENGTH   1024
 
+#define SFS_OPS             32
+#define LATENCY_BITS        4
+#define LATENCY_SUBBUCKETS  (1 << LATENCY_BITS)
+#define LATENCY_BUCKETS     (38 * LATENCY_SUBBUCKETS)
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+// This header is included more than once, but the structures may only be defined once
+#ifndef SFS_STATS_DEFINED
+#define SFS_STATS_DEFINED
+
+// Statistics of one public operation; latencies are in nanoseconds
+struct sfs_opstats {
+    const char* name;
+    unsigned long calls;
+    unsigned long errors;
+    unsigned long blockReads;
+    unsigned long blockWrites;
+    unsigned long allocations;
+    unsigned long cacheHits;
+    unsigned long cacheMisses;
+    unsigned long totalTime;
+    unsigned long maxTime;
+    unsigned long latencies[LATENCY_BUCKETS];
+};
+
+// Statistics of every public operation, and of the work done outside them
+struct sfs_stats {
+    struct sfs_opstats ops[SFS_OPS];
+};
+
+// Problems found by a check of the disk; a problem repaired is counted as well
+struct sfs_fsck {
+    int blocks;         // blocks read
+    int reachable;      // blocks reachable from the root, the snapshots and the orphan list
+    int loops;          // chains that lead back into themselves
+    int crossLinked;    // pointers to a block already claimed by as many as it may have
+    int leaked;         // blocks in use but unreachable, or counting more references than point at them
+    int dangling;       // pointers to a free block, a block off the disk, or a block of the wrong type
+    int repaired;       // problems repaired
+};
+
+#endif
+
 // Opens a file descriptor to the file.
 int sfs_open(char* pathname);
 
@@ -16,6 +61,18 @@ int sfs_read(int fd, int start, int length, char* mem_pointer);
 // Writes data stored in a memory location into a file
 int sfs_write(int fd, int start, int length, char* mem_pointer);
 
+// Copies an exact number of bytes stored in a regular file into a specified memory pointer
+int sfs_pread(int fd, size_t start, size_t length, char* mem_pointer);
+
+// Writes an exact number of bytes stored in a memory location into a file
+int sfs_pwrite(int fd, size_t start, size_t length, const char* mem_pointer);
+
+// Fills an io vector from a regular file in a single pass over its blocks
+int sfs_readv(int fd, size_t start, const struct iovec* iov, int iovcnt);
+
+// Drains an io vector into a file in a single pass over its blocks
+int sfs_writev(int fd, size_t start, const struct iovec* iov, int iovcnt);
+
 // Reads a directory's contents into a memory pointer
 int sfs_readdir(int fd, char* mem_pointer);
 
@@ -28,6 +85,24 @@ int sfs_delete(char* pathname);
 // Creates a file.
 int sfs_create(char* pathname, int type);
 
+// Creates several files, writing each parent directory once.
+int sfs_create_batch(char** pathnames, int count, int type);
+
+// Deletes several files, writing each parent directory once.
+int sfs_delete_batch(char** pathnames, int count);
+
+// Renames a file without touching its data blocks.
+int sfs_rename(char* oldpath, char* newpath);
+
+// Copies a range of one file into the same range of another file inside the file system.
+int sfs_copy_range(int fd_in, int fd_out, size_t start, size_t length);
+
+// Reserves the blocks of a range of a file up front.
+int sfs_fallocate(int fd, size_t offset, size_t length);
+
+// Changes the size of a file.
+int sfs_truncate(int fd, size_t length);
+
 // Gets the size of a file.
 int sfs_getsize(char* pathname);
 
@@ -36,3 +111,45 @@ int sfs_gettype(char* pathname);
 
 // Initializes the file system
 int sfs_initialize(int erase);
+
+// Freezes the live tree under a name
+int sfs_snapshot(char* name);
+
+// Deletes a snapshot, freeing the blocks only it held
+int sfs_delete_snapshot(char* name);
+
+// Mounts a snapshot read-only, or the live tree
+int sfs_mount(char* name);
+
+// Turns deduplication of file blocks on or off
+int sfs_dedup(int enable);
+
+// Holds every directory of the mounted tree in memory
+int sfs_preload(int enable);
+
+// Frees the blocks of deleted files
+int sfs_reclaim(int blocks);
+
+// Seals the disk, which is read-only from then on
+int sfs_seal();
+
+// Saves the hot blocks of the cache on shutdown and reads them back on mount
+int sfs_warmup(int enable);
+
+// Shuts the file system down cleanly
+int sfs_shutdown();
+
+// Rewrites fragmented file chains into contiguous runs
+int sfs_defrag(int directories, double* before, double* after);
+
+// Checks the consistency of the disk, repairing it if asked
+int sfs_fsck(int repair, struct sfs_fsck* report);
+
+// Takes a snapshot of the statistics of every public operation
+int sfs_stats(struct sfs_stats* stats, int reset);
+
+// Gets a percentile of the latencies of an operation
+unsigned long sfs_percentile(const struct sfs_opstats* op, double fraction);
+
+// Writes the spans traced so far as Chrome trace events
+int sfs_trace(const char* filename);
@@ -0,0 +1,424 @@
+/*
+ * fsck.c
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "blockio.h"
+#include "cache.h"
+#include "fileSystem.h"
+#include "dedup.h"
+#include "dirTree.h"
+#include "entry.h"
+#include "fControl.h"
+#include "fsck.h"
+#include "pathUtils.h"
+#include "reclaim.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "storeInt.h"
+#include "superblock.h"
+
+/*
+ * The whole disk is read into memory in order, FSCK_RUN blocks per request, so a check
+ * costs one sequential pass over the disk however the blocks point at each other.
+ * The blocks are then decoded into a graph on every core, each thread taking its own
+ * share of the blocks: the type of each block, and the blocks it points at, which are the
+ * starting blocks of the entries of a directory or the snapshot table, the next block of
+ * a file chain, or the chains waiting in the orphan list.
+ *
+ * The graph is walked from the root directory, the snapshot table and the orphan list.
+ * Every pointer followed claims its target. A directory may be claimed once, and a file
+ * block as many times as its reference count allows; a block shared with a snapshot may be
+ * claimed by every tree that holds it. A pointer that claims a block beyond that is cross-linked,
+ * a chain that comes back to one of its own blocks loops, and a pointer to a free block,
+ * a block off the disk or a block of the wrong type dangles. Blocks in use that nothing
+ * claims are leaked, and so is a file block claimed fewer times than its reference count,
+ * since releasing the pointers left would never free it.
+ *
+ * A repair cuts every bad pointer, ending its chain or freeing its entry, frees every
+ * leaked block and lowers every reference count to the claims on the block. The blocks
+ * changed are written back in one batch.
+ */
+
+// Contents of the disk
+static char image[BLOCKS][BLOCK_SIZE];
+
+// Type of each block, FREE for one never formatted
+static char kinds[BLOCKS];
+
+// Blocks each block points at, where each pointer is in the block, and the type it must lead to
+static int pointers[BLOCKS][ORPHAN_SLOTS];
+static int positions[BLOCKS][ORPHAN_SLOTS];
+static char expected[BLOCKS][ORPHAN_SLOTS];
+static int counts[BLOCKS];
+
+// Whether each block was reached, how many pointers claimed it, and the last chain walked through it
+static char visited[BLOCKS];
+static int claims[BLOCKS];
+static int stamps[BLOCKS];
+static int walks = 0;
+
+// Blocks changed by the repairs
+static char dirty[BLOCKS];
+
+/*
+ * addPointer: Records a pointer out of a block.
+ */
+static void addPointer(int blockID, int target, int position, int type) {
+    int k = counts[blockID]++;
+
+    pointers[blockID][k] = target;
+    positions[blockID][k] = position;
+    expected[blockID][k] = type;
+}
+
+/*
+ * decodeBlock: Finds the type of a block and the blocks it points at.
+ *
+ * @blockID     Integer     the block, read into the image
+ */
+static void decodeBlock(int blockID) {
+    char* block = image[blockID];
+
+    counts[blockID] = 0;
+    kinds[blockID] = isFormatted(blockID) ? block[BLOCK_START] : FREE;
+
+    if (blockID == ORPHAN_BLOCKID && kinds[blockID] == META) {
+        for (int slot = 0; slot < ORPHAN_SLOTS; slot++) {
+            int position = ENTRY_START + slot * START;
+            int start = decode_int(&block[position]);
+
+            if (start != BLOCK_END) {
+                addPointer(blockID, start, position, FILE);
+            }
+        }
+    } else if (kinds[blockID] == DIRECTORY || (blockID == SNAPSHOT_BLOCKID && kinds[blockID] == META)) {
+        for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+            char* line = &block[i];
+
+            // Entries free or stored inline lead to no blocks
+            if ((line[TYPE_P] != FILE && line[TYPE_P] != DIRECTORY) || line[NAME_P] == '\0') {
+                continue;
+            }
+
+            addPointer(blockID, decode_int(&line[START_P]), i + START_P, line[TYPE_P]);
+        }
+    } else if (kinds[blockID] == FILE) {
+        int next = decode_int(&block[NEXT_BLOCK]);
+
+        if (next != BLOCK_END) {
+            addPointer(blockID, next, NEXT_BLOCK, FILE);
+        }
+    }
+}
+
+/*
+ * decodeShare: Decodes the blocks of one thread's share, from share[0] up to share[1].
+ */
+static void* decodeShare(void* arg) {
+    const int* share = arg;
+
+    for (int blockID = share[0]; blockID < share[1]; blockID++) {
+        decodeBlock(blockID);
+    }
+
+    return NULL;
+}
+
+/*
+ * decodeImage: Decodes every block of the image, splitting the blocks between the cores.
+ * A share the system cannot start a thread for is decoded by the caller.
+ */
+static void decodeImage() {
+    pthread_t workers[FSCK_THREADS];
+    int started[FSCK_THREADS];
+    int shares[FSCK_THREADS + 1];
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores < 1 ? 1 : cores > FSCK_THREADS ? FSCK_THREADS : cores;
+
+    // Every thread gets at least FSCK_GRAIN blocks, or it costs more than it saves
+    if (threads > BLOCKS / FSCK_GRAIN) {
+        threads = BLOCKS / FSCK_GRAIN > 0 ? BLOCKS / FSCK_GRAIN : 1;
+    }
+
+    for (int t = 0; t <= threads; t++) {
+        shares[t] = (int) ((long) t * BLOCKS / threads);
+    }
+
+    for (int t = 1; t < threads; t++) {
+        started[t] = !pthread_create(&workers[t], NULL, decodeShare, &shares[t]);
+    }
+
+    decodeShare(&shares[0]);
+
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) {
+            pthread_join(workers[t], NULL);
+        } else {
+            decodeShare(&shares[t]);
+        }
+    }
+}
+
+/*
+ * readImage: Reads the whole disk into memory in order, a run of blocks per request.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the blocks
+ */
+static int readImage() {
+    for (int blockID = 0; blockID < BLOCKS; blockID += FSCK_RUN) {
+        int count = BLOCKS - blockID < FSCK_RUN ? BLOCKS - blockID : FSCK_RUN;
+
+        if (get_run(blockID, count, image[blockID])) {
+            fprintf(stderr, "Error retrieving blocks %d to %d.\n", blockID, blockID + count - 1);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * mayClaim: Gets how many pointers may claim a block.
+ */
+static int mayClaim(int blockID) {
+    const char* block = image[blockID];
+
+    // Every tree holding a block shared with a snapshot points at it
+    if (isShared(block)) {
+        return BLOCKS;
+    }
+
+    if (kinds[blockID] == FILE && (unsigned char) block[REFS_P] > 1) {
+        return (unsigned char) block[REFS_P];
+    }
+
+    return 1;
+}
+
+/*
+ * cutPointer: Removes a bad pointer from a block: an entry is freed, as removing it
+ * would, and a chain or a slot of the orphan list is ended.
+ */
+static void cutPointer(int blockID, int k) {
+    char* block = image[blockID];
+    int position = positions[blockID][k];
+
+    if (kinds[blockID] == DIRECTORY || blockID == SNAPSHOT_BLOCKID) {
+        int entry = position - START_P;
+
+        block[entry] = ENTRY_END;
+        memset(&block[entry + 1], 0, ENTRY_LENGTH - 1);
+    } else {
+        char* end = encode_int(BLOCK_END);
+        block[position] = end[0];
+        block[position + 1] = end[1];
+        free(end);
+    }
+
+    dirty[blockID] = 1;
+}
+
+/*
+ * claim: Follows one pointer out of a reachable block.
+ *
+ * @report      sfs_fsck Pointer    problems found so far
+ * @repair      Integer             1 to cut the pointer if it is bad
+ * @blockID     Integer             the block
+ * @k           Integer             which of its pointers
+ * @walk        Integer             the chain being walked, or 0 for a pointer out of a directory
+ *
+ * return 1:                        the target was reached for the first time
+ * return 0:                        the target was reached before, or the pointer is bad
+ */
+static int claim(struct sfs_fsck* report, int repair, int blockID, int k, int walk) {
+    int target = pointers[blockID][k];
+
+    if (target < 0 || target >= BLOCKS || kinds[target] == FREE || kinds[target] != expected[blockID][k]) {
+        report->dangling++;
+    } else if (walk > 0 && stamps[target] == walk) {
+        report->loops++;
+    } else if (claims[target] == mayClaim(target)) {
+        report->crossLinked++;
+    } else {
+        claims[target]++;
+
+        if (visited[target]) {
+            return 0;
+        }
+
+        visited[target] = 1;
+        report->reachable++;
+
+        return 1;
+    }
+
+    if (repair) {
+        cutPointer(blockID, k);
+        report->repaired++;
+    }
+
+    return 0;
+}
+
+/*
+ * walkChain: Walks a file chain from its starting block, which was just reached.
+ */
+static void walkChain(struct sfs_fsck* report, int repair, int start) {
+    int walk = ++walks;
+
+    for (int blockID = start;; blockID = pointers[blockID][0]) {
+        stamps[blockID] = walk;
+
+        if (counts[blockID] == 0 || !claim(report, repair, blockID, 0, walk)) {
+            break;
+        }
+    }
+}
+
+/*
+ * walkTree: Walks every directory and chain reachable from a block that holds entries.
+ */
+static void walkTree(struct sfs_fsck* report, int repair, int root) {
+    int stack[BLOCKS];
+    int depth = 0;
+
+    stack[depth++] = root;
+
+    while (depth > 0) {
+        int blockID = stack[--depth];
+
+        for (int k = 0; k < counts[blockID]; k++) {
+            if (!claim(report, repair, blockID, k, 0)) {
+                continue;
+            }
+
+            int target = pointers[blockID][k];
+
+            if (kinds[target] == DIRECTORY) {
+                stack[depth++] = target;
+            } else {
+                walkChain(report, repair, target);
+            }
+        }
+    }
+}
+
+/*
+ * writeRepairs: Writes back every block a repair changed, then drops whatever
+ * was held in memory about the disk.
+ *
+ * return  0:       successful execution
+ * return -1:       error creating file block
+ * return -2:       error reading the directory tree back
+ */
+static int writeRepairs() {
+    struct request writes[BLOCKS];
+    int count = 0;
+
+    for (int blockID = 0; blockID < BLOCKS; blockID++) {
+        if (dirty[blockID]) {
+            writes[count].blockID = blockID;
+            writes[count].write = WRITE_REQUEST;
+            writes[count++].buffer = image[blockID];
+        }
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (submitBatch(writes, count)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -1;
+    }
+
+    clearCache();
+
+    if (setPreload(isPreloaded()) || setDedup(isDedup())) {
+        fprintf(stderr, "Error reading the directory tree.\n");
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * checkImage: Checks that every block of the disk is reachable exactly as often as it should be,
+ * from the root directory, the snapshot table and the orphan list.
+ *
+ * @repair      Integer             1 to cut bad pointers and free leaked blocks
+ * @report      sfs_fsck Pointer    the problems found, filled in
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the blocks
+ * return -2:                       error writing the repairs
+ */
+int checkImage(int repair, struct sfs_fsck* report) {
+    memset(report, 0, sizeof *report);
+    memset(visited, 0, sizeof visited);
+    memset(claims, 0, sizeof claims);
+    memset(stamps, 0, sizeof stamps);
+    memset(dirty, 0, sizeof dirty);
+
+    if (readImage()) {
+        return -1;
+    }
+
+    report->blocks = BLOCKS;
+    decodeImage();
+
+    // The reserved blocks are reached without a pointer, and may not be claimed by one
+    for (int blockID = 0; blockID < RESERVED_BLOCKS; blockID++) {
+        visited[blockID] = 1;
+        claims[blockID] = mayClaim(blockID);
+        report->reachable++;
+    }
+
+    walkTree(report, repair, ROOT_BLOCKID);
+    walkTree(report, repair, SNAPSHOT_BLOCKID);
+    walkTree(report, repair, ORPHAN_BLOCKID);
+
+    for (int blockID = RESERVED_BLOCKS; blockID < BLOCKS; blockID++) {
+        char* block = image[blockID];
+
+        if (visited[blockID] && kinds[blockID] == FILE && !isShared(block) &&
+                claims[blockID] < (unsigned char) block[REFS_P] && (unsigned char) block[REFS_P] > 1) {
+            report->leaked++;
+
+            if (repair) {
+                block[REFS_P] = claims[blockID];
+                dirty[blockID] = 1;
+                report->repaired++;
+            }
+
+            continue;
+        }
+
+        if (visited[blockID] || kinds[blockID] == FREE || kinds[blockID] == META) {
+            continue;
+        }
+
+        report->leaked++;
+
+        if (repair) {
+            block[BLOCK_START] = FREE;
+            dirty[blockID] = 1;
+            report->repaired++;
+        }
+    }
+
+    if (repair && writeRepairs()) {
+        return -2;
+    }
+
+    return 0;
+}
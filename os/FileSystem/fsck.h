@@ -0,0 +1,11 @@
+/*
+ * fsck.h
+ *
+ */
+
+#define FSCK_RUN 64
+#define FSCK_GRAIN 64
+#define FSCK_THREADS 64
+
+// Checks that every block of the disk is reachable exactly as often as it should be
+int checkImage(int repair, struct sfs_fsck* report);
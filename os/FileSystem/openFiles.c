@@ -5,8 +5,11 @@
 
 #include <stdio.h>
 #include <string.h>
+#include "cache.h"
 #include "openFiles.h"
 
+struct table openTable;
+
 /*
  * find: Finds the block id corresponding to a file descriptor.
  *
@@ -46,7 +49,7 @@ int delete(int fd) {
     for (int i = 0; i < openTable.length; i++) {
         if (openTable.fd[i][0] == fd + 1) {
             for (int j = i; j < openTable.length; j++) {
-                memcpy(openTable.fd[j], openTable.fd[j + 1], 3);
+                memcpy(openTable.fd[j], openTable.fd[j + 1], sizeof openTable.fd[j]);
             }
 
             openTable.length--;
@@ -70,11 +73,14 @@ int add(int* fd, int blockID) {
     openTable.length++;
 
     for (int i = openTable.length - 2; i > -1; i--) {
-        memcpy(openTable.fd[i + 1], openTable.fd[i], 3);
+        memcpy(openTable.fd[i + 1], openTable.fd[i], sizeof openTable.fd[i]);
     }
 
     openTable.fd[0][0] = openTable.fd[1][0] + 1;
     openTable.fd[0][1] = blockID;
+    openTable.fd[0][2] = 0;
+    openTable.fd[0][3] = 0;
+    openTable.fd[0][4] = 0;
 
     *fd = openTable.fd[0][0] - 1;
 
@@ -90,7 +96,23 @@ int add(int* fd, int blockID) {
 void deleteAll(int blockID) {
     for (int i = 0; i < openTable.length; i++) {
         if (openTable.fd[i][1] == blockID) {
-            delete(i);
+            // Deleting shifts the following entries down by one
+            delete(openTable.fd[i--][0] - 1);
+        }
+    }
+}
+
+/*
+ * renumber: Moves all entries in the priority queue with value blockID to another block id
+ *
+ * @blockID     Integer     the block id
+ * @newBlockID  Integer     the block id the entries now refer to
+ *
+ */
+void renumber(int blockID, int newBlockID) {
+    for (int i = 0; i < openTable.length; i++) {
+        if (openTable.fd[i][1] == blockID) {
+            openTable.fd[i][1] = newBlockID;
         }
     }
 }
@@ -135,3 +157,41 @@ int incStep(int fd) {
     fprintf(stderr, "Unable to find the file descriptor.\n");
     return 1;
 }
+
+/*
+ * followStream: Follows the reads of an open file. A read that starts where the last one
+ * ended continues a sequential stream, and the stream reads further ahead the longer it lasts.
+ * Any other read ends the stream.
+ *
+ * @window      Integer Pointer     how many blocks the read may read ahead
+ * @fd          Integer             the file descriptor
+ * @start       Integer             where the read starts
+ * @length      Integer             how many bytes it reads
+ *
+ * return 0:                        successful execution
+ * return 1:                        unable to find the file descriptor
+ */
+int followStream(int* window, int fd, size_t start, size_t length) {
+    for (int i = 0; i < openTable.length; i++) {
+        if (openTable.fd[i][0] == fd + 1) {
+            int* stream = openTable.fd[i];
+
+            if (start == (size_t) stream[3]) {
+                stream[4] = stream[4] == 0 ? READ_AHEAD_MIN : stream[4] * 2;
+
+                if (stream[4] > READ_AHEAD_MAX) {
+                    stream[4] = READ_AHEAD_MAX;
+                }
+            } else {
+                stream[4] = 0;
+            }
+
+            stream[3] = start + length;
+            *window = stream[4];
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Unable to find the file descriptor.\n");
+    return 1;
+}
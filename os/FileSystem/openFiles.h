@@ -3,14 +3,16 @@
  *
  */
 
+#include <stddef.h>
+
 #define MAX_OPEN_FILES 512
 
 struct table {
-    int fd[MAX_OPEN_FILES][3];
+    int fd[MAX_OPEN_FILES][5];
     int length;
 };
 
-struct table openTable;
+extern struct table openTable;
 
 // Finds the block id corresponding to a file descriptor.
 int find(int* blockID, int fd);
@@ -24,8 +26,14 @@ int add(int* fd, int blockID);
 // Deletes all entries in the priority queue with value blockID.
 void deleteAll(int blockID);
 
+// Moves all entries in the priority queue with value blockID to another block id.
+void renumber(int blockID, int newBlockID);
+
 // Gets how far a directory has been scanned
 int getStep(int* step, int fd);
 
 // Increment the step through a directory
 int incStep(int fd);
+
+// Follows the reads of an open file, and gets how many blocks to read ahead
+int followStream(int* window, int fd, size_t start, size_t length);
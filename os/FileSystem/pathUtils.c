@@ -5,9 +5,15 @@
 
 #include <stdio.h>
 #include <string.h>
+#include "blockio.h"
+#include "dirTree.h"
 #include "entry.h"
 #include "fControl.h"
 #include "pathUtils.h"
+#include "seal.h"
+#include "snapshot.h"
+#include "storeInt.h"
+#include "trace.h"
 
 /*
  * parsePath: Parses a path string into an array of path components.
@@ -24,6 +30,8 @@
  * return 4:                        component contains more than six char
  */
 int parsePath(char** path, const char* pathname) {
+    TRACE("parsePath");
+
     // If pathname is an empty string, return with an error.
     if (pathname[0] == '\0') {
         fprintf(stderr, "Pathname is empty.\n");
@@ -102,9 +110,26 @@ int parsePath(char** path, const char* pathname) {
  * return -3:                       error retrieving the path component from the file control block
  */
 int traverse(int* blockID, char** path) {
+    TRACE("traverse");
+
+    // A sealed disk resolves the whole path with one probe of its index
+    if (isSealed() && getRoot() == ROOT_BLOCKID) {
+        int type;
+        int size;
+
+        switch (findSealed(blockID, &type, &size, path)) {
+            case 0:
+                return 0;
+            case 1:
+                fprintf(stderr, "Error retrieving the path from the index of the sealed disk.\n");
+                return -3;
+            default:
+                return -1;
+        }
+    }
 
     // Start traversing from the root block.
-    *blockID = ROOT_BLOCKID;
+    *blockID = getRoot();
 
     for (int i = 1; i < arrayLen(path); i++) {
         int type;
@@ -138,6 +163,137 @@ int traverse(int* blockID, char** path) {
     return 0;
 }
 
+/*
+ * traverseForWrite: Traverse through the file system and retrieve the blockID of the last component.
+ * Every component shared with a snapshot is copied on the way down, so the returned block
+ * and all of its ancestors belong to the live tree only and may be modified.
+ *
+ * @blockID     Integer             blockID of the last component
+ * @path        Array of Strings    a list of path components to traverse
+ *
+ * return  0:                       successful execution
+ * return -1:                       error getting the file type
+ * return -2:                       error in interpreting a regular file as a directory
+ * return -3:                       error copying the path component
+ */
+int traverseForWrite(int* blockID, char** path) {
+    TRACE("traverseForWrite");
+
+    // Start traversing from the root block, which is never shared.
+    *blockID = getRoot();
+
+    for (int i = 1; i < arrayLen(path); i++) {
+        int type;
+
+        // Get the file type of the file component
+        if (getTypeFromFCB(&type, *blockID, path[i])) {
+            fprintf(stderr, "Error getting the file type.\n");
+            return -1;
+        }
+
+        // If a component in the middle of a path is not a directory
+        if (type == 0 && i < arrayLen(path) - 1) {
+            fprintf(stderr, "Error in interpreting a regular file as a directory.\n");
+            return -2;
+        }
+
+        if (unshareEntry(blockID, *blockID, path[i])) {
+            fprintf(stderr, "Error copying ./%s.\n", path[i]);
+            return -3;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * search: Depth-first search of a directory for the entry starting at a block.
+ *
+ * @path        Array of Strings    the path components found so far
+ * @level       Integer             index of the next path component
+ * @fcBlockID   Integer             the directory to search
+ * @blockID     Integer             the starting block being looked for
+ *
+ * return  0:                       found, path is terminated
+ * return  1:                       not found in this directory
+ * return -1:                       error retrieving the file control block
+ */
+static int search(char** path, int level, int fcBlockID, int blockID) {
+    char fcb[BLOCK_SIZE];
+
+    if (level >= MAX_PATH - 1) {
+        return 1;
+    }
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        char* line = &fcb[i];
+
+        // Entries free or stored inline lead to no blocks
+        if ((line[TYPE_P] != FILE && line[TYPE_P] != DIRECTORY) || line[NAME_P] == '\0') {
+            continue;
+        }
+
+        char start[2];
+        start[0] = line[START_P];
+        start[1] = line[START_P + 1];
+
+        // The stored name fills its slot when it is START_P - NAME_P chars long
+        memcpy(path[level], &line[NAME_P], START_P - NAME_P);
+        path[level][START_P - NAME_P] = '\0';
+
+        if (decode_int(start) == blockID) {
+            path[level + 1][0] = '\0';
+            return 0;
+        }
+
+        if (line[TYPE_P] == DIRECTORY) {
+            int found = search(path, level + 1, decode_int(start), blockID);
+
+            if (found <= 0) {
+                return found;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * findPath: Find the path from the root of the mounted tree to a starting block.
+ *
+ * @path        Array of Strings    the path to the file component
+ * @blockID     Integer             the starting block of the file component
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving the file control block
+ * return -2:                       no file component starts at the block
+ */
+int findPath(char** path, int blockID) {
+    TRACE("findPath");
+
+    strcpy(path[0], ROOT);
+
+    if (blockID == getRoot()) {
+        path[1][0] = '\0';
+        return 0;
+    }
+
+    switch (search(path, 1, getRoot(), blockID)) {
+        case 0:
+            return 0;
+        case 1:
+            fprintf(stderr, "No file component starts at block %d.\n", blockID);
+            return -2;
+        default:
+            return -1;
+    }
+}
+
 /*
  * dirname: Strip last component from file name.
  * The parent directory of the root directory is the root directory
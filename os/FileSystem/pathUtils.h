@@ -13,6 +13,12 @@ int parsePath(char** path, const char* pathname);
 // Traverse through the file system and retrieve the blockID of the last component.
 int traverse(int* blockID, char** path);
 
+// Traverse through the file system, copying every component shared with a snapshot.
+int traverseForWrite(int* blockID, char** path);
+
+// Find the path from the root of the mounted tree to a starting block.
+int findPath(char** path, int blockID);
+
 // Strip last component from file name
 int dirname(char** dir, char** path);
 
@@ -0,0 +1,191 @@
+/*
+ * reclaim.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "entry.h"
+#include "fControl.h"
+#include "fileSystem.h"
+#include "dedup.h"
+#include "reclaim.h"
+#include "scheduler.h"
+#include "snapshot.h"
+#include "storeInt.h"
+
+/*
+ * The orphan list holds the chains of deleted files whose blocks are not free yet:
+ *
+ *      type    slots ...                               generation
+ *      META    first block still to release ...        unused
+ *
+ * An empty slot holds BLOCK_END. Deleting a file only fills a slot, and the reclaimer
+ * walks the chains later. Before a batch of blocks is released, its slot is moved on to
+ * the block after the batch, so a crash can leak a batch but never release a block twice.
+ * The list is on disk, so reclamation left unfinished resumes at the next mount.
+ */
+
+/*
+ * getSlot: Gets the block recorded in a slot of the orphan list.
+ */
+static int getSlot(char* list, int slot) {
+    return decode_int(&list[ENTRY_START + slot * START]);
+}
+
+/*
+ * setSlot: Records a block in a slot of the orphan list.
+ */
+static void setSlot(char* list, int slot, int blockID) {
+    char* _blockID = encode_int(blockID);
+    list[ENTRY_START + slot * START] = _blockID[0];
+    list[ENTRY_START + slot * START + 1] = _blockID[1];
+    free(_blockID);
+}
+
+/*
+ * createOrphanList: Creates the orphan list of a freshly erased disk.
+ *
+ * return  0:       successful execution
+ * return -1:       error creating the orphan list
+ */
+int createOrphanList() {
+    char list[BLOCK_SIZE];
+    memset(list, 0, BLOCK_SIZE);
+
+    list[BLOCK_START] = META;
+
+    for (int slot = 0; slot < ORPHAN_SLOTS; slot++) {
+        setSlot(list, slot, BLOCK_END);
+    }
+
+    if (put_block(ORPHAN_BLOCKID, list)) {
+        fprintf(stderr, "Error creating the orphan list.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * orphanChain: Hands the chain of a deleted file over to the reclaimer.
+ * The chain is released at once when the orphan list is full, or the disk has none.
+ *
+ * @blockID     Integer     the first block of the chain
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving file block
+ * return -2:               error creating file block
+ */
+int orphanChain(int blockID) {
+    char list[BLOCK_SIZE];
+
+    if (get_block(ORPHAN_BLOCKID, list)) {
+        fprintf(stderr, "Error retrieving the orphan list.\n");
+        return -1;
+    }
+
+    for (int slot = 0; slot < ORPHAN_SLOTS && list[BLOCK_START] == META; slot++) {
+        if (getSlot(list, slot) != BLOCK_END) {
+            continue;
+        }
+
+        setSlot(list, slot, blockID);
+
+        if (put_block(ORPHAN_BLOCKID, list)) {
+            fprintf(stderr, "Error creating the orphan list.\n");
+            return -2;
+        }
+
+        return 0;
+    }
+
+    return releaseChain(blockID);
+}
+
+/*
+ * reclaimBlocks: Frees the blocks of orphaned chains, a batch at a time.
+ * Each block loses the pointer of the deleted file; blocks still referenced elsewhere,
+ * or shared with a snapshot, end their chain.
+ *
+ * @budget      Integer     how many blocks to release at most, or 0 to empty the orphan list
+ *
+ * return >=0:              number of blocks released
+ * return -1:               error retrieving file block
+ * return -2:               error creating file block
+ */
+int reclaimBlocks(int budget) {
+    char list[BLOCK_SIZE];
+    int released = 0;
+
+    if (get_block(ORPHAN_BLOCKID, list)) {
+        fprintf(stderr, "Error retrieving the orphan list.\n");
+        return -1;
+    }
+
+    if (list[BLOCK_START] != META) {
+        return 0;
+    }
+
+    char blocks[RECLAIM_BATCH][BLOCK_SIZE];
+    int blockIDs[RECLAIM_BATCH];
+
+    for (int slot = ORPHAN_SLOTS - 1; slot >= 0 && (budget <= 0 || released < budget);) {
+        int next = getSlot(list, slot);
+
+        if (next == BLOCK_END) {
+            slot--;
+            continue;
+        }
+
+        int limit = budget <= 0 || budget - released > RECLAIM_BATCH ? RECLAIM_BATCH : budget - released;
+        int count = 0;
+
+        // Gather the batch, stopping at the first block that outlives the chain
+        while (count < limit && next != BLOCK_END) {
+            char* block = blocks[count];
+
+            if (get_block(next, block)) {
+                fprintf(stderr, "Error retrieving file block.\n");
+                return -1;
+            }
+
+            if (isShared(block)) {
+                next = BLOCK_END;
+                break;
+            }
+
+            blockIDs[count++] = next;
+            next = isDuplicated(block) ? BLOCK_END : decode_int(&block[NEXT_BLOCK]);
+        }
+
+        setSlot(list, slot, next);
+
+        if (put_block(ORPHAN_BLOCKID, list)) {
+            fprintf(stderr, "Error creating the orphan list.\n");
+            return -2;
+        }
+
+        // No block of the batch is shared, so every one of them changes
+        struct request writes[RECLAIM_BATCH];
+
+        for (int i = 0; i < count; i++) {
+            dropReference(blockIDs[i], blocks[i]);
+
+            writes[i].blockID = blockIDs[i];
+            writes[i].write = WRITE_REQUEST;
+            writes[i].buffer = blocks[i];
+        }
+
+        if (submitBatch(writes, count)) {
+            fprintf(stderr, "Error creating file block.\n");
+            return -2;
+        }
+
+        released += count;
+    }
+
+    return released;
+}
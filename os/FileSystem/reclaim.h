@@ -0,0 +1,17 @@
+/*
+ * reclaim.h
+ *
+ */
+
+#define ORPHAN_BLOCKID 2
+#define ORPHAN_SLOTS ((GEN_P - ENTRY_START) / START)
+#define RECLAIM_BATCH 16
+
+// Creates the orphan list of a freshly erased disk
+int createOrphanList();
+
+// Hands the chain of a deleted file over to the reclaimer
+int orphanChain(int blockID);
+
+// Frees the blocks of orphaned chains, a batch at a time
+int reclaimBlocks(int budget);
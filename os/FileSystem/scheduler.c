@@ -0,0 +1,221 @@
+/*
+ * scheduler.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "fileSystem.h"
+#include "scheduler.h"
+#include "trace.h"
+
+/*
+ * A batch is carried out as if its requests ran one after the other in the order given,
+ * but the disk sees far fewer of them, in a better order:
+ *
+ *      - requests for the same block are merged: the block is read at most once, before
+ *        any write to it, and only the last write to it is issued. A read that follows
+ *        a write in the batch is served from the buffer of that write.
+ *      - the blocks are visited in C-SCAN order: upwards from the head, then from the
+ *        lowest block upwards again, so the head sweeps the disk in a single direction.
+ *      - reads of consecutive blocks, and writes of consecutive blocks, become single
+ *        requests of a run of blocks.
+ *      - the requests are issued with the disk plugged, so their latencies overlap
+ *        up to the queue depth of the device.
+ */
+
+// A request to the disk once the batch is merged
+struct dispatch {
+    int blockID;
+    int write;
+    char* buffer;       // where the block is read to or written from
+    int from;           // for a read, the slots of the reads it serves
+    int to;
+};
+
+// Requests of a batch ordered by block, then by position in the batch
+struct slot {
+    int blockID;
+    int index;
+};
+
+/*
+ * bySlot: Orders requests by block, then by their position in the batch.
+ */
+static int bySlot(const void* a, const void* b) {
+    const struct slot* x = a;
+    const struct slot* y = b;
+
+    if (x->blockID != y->blockID) {
+        return x->blockID - y->blockID;
+    }
+
+    return x->index - y->index;
+}
+
+/*
+ * issue: Issues a run of merged requests to consecutive blocks as a single request.
+ *
+ * @run         dispatch Array      requests in the run, all reads or all writes
+ * @length      Integer             number of requests in the run
+ * @buffer      String              room for length blocks
+ *
+ * return  0:                       successful execution
+ * return -1:                       error accessing the disk
+ */
+static int issue(struct dispatch* run, int length, char* buffer) {
+    if (length == 1) {
+        return run[0].write ? put_block(run[0].blockID, run[0].buffer) : get_block(run[0].blockID, run[0].buffer);
+    }
+
+    if (run[0].write) {
+        for (int i = 0; i < length; i++) {
+            memcpy(&buffer[i * BLOCK_SIZE], run[i].buffer, BLOCK_SIZE);
+        }
+
+        return put_run(run[0].blockID, length, buffer);
+    }
+
+    if (get_run(run[0].blockID, length, buffer)) {
+        return -1;
+    }
+
+    for (int i = 0; i < length; i++) {
+        memcpy(run[i].buffer, &buffer[i * BLOCK_SIZE], BLOCK_SIZE);
+    }
+
+    return 0;
+}
+
+/*
+ * submitBatch: Carries out a batch of block requests in a single sweep of the disk.
+ * The outcome is the same as issuing the requests one by one in order.
+ *
+ * @requests    request Array       the requests, each reading or writing one block
+ * @count       Integer             number of requests
+ *
+ * return  0:                       successful execution
+ * return -1:                       invalid block number
+ * return -2:                       error accessing the disk
+ */
+int submitBatch(struct request* requests, int count) {
+    TRACE("submitBatch");
+
+    if (count <= 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (requests[i].blockID < 0 || requests[i].blockID >= BLOCKS) {
+            fprintf(stderr, "Invalid block number %d in a batch.\n", requests[i].blockID);
+            return -1;
+        }
+    }
+
+    struct slot* slots = malloc(count * sizeof(struct slot));
+    struct dispatch* merged = malloc(2 * count * sizeof(struct dispatch));
+    struct dispatch* sweep = malloc(2 * count * sizeof(struct dispatch));
+    char* buffer = malloc((size_t) count * BLOCK_SIZE);
+    int mergedCount = 0;
+
+    for (int i = 0; i < count; i++) {
+        slots[i].blockID = requests[i].blockID;
+        slots[i].index = i;
+    }
+
+    qsort(slots, count, sizeof(struct slot), bySlot);
+
+    /*
+     * for each block
+     *      reads before the first write need the disk: one read serves them all
+     *      reads after a write take the data of the latest write
+     *      the last write is the only one the disk sees
+     */
+    for (int i = 0; i < count;) {
+        int blockID = slots[i].blockID;
+        char* written = NULL;
+        int from = i;
+        int to = i;
+
+        for (; i < count && slots[i].blockID == blockID; i++) {
+            struct request* request = &requests[slots[i].index];
+
+            if (request->write) {
+                written = request->buffer;
+            } else if (written != NULL) {
+                memcpy(request->buffer, written, BLOCK_SIZE);
+            } else {
+                to = i + 1;
+            }
+        }
+
+        if (to > from) {
+            struct dispatch* d = &merged[mergedCount++];
+            d->blockID = blockID;
+            d->write = 0;
+            d->buffer = requests[slots[from].index].buffer;
+            d->from = from;
+            d->to = to;
+        }
+
+        if (written != NULL) {
+            struct dispatch* d = &merged[mergedCount++];
+            d->blockID = blockID;
+            d->write = 1;
+            d->buffer = written;
+        }
+    }
+
+    // C-SCAN: blocks from the head upwards, then the rest from the lowest
+    int head = disk_head();
+    int sweepCount = 0;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < mergedCount; i++) {
+            if ((merged[i].blockID >= head) == (pass == 0)) {
+                sweep[sweepCount++] = merged[i];
+            }
+        }
+    }
+
+    int result = 0;
+
+    plug_disk();
+
+    for (int i = 0; i < sweepCount && result == 0;) {
+        int length = 1;
+
+        while (i + length < sweepCount && sweep[i + length].write == sweep[i].write
+                && sweep[i + length].blockID == sweep[i].blockID + length) {
+            length++;
+        }
+
+        if (issue(&sweep[i], length, buffer)) {
+            result = -2;
+        }
+
+        i += length;
+    }
+
+    unplug_disk();
+
+    // A block read from the disk is passed on to the other reads of it made before any write
+    for (int i = 0; i < sweepCount && result == 0; i++) {
+        for (int k = sweep[i].from + 1; !sweep[i].write && k < sweep[i].to; k++) {
+            memcpy(requests[slots[k].index].buffer, sweep[i].buffer, BLOCK_SIZE);
+        }
+    }
+
+    free(slots);
+    free(merged);
+    free(sweep);
+    free(buffer);
+
+    if (result) {
+        fprintf(stderr, "Error accessing the disk for a batch of blocks.\n");
+    }
+
+    return result;
+}
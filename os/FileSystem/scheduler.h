@@ -0,0 +1,17 @@
+/*
+ * scheduler.h
+ *
+ */
+
+#define READ_REQUEST 0
+#define WRITE_REQUEST 1
+
+// A request to read a block into a buffer, or to write a buffer to a block
+struct request {
+    int blockID;
+    int write;
+    char* buffer;
+};
+
+// Carries out a batch of block requests in a single sweep of the disk
+int submitBatch(struct request* requests, int count);
@@ -0,0 +1,479 @@
+/*
+ * seal.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "dirTree.h"
+#include "entry.h"
+#include "fControl.h"
+#include "fileSystem.h"
+#include "pathUtils.h"
+#include "reclaim.h"
+#include "seal.h"
+#include "snapshot.h"
+#include "storeInt.h"
+#include "superblock.h"
+
+/*
+ * A sealed disk never changes again, so every path of the live tree is indexed once
+ * with a minimal perfect hash. The superblock records where the index starts:
+ *
+ *      displacement blocks     META, one displacement per bucket ...
+ *      record blocks           META, one record per path: type, start, size, check ...
+ *
+ * A path hashes to a bucket, and the displacement of the bucket picks the hash that
+ * leads to its record. The displacements stay in memory while the disk is mounted, so
+ * a lookup costs one block read. The check is the full bucket hash of the path, which
+ * tells a path that is not on the disk from the one whose record it lands on.
+ */
+
+// A path of the live tree and what it leads to
+struct sealed {
+    char* key;
+    int type;
+    int start;
+    int size;
+};
+
+// Whether the disk is sealed
+static int sealed = 0;
+
+// First block of the index
+static int indexStart = BLOCK_END;
+
+// Number of paths, and of buckets
+static int keys = 0;
+static int buckets = 0;
+
+// Displacement of every bucket
+static int* displacements = NULL;
+
+/*
+ * hashKey: FNV-1a hash of a path, salted with a seed.
+ * The result is mixed, since the low bits of FNV-1a alone barely depend on the seed.
+ */
+static unsigned int hashKey(const char* key, unsigned int seed) {
+    unsigned int h = (2166136261u ^ seed) * 16777619u;
+
+    for (int i = 0; key[i] != '\0'; i++) {
+        h = (h ^ (unsigned char) key[i]) * 16777619u;
+    }
+
+    h = (h ^ (h >> 16)) * 0x85ebca6bu;
+    h = (h ^ (h >> 13)) * 0xc2b2ae35u;
+
+    return h ^ (h >> 16);
+}
+
+/*
+ * joinPath: Writes the components of a parsed path back as a single path, without a trailing slash.
+ */
+static void joinPath(char* key, char** path) {
+    strcpy(key, ROOT);
+
+    for (int i = 1; i < arrayLen(path); i++) {
+        if (i > 1) {
+            strcat(key, "/");
+        }
+
+        strcat(key, path[i]);
+    }
+}
+
+/*
+ * putLong: Stores a non-negative integer in four bytes.
+ */
+static void putLong(char* c, unsigned int value) {
+    for (int i = 0; i < 4; i++) {
+        c[i] = (char) (value >> (8 * i));
+    }
+}
+
+/*
+ * getLong: Restores an integer stored in four bytes.
+ */
+static unsigned int getLong(const char* c) {
+    unsigned int value = 0;
+
+    for (int i = 0; i < 4; i++) {
+        value |= (unsigned int) (unsigned char) c[i] << (8 * i);
+    }
+
+    return value;
+}
+
+/*
+ * recordsStart: Gets the first record block of the index.
+ */
+static int recordsStart() {
+    return indexStart + (buckets + DISPLACEMENTS_PER_BLOCK - 1) / DISPLACEMENTS_PER_BLOCK;
+}
+
+/*
+ * loadSeal: Loads the path index of a sealed disk.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the index
+ */
+int loadSeal() {
+    char block[BLOCK_SIZE];
+
+    free(displacements);
+    displacements = NULL;
+    sealed = 0;
+
+    if (get_block(SUPER_BLOCKID, block)) {
+        fprintf(stderr, "Error retrieving the superblock.\n");
+        return -1;
+    }
+
+    if (!isSuperblock(block) || decode_int(&block[SEAL_P]) == BLOCK_END) {
+        return 0;
+    }
+
+    indexStart = decode_int(&block[SEAL_P]);
+    keys = decode_int(&block[KEYS_P]);
+    buckets = decode_int(&block[BUCKETS_P]);
+    displacements = malloc(buckets * sizeof(int));
+
+    for (int b = 0; b < buckets; b++) {
+        if (b % DISPLACEMENTS_PER_BLOCK == 0 && get_block(indexStart + b / DISPLACEMENTS_PER_BLOCK, block)) {
+            fprintf(stderr, "Error retrieving the path index.\n");
+            return -1;
+        }
+
+        displacements[b] = decode_int(&block[ENTRY_START + (b % DISPLACEMENTS_PER_BLOCK) * START]);
+    }
+
+    sealed = 1;
+
+    return 0;
+}
+
+/*
+ * isSealed: Checks whether the disk is sealed.
+ *
+ * return 1:        the disk is sealed, and never written again
+ * return 0:        the disk is writable
+ */
+int isSealed() {
+    return sealed;
+}
+
+/*
+ * findSealed: Resolves a path through the index of a sealed disk.
+ *
+ * @blockID     Integer Pointer     starting block of the file
+ * @type        Integer Pointer     type of the file
+ * @size        Integer Pointer     size of a regular file, 0 for a directory
+ * @path        Array of Strings    the parsed path
+ *
+ * return  0:                       successful execution
+ * return  1:                       the path is not on the disk
+ * return -1:                       error retrieving the path index
+ */
+int findSealed(int* blockID, int* type, int* size, char** path) {
+    char key[MAX_PATH * MAX_DIRNAME];
+    joinPath(key, path);
+
+    unsigned int check = hashKey(key, 0);
+    int displacement = displacements[check % buckets];
+
+    // No path fell in the bucket
+    if (displacement == 0) {
+        return 1;
+    }
+
+    int slot = hashKey(key, displacement) % keys;
+    char block[BLOCK_SIZE];
+
+    if (get_block(recordsStart() + slot / RECORDS_PER_BLOCK, block)) {
+        fprintf(stderr, "Error retrieving the path index.\n");
+        return -1;
+    }
+
+    char* record = &block[ENTRY_START + (slot % RECORDS_PER_BLOCK) * RECORD_LENGTH];
+
+    if (getLong(&record[RECORD_CHECK_P]) != check) {
+        return 1;
+    }
+
+    *type = record[RECORD_TYPE_P];
+    *blockID = getLong(&record[RECORD_START_P]);
+    *size = getLong(&record[RECORD_SIZE_P]);
+
+    return 0;
+}
+
+/*
+ * collect: Adds every path of a directory tree to a list.
+ *
+ * @list        Array of sealed Pointer     the list, grown as needed
+ * @count       Integer Pointer             number of paths in the list
+ * @key         String                      path of the directory
+ * @fcBlockID   Integer                     the directory
+ *
+ * return  0:                               successful execution
+ * return -1:                               error retrieving file block
+ */
+static int collect(struct sealed** list, int* count, const char* key, int fcBlockID) {
+    char fcb[BLOCK_SIZE];
+
+    if (getFCB(fcBlockID, fcb)) {
+        fprintf(stderr, "Error retrieving the file control block.\n");
+        return -1;
+    }
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        char* line = &fcb[i];
+
+        if ((line[TYPE_P] != FILE && line[TYPE_P] != DIRECTORY && line[TYPE_P] != INLINE_FILE) || line[NAME_P] == '\0') {
+            continue;
+        }
+
+        struct sealed entry;
+        char name[MAX_DIRNAME];
+
+        strncpy(name, &line[NAME_P], MAX_DIRNAME - 1);
+        name[MAX_DIRNAME - 1] = '\0';
+
+        entry.key = malloc(strlen(key) + MAX_DIRNAME + 1);
+        sprintf(entry.key, "%s%s%s", key, strcmp(key, ROOT) ? "/" : "", name);
+        entry.type = line[TYPE_P] == DIRECTORY ? DIRECTORY : FILE;
+        entry.start = line[TYPE_P] == INLINE_FILE ? INLINE_ID(fcBlockID, i) : decode_int(&line[START_P]);
+        entry.size = 0;
+
+        if (entry.type == FILE && getSize(&entry.size, entry.start)) {
+            return -1;
+        }
+
+        *list = realloc(*list, (*count + 1) * sizeof(struct sealed));
+        (*list)[(*count)++] = entry;
+
+        if (entry.type == DIRECTORY && collect(list, count, entry.key, entry.start)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * place: Finds displacements that send every path to a slot of its own.
+ * Buckets are placed largest first, trying displacements in order.
+ *
+ * @slots       Integer Array       the path given each slot, filled in
+ * @list        Array of sealed     the paths
+ *
+ * return  0:                       successful execution
+ * return -1:                       a bucket could not be placed
+ */
+static int place(int* slots, struct sealed* list) {
+    int* bucketOf = malloc(keys * sizeof(int));
+    int* sizes = calloc(buckets, sizeof(int));
+    int largest = 0;
+
+    for (int k = 0; k < keys; k++) {
+        bucketOf[k] = hashKey(list[k].key, 0) % buckets;
+        sizes[bucketOf[k]]++;
+        largest = sizes[bucketOf[k]] > largest ? sizes[bucketOf[k]] : largest;
+        slots[k] = -1;
+    }
+
+    int* members = malloc(largest * sizeof(int));
+    int* tried = malloc(largest * sizeof(int));
+    int result = 0;
+
+    for (int size = largest; size > 0 && result == 0; size--) {
+        for (int b = 0; b < buckets && result == 0; b++) {
+            if (sizes[b] != size) {
+                continue;
+            }
+
+            int n = 0;
+
+            for (int k = 0; k < keys; k++) {
+                if (bucketOf[k] == b) {
+                    members[n++] = k;
+                }
+            }
+
+            int displacement;
+
+            for (displacement = 1; displacement <= MAX_DISPLACEMENT; displacement++) {
+                int fits = 1;
+
+                for (int i = 0; i < n && fits; i++) {
+                    tried[i] = hashKey(list[members[i]].key, displacement) % keys;
+                    fits = slots[tried[i]] == -1;
+
+                    for (int j = 0; j < i && fits; j++) {
+                        fits = tried[j] != tried[i];
+                    }
+                }
+
+                if (fits) {
+                    break;
+                }
+            }
+
+            if (displacement > MAX_DISPLACEMENT) {
+                result = -1;
+                break;
+            }
+
+            displacements[b] = displacement;
+
+            for (int i = 0; i < n; i++) {
+                slots[tried[i]] = members[i];
+            }
+        }
+    }
+
+    free(bucketOf);
+    free(sizes);
+    free(members);
+    free(tried);
+
+    return result;
+}
+
+/*
+ * sealImage: Builds the path index of the live tree and seals the disk.
+ * Blocks of deleted files are reclaimed first, since the disk is never written again.
+ *
+ * return  0:       successful execution
+ * return -1:       error collecting the paths of the live tree
+ * return -2:       error building the perfect hash
+ * return -3:       not enough free blocks for the index
+ * return -4:       error writing the index
+ * return -5:       the disk has no superblock
+ */
+int sealImage() {
+    char block[BLOCK_SIZE];
+
+    if (get_block(SUPER_BLOCKID, block) || !isSuperblock(block)) {
+        fprintf(stderr, "The disk has no superblock to record the index in.\n");
+        return -5;
+    }
+
+    struct sealed* list = malloc(sizeof(struct sealed));
+    int count = 1;
+
+    list[0].key = malloc(strlen(ROOT) + 1);
+    strcpy(list[0].key, ROOT);
+    list[0].type = DIRECTORY;
+    list[0].start = ROOT_BLOCKID;
+    list[0].size = 0;
+
+    int result = 0;
+
+    if (reclaimBlocks(0) < 0 || collect(&list, &count, ROOT, ROOT_BLOCKID)) {
+        fprintf(stderr, "Error collecting the paths of the live tree.\n");
+        result = -1;
+    }
+
+    keys = count;
+    buckets = (count + BUCKET_SIZE - 1) / BUCKET_SIZE;
+
+    free(displacements);
+    displacements = calloc(buckets, sizeof(int));
+
+    int* slots = malloc(keys * sizeof(int));
+
+    if (result == 0 && place(slots, list)) {
+        fprintf(stderr, "Error building the perfect hash.\n");
+        result = -2;
+    }
+
+    int displacementBlocks = (buckets + DISPLACEMENTS_PER_BLOCK - 1) / DISPLACEMENTS_PER_BLOCK;
+    int total = displacementBlocks + (keys + RECORDS_PER_BLOCK - 1) / RECORDS_PER_BLOCK;
+    int* blockIDs = malloc(total * sizeof(int));
+
+    if (result == 0 && getFreeRun(blockIDs, total, SUPER_BLOCKID)) {
+        fprintf(stderr, "Not enough free blocks for the index.\n");
+        result = -3;
+    }
+
+    for (int n = 0; n < total && result == 0; n++) {
+        memset(block, 0, BLOCK_SIZE);
+        block[BLOCK_START] = META;
+
+        for (int i = 0; n < displacementBlocks && i < DISPLACEMENTS_PER_BLOCK; i++) {
+            int b = n * DISPLACEMENTS_PER_BLOCK + i;
+            char* _displacement = encode_int(b < buckets ? displacements[b] : 0);
+
+            block[ENTRY_START + i * START] = _displacement[0];
+            block[ENTRY_START + i * START + 1] = _displacement[1];
+            free(_displacement);
+        }
+
+        for (int i = 0; n >= displacementBlocks && i < RECORDS_PER_BLOCK; i++) {
+            int slot = (n - displacementBlocks) * RECORDS_PER_BLOCK + i;
+
+            if (slot >= keys) {
+                break;
+            }
+
+            struct sealed* entry = &list[slots[slot]];
+            char* record = &block[ENTRY_START + i * RECORD_LENGTH];
+
+            record[RECORD_TYPE_P] = entry->type;
+            putLong(&record[RECORD_START_P], entry->start);
+            putLong(&record[RECORD_SIZE_P], entry->size);
+            putLong(&record[RECORD_CHECK_P], hashKey(entry->key, 0));
+        }
+
+        if (put_block(blockIDs[n], block)) {
+            fprintf(stderr, "Error writing the index.\n");
+            result = -4;
+        }
+    }
+
+    // The superblock points at the index last, so a disk is sealed only once its index is complete
+    if (result == 0 && get_block(SUPER_BLOCKID, block)) {
+        result = -4;
+    }
+
+    if (result == 0) {
+        char* _field = encode_int(blockIDs[0]);
+        block[SEAL_P] = _field[0];
+        block[SEAL_P + 1] = _field[1];
+        free(_field);
+
+        _field = encode_int(keys);
+        block[KEYS_P] = _field[0];
+        block[KEYS_P + 1] = _field[1];
+        free(_field);
+
+        _field = encode_int(buckets);
+        block[BUCKETS_P] = _field[0];
+        block[BUCKETS_P + 1] = _field[1];
+        free(_field);
+
+        if (put_block(SUPER_BLOCKID, block) || loadSeal()) {
+            fprintf(stderr, "Error writing the index.\n");
+            result = -4;
+        }
+    }
+
+    for (int k = 0; k < count; k++) {
+        free(list[k].key);
+    }
+
+    free(list);
+    free(slots);
+    free(blockIDs);
+
+    if (result != 0) {
+        free(displacements);
+        displacements = NULL;
+        sealed = 0;
+    }
+
+    return result;
+}
@@ -0,0 +1,26 @@
+/*
+ * seal.h
+ *
+ */
+
+#define RECORD_LENGTH 13
+#define RECORD_TYPE_P 0
+#define RECORD_START_P 1
+#define RECORD_SIZE_P 5
+#define RECORD_CHECK_P 9
+#define RECORDS_PER_BLOCK ((BLOCK_SIZE - 1) / RECORD_LENGTH)
+#define DISPLACEMENTS_PER_BLOCK ((BLOCK_SIZE - 1) / START)
+#define BUCKET_SIZE 4
+#define MAX_DISPLACEMENT 65534
+
+// Loads the path index of a sealed disk
+int loadSeal();
+
+// Checks whether the disk is sealed
+int isSealed();
+
+// Resolves a path through the index of a sealed disk
+int findSealed(int* blockID, int* type, int* size, char** path);
+
+// Builds the path index of the live tree and seals the disk
+int sealImage();
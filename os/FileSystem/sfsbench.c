@@ -0,0 +1,429 @@
+/*
+ * sfsbench.c
+ *
+ * Runs a workload script against the disk in simdisk.data with no prompts,
+ * then reports how many times each operation ran, its throughput, and
+ * percentiles of its latency.
+ *
+ * usage: sfsbench [-t trace] [script]
+ *
+ * The script is read from stdin when no file is given. With -t, the spans traced during
+ * the run are written to the trace file, when the file system is compiled with -DSFS_TRACE.
+ *
+ * A script holds one operation per line. Blank lines and lines starting with # are skipped.
+ *
+ *      format                          erase the disk
+ *      mount                           initialize the disk without erasing it
+ *      create  PATH TYPE               create a regular file (0) or a directory (1)
+ *      delete  PATH
+ *      open    PATH                    the file descriptor is remembered by path
+ *      close   PATH
+ *      read    PATH START LENGTH       read from an open file
+ *      write   PATH START LENGTH       write to an open file
+ *      readdir PATH                    list an open directory to the end
+ *      getsize PATH
+ *      gettype PATH
+ *      warmup  ENABLE                  save the hot blocks on shutdown (1) and reload them on mount
+ *      shutdown                        shut down cleanly, closing every open file
+ *      repeat  COUNT                   run the lines up to the matching end COUNT times
+ *      end
+ *      disk    LATENCY SEEK BANDWIDTH DEPTH [REALTIME]
+ *                                      model the device: ns per request, ns per block of seek,
+ *                                      bytes per second (0 for no limit), and queue depth;
+ *                                      with REALTIME 1 the modelled time is also slept
+ *
+ * In a repeated line, %d in a path is replaced with the current repetition,
+ * so that one loop can create or read many files.
+ *
+ * The statistics the file system keeps of every operation, as seen from inside it, are printed last.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fileSystem.h"
+#include "blockio.h"
+
+#define MAX_LINES   4096
+#define MAX_LINE    256
+#define MAX_DEPTH   16
+#define MAX_FILES   512
+
+enum op { FORMAT, MOUNT, CREATE, DELETE, OPEN, CLOSE, READ, WRITE, READDIR, GETSIZE, GETTYPE, WARMUP, SHUTDOWN,
+    OPS };
+
+static const char* names[OPS] = { "format", "mount", "create", "delete", "open", "close", "read", "write",
+        "readdir", "getsize", "gettype", "warmup", "shutdown" };
+
+// Latencies of every run of an operation, in nanoseconds
+struct timings {
+    long count;
+    long errors;
+    long bytes;
+    long simulated;
+    long capacity;
+    long* latencies;
+};
+
+static struct timings timings[OPS];
+
+// Paths of the open files, and their file descriptors
+static char paths[MAX_FILES][MAX_LINE];
+static int fds[MAX_FILES];
+static int files = 0;
+
+// Contents written by every write
+static char data[MAX_IO_LENGTH];
+
+/*
+ * now: Reads the monotonic clock in nanoseconds.
+ */
+static long now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/*
+ * record: Adds a run of an operation to its timings.
+ */
+static void record(enum op op, long latency, long simulated, int ok, long bytes) {
+    struct timings* t = &timings[op];
+
+    if (t->count == t->capacity) {
+        t->capacity = t->capacity ? 2 * t->capacity : 64;
+        t->latencies = realloc(t->latencies, t->capacity * sizeof(long));
+    }
+
+    t->latencies[t->count++] = latency;
+    t->errors += !ok;
+    t->bytes += ok ? bytes : 0;
+    t->simulated += simulated;
+}
+
+/*
+ * findFd: Finds the file descriptor of an open file.
+ *
+ * return int:      index of the file in the table of open files
+ * return -1:       the file is not open
+ */
+static int findFd(const char* path) {
+    for (int i = 0; i < files; i++) {
+        if (!strcmp(paths[i], path)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * run: Runs one line of the script and times it.
+ *
+ * return  0:       the line was run
+ * return -1:       the line is not an operation
+ */
+static int run(const char* line, int repetition) {
+    char word[MAX_LINE];
+    char pattern[MAX_LINE];
+    char path[MAX_LINE];
+    long a = 0;
+    long b = 0;
+
+    pattern[0] = '\0';
+
+    if (sscanf(line, "%255s %255s %ld %ld", word, pattern, &a, &b) < 1) {
+        return -1;
+    }
+
+    // Only %d may be expanded in a path from a script
+    const char* percent = strchr(pattern, '%');
+
+    if (percent != NULL && (percent[1] != 'd' || strchr(percent + 1, '%') != NULL)) {
+        return -1;
+    }
+
+    snprintf(path, MAX_LINE, pattern, repetition);
+
+    int op;
+
+    for (op = 0; op < OPS && strcmp(word, names[op]); op++) {
+    }
+
+    if (op == OPS) {
+        return -1;
+    }
+
+    int f = findFd(path);
+    int ok = 0;
+    long bytes = 0;
+    char buffer[MAX_IO_LENGTH + 1];
+
+    if (a < 0 || b < 0 || b > MAX_IO_LENGTH) {
+        return -1;
+    }
+
+    long simulated = disk_clock();
+    long start = now();
+
+    switch (op) {
+        case FORMAT:
+            ok = sfs_initialize(1) == 1;
+            files = 0;
+            break;
+        case MOUNT:
+            ok = sfs_initialize(0) == 1;
+            files = 0;
+            break;
+        case CREATE:
+            ok = sfs_create(path, a) == 1;
+            break;
+        case DELETE:
+            ok = sfs_delete(path) == 1;
+            break;
+        case OPEN:
+            if (f < 0 && files < MAX_FILES) {
+                fds[files] = sfs_open(path);
+                ok = fds[files] >= 0;
+
+                if (ok) {
+                    strcpy(paths[files++], path);
+                }
+            }
+            break;
+        case CLOSE:
+            if (f >= 0) {
+                ok = sfs_close(fds[f]) == 1;
+
+                if (f != --files) {
+                    fds[f] = fds[files];
+                    memmove(paths[f], paths[files], MAX_LINE);
+                }
+            }
+            break;
+        case READ:
+            ok = f >= 0 && sfs_pread(fds[f], a, b, buffer) == 1;
+            bytes = b;
+            break;
+        case WRITE:
+            ok = f >= 0 && sfs_pwrite(fds[f], a, b, data) == 1;
+            bytes = b;
+            break;
+        case READDIR:
+            if (f >= 0) {
+                int result;
+
+                while ((result = sfs_readdir(fds[f], buffer)) == 1) {
+                }
+
+                ok = result == 0;
+            }
+            break;
+        case GETSIZE:
+            ok = sfs_getsize(path) >= 0;
+            break;
+        case GETTYPE:
+            ok = sfs_gettype(path) >= 0;
+            break;
+        case WARMUP:
+            ok = sfs_warmup(atoi(path)) == 1;
+            break;
+        case SHUTDOWN:
+            ok = sfs_shutdown() == 1;
+            files = 0;
+            break;
+    }
+
+    long latency = now() - start;
+
+    record(op, latency, disk_clock() - simulated, ok, bytes);
+
+    return 0;
+}
+
+/*
+ * compare: Orders latencies for the percentiles.
+ */
+static int compare(const void* a, const void* b) {
+    long x = *(const long*) a;
+    long y = *(const long*) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * percentile: Gets a percentile of sorted latencies, in microseconds.
+ */
+static double percentile(const struct timings* t, double p) {
+    long i = (long) (p * (t->count - 1) + 0.5);
+
+    return t->latencies[i] / 1000.0;
+}
+
+/*
+ * report: Prints the timings of every operation that ran.
+ */
+static void report(long elapsed) {
+    printf("%-8s %8s %7s %10s %10s %8s %9s %9s %9s %9s %10s\n", "op", "count", "errors", "total ms", "ops/s", "MB/s",
+            "p50 us", "p90 us", "p99 us", "max us", "disk us/op");
+
+    for (int op = 0; op < OPS; op++) {
+        struct timings* t = &timings[op];
+
+        if (t->count == 0) {
+            continue;
+        }
+
+        long total = 0;
+
+        for (long i = 0; i < t->count; i++) {
+            total += t->latencies[i];
+        }
+
+        qsort(t->latencies, t->count, sizeof(long), compare);
+
+        printf("%-8s %8ld %7ld %10.3f %10.0f %8.2f %9.2f %9.2f %9.2f %9.2f %10.2f\n", names[op], t->count, t->errors,
+                total / 1e6, t->count / (total / 1e9 + 1e-12), t->bytes / (total / 1e9 + 1e-12) / 1e6,
+                percentile(t, 0.5), percentile(t, 0.9), percentile(t, 0.99), t->latencies[t->count - 1] / 1000.0,
+                t->simulated / 1000.0 / t->count);
+    }
+
+    printf("elapsed %.3f ms, simulated disk time %.3f ms, head travel %ld blocks\n", elapsed / 1e6,
+            disk_clock() / 1e6, disk_travel());
+}
+
+/*
+ * reportStats: Prints the statistics the file system kept of every operation that ran.
+ */
+static void reportStats() {
+    static struct sfs_stats stats;
+
+    sfs_stats(&stats, 0);
+
+    printf("\n%-13s %8s %7s %9s %9s %7s %9s %9s %9s %9s\n", "sfs_*", "calls", "errors", "reads", "writes",
+            "allocs", "hits", "misses", "p50 us", "p99 us");
+
+    for (int op = 0; op < SFS_OPS; op++) {
+        struct sfs_opstats* s = &stats.ops[op];
+
+        if (s->calls == 0 && s->blockReads == 0 && s->blockWrites == 0) {
+            continue;
+        }
+
+        printf("%-13s %8lu %7lu %9lu %9lu %7lu %9lu %9lu %9.2f %9.2f\n", s->name, s->calls, s->errors,
+                s->blockReads, s->blockWrites, s->allocations, s->cacheHits, s->cacheMisses,
+                sfs_percentile(s, 0.5) / 1000.0, sfs_percentile(s, 0.99) / 1000.0);
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* trace = NULL;
+    int arg = 1;
+
+    if (argc > 2 && !strcmp(argv[1], "-t")) {
+        trace = argv[2];
+        arg = 3;
+    }
+
+    FILE* script = argc > arg ? fopen(argv[arg], "r") : stdin;
+
+    if (script == NULL) {
+        fprintf(stderr, "sfsbench: cannot open %s.\n", argv[arg]);
+        return 1;
+    }
+
+    static char lines[MAX_LINES][MAX_LINE];
+    int count = 0;
+
+    while (count < MAX_LINES && fgets(lines[count], MAX_LINE, script) != NULL) {
+        char* first = lines[count] + strspn(lines[count], " \t");
+
+        if (*first != '#' && *first != '\n' && *first != '\0') {
+            memmove(lines[count], first, strlen(first) + 1);
+            count++;
+        }
+    }
+
+    for (int i = 0; i < MAX_IO_LENGTH; i++) {
+        data[i] = 'a' + i % 26;
+    }
+
+    // Loops in progress: the line after the repeat, the repetition, and how many to run
+    int loopStart[MAX_DEPTH];
+    int loopIndex[MAX_DEPTH];
+    int loopCount[MAX_DEPTH];
+    int depth = 0;
+
+    long start = now();
+
+    for (int i = 0; i < count; i++) {
+        long times;
+
+        if (sscanf(lines[i], "repeat %ld", &times) == 1) {
+            if (depth == MAX_DEPTH) {
+                fprintf(stderr, "sfsbench: loops nested too deep at line %d.\n", i + 1);
+                return 1;
+            }
+
+            loopStart[depth] = i + 1;
+            loopIndex[depth] = 0;
+            loopCount[depth++] = times;
+
+            // Skip a loop that runs no times
+            if (times > 0) {
+                continue;
+            }
+
+            for (int nested = 1; nested > 0 && ++i < count;) {
+                nested += !strncmp(lines[i], "repeat", 6) - !strncmp(lines[i], "end", 3);
+            }
+
+            depth--;
+            continue;
+        }
+
+        long latency;
+        long seek;
+        long bandwidth;
+        int queue;
+        int realtime = 0;
+
+        if (sscanf(lines[i], "disk %ld %ld %ld %d %d", &latency, &seek, &bandwidth, &queue, &realtime) >= 4) {
+            if (set_disk_model(latency, seek, bandwidth, queue, realtime)) {
+                fprintf(stderr, "sfsbench: not a device model at line %d.\n", i + 1);
+                return 1;
+            }
+
+            continue;
+        }
+
+        if (!strncmp(lines[i], "end", 3) && depth > 0) {
+            if (++loopIndex[depth - 1] < loopCount[depth - 1]) {
+                i = loopStart[depth - 1] - 1;
+            } else {
+                depth--;
+            }
+
+            continue;
+        }
+
+        if (run(lines[i], depth > 0 ? loopIndex[depth - 1] : 0)) {
+            fprintf(stderr, "sfsbench: not an operation at line %d: %s", i + 1, lines[i]);
+            return 1;
+        }
+    }
+
+    report(now() - start);
+    reportStats();
+
+    if (trace != NULL && sfs_trace(trace) != 1) {
+        fprintf(stderr, "sfsbench: the trace could not be written to %s.\n", trace);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * sfsck.c
+ *
+ * Checks the consistency of the disk in simdisk.data, and repairs it if asked.
+ *
+ * usage: sfsck [-r]
+ *
+ * With -r, bad pointers are cut and leaked blocks are freed.
+ * The exit status is 0 for a consistent disk, 1 when every problem was repaired,
+ * 4 when problems are left, and 8 when the disk could not be checked.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "fileSystem.h"
+
+int main(int argc, char** argv) {
+    int repair = argc > 1 && !strcmp(argv[1], "-r");
+    struct sfs_fsck report;
+
+    if (argc > 2 || (argc == 2 && !repair)) {
+        fprintf(stderr, "usage: sfsck [-r]\n");
+        return 8;
+    }
+
+    if (sfs_initialize(0) != 1) {
+        fprintf(stderr, "sfsck: the disk could not be mounted.\n");
+        return 8;
+    }
+
+    if (sfs_fsck(repair, &report) != 1) {
+        fprintf(stderr, "sfsck: the disk could not be checked.\n");
+        return 8;
+    }
+
+    int problems = report.loops + report.crossLinked + report.leaked + report.dangling;
+
+    printf("sfsck: %d blocks, %d reachable\n", report.blocks, report.reachable);
+    printf("sfsck: %d looping chains, %d cross-linked pointers, %d leaked blocks, %d dangling pointers\n",
+            report.loops, report.crossLinked, report.leaked, report.dangling);
+
+    if (problems == 0) {
+        printf("sfsck: the disk is consistent.\n");
+        return 0;
+    }
+
+    printf("sfsck: %d of %d problems repaired.\n", report.repaired, problems);
+
+    return report.repaired == problems ? 1 : 4;
+}
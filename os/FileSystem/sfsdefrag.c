@@ -0,0 +1,39 @@
+/*
+ * sfsdefrag.c
+ *
+ * Rewrites the fragmented file chains of the disk in simdisk.data into contiguous runs,
+ * and reports how fragmented the chains were before and after.
+ *
+ * usage: sfsdefrag [-d]
+ *
+ * With -d, every directory is also moved nearer its parent.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "fileSystem.h"
+
+int main(int argc, char** argv) {
+    int directories = argc > 1 && !strcmp(argv[1], "-d");
+    double before;
+    double after;
+
+    if (argc > 2 || (argc == 2 && !directories)) {
+        fprintf(stderr, "usage: sfsdefrag [-d]\n");
+        return 1;
+    }
+
+    if (sfs_initialize(0) != 1) {
+        fprintf(stderr, "sfsdefrag: the disk could not be mounted.\n");
+        return 1;
+    }
+
+    if (sfs_defrag(directories, &before, &after) != 1) {
+        fprintf(stderr, "sfsdefrag: the disk could not be defragmented.\n");
+        return 1;
+    }
+
+    printf("sfsdefrag: fragmentation %.1f%% before, %.1f%% after.\n", 100 * before, 100 * after);
+
+    return 0;
+}
@@ -0,0 +1,459 @@
+/*
+ * sfsmicro.c
+ *
+ * Microbenchmarks of each layer of the file system, from the encoding of block numbers
+ * up to path resolution and directory lookups. The disk in simdisk.data is erased. Results are printed as JSON,
+ * one record per measurement, so that runs of different versions can be compared.
+ * Measurements of the modelled disk are in simulated time; all the others are in wall-clock time.
+ *
+ * usage: sfsmicro
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fileSystem.h"
+#include "blockio.h"
+#include "storeInt.h"
+#include "pathUtils.h"
+#include "fControl.h"
+#include "entry.h"
+#include "scheduler.h"
+#include "superblock.h"
+
+#define ROUNDS      20
+#define PROBES      200
+#define LOOKUPS     100000
+#define CODES       1000000
+#define FILE_SIZE   (32 * 1024)
+#define CHUNK       128
+#define MAX_DEPTH   8
+
+// The disk modelled for benchDevice, with the costs of a small hard disk in nanoseconds and bytes per second
+#define DEVICE_LATENCY      100000
+#define DEVICE_SEEK         2000
+#define DEVICE_BANDWIDTH    100000000
+#define DEVICE_DEPTH        8
+
+// Whether a record has been printed yet, for the commas between records
+static int printed = 0;
+
+// Contents of every write
+static char data[MAX_IO_LENGTH];
+
+/*
+ * now: Reads the monotonic clock in nanoseconds.
+ */
+static long now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/*
+ * emit: Prints the result of one measurement as a JSON record.
+ *
+ * @benchmark   String      what was measured
+ * @variant     String      how it was measured
+ * @param       String      name of the parameter that was varied, or NULL
+ * @value       Integer     value of the parameter
+ * @iterations  Integer     how many operations were timed
+ * @elapsed     Integer     how long they took, in nanoseconds
+ */
+static void emit(const char* benchmark, const char* variant, const char* param, long value, long iterations,
+        long elapsed) {
+    printf("%s\n    {\"benchmark\": \"%s\", \"variant\": \"%s\"", printed++ ? "," : "", benchmark, variant);
+
+    if (param != NULL) {
+        printf(", \"%s\": %ld", param, value);
+    }
+
+    printf(", \"iterations\": %ld, \"ns_per_op\": %.1f, \"ops_per_sec\": %.0f}", iterations,
+            (double) elapsed / iterations, iterations / (elapsed / 1e9 + 1e-12));
+}
+
+/*
+ * format: Erases the disk, stopping the run when it cannot be erased.
+ */
+static void format() {
+    if (sfs_initialize(1) != 1) {
+        fprintf(stderr, "sfsmicro: the disk could not be formatted.\n");
+        exit(1);
+    }
+}
+
+/*
+ * find: Resolves a path to its starting block, stopping the run when it does not resolve.
+ */
+static int find(const char* pathname) {
+    char** path = malloc(MAX_PATH * sizeof(char*));
+    int blockID;
+
+    for (int i = 0; i < MAX_PATH; i++) {
+        path[i] = malloc(MAX_DIRNAME + 1);
+    }
+
+    if (parsePath(path, pathname) || traverse(&blockID, path)) {
+        fprintf(stderr, "sfsmicro: %s could not be found.\n", pathname);
+        exit(1);
+    }
+
+    for (int i = 0; i < MAX_PATH; i++) {
+        free(path[i]);
+    }
+
+    free(path);
+
+    return blockID;
+}
+
+/*
+ * fill: Writes to a file until it is length bytes long.
+ */
+static void fill(const char* pathname, size_t from, size_t length) {
+    int fd = sfs_open((char*) pathname);
+
+    for (size_t start = from; start < length; start += MAX_IO_LENGTH) {
+        size_t n = length - start < MAX_IO_LENGTH ? length - start : MAX_IO_LENGTH;
+
+        if (sfs_pwrite(fd, start, n, data) != 1) {
+            fprintf(stderr, "sfsmicro: %s could not be written.\n", pathname);
+            exit(1);
+        }
+    }
+
+    sfs_close(fd);
+}
+
+/*
+ * benchBlocks: Throughput of get_block and put_block, in disk order and in random order.
+ */
+static void benchBlocks() {
+    static char disk[BLOCKS][BLOCK_SIZE];
+    int order[BLOCKS];
+
+    format();
+
+    for (int i = 0; i < BLOCKS; i++) {
+        order[i] = rand() % BLOCKS;
+        get_block(i, disk[i]);
+    }
+
+    for (int random = 0; random < 2; random++) {
+        char block[BLOCK_SIZE];
+        long start = now();
+
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < BLOCKS; i++) {
+                get_block(random ? order[i] : i, block);
+            }
+        }
+
+        emit("get_block", random ? "random" : "sequential", NULL, 0, ROUNDS * BLOCKS, now() - start);
+
+        // Every block is written back with its own contents
+        start = now();
+
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < BLOCKS; i++) {
+                int blockID = random ? order[i] : i;
+                put_block(blockID, disk[blockID]);
+            }
+        }
+
+        emit("put_block", random ? "random" : "sequential", NULL, 0, ROUNDS * BLOCKS, now() - start);
+    }
+}
+
+/*
+ * benchDevice: Simulated cost of get_block under a model of a disk with seeks and a queue,
+ * in disk order, in random order, and in random order with the requests queued together.
+ */
+static void benchDevice() {
+    char block[BLOCK_SIZE];
+    int order[BLOCKS];
+
+    format();
+
+    for (int i = 0; i < BLOCKS; i++) {
+        order[i] = rand() % BLOCKS;
+    }
+
+    const char* variants[3] = { "sequential", "random", "random_queued" };
+
+    for (int variant = 0; variant < 3; variant++) {
+        set_disk_model(DEVICE_LATENCY, DEVICE_SEEK, DEVICE_BANDWIDTH, DEVICE_DEPTH, 0);
+
+        if (variant == 2) {
+            plug_disk();
+        }
+
+        for (int i = 0; i < BLOCKS; i++) {
+            get_block(variant ? order[i] : i, block);
+        }
+
+        if (variant == 2) {
+            unplug_disk();
+        }
+
+        emit("get_block_modelled", variants[variant], "queue_depth", variant == 2 ? DEVICE_DEPTH : 1, BLOCKS,
+                disk_clock());
+    }
+
+    // The same random writes issued one by one, then as a batch the scheduler sorts and merges
+    static char disk[BLOCKS][BLOCK_SIZE];
+    struct request writes[BLOCKS];
+
+    for (int i = 0; i < BLOCKS; i++) {
+        get_block(i, disk[i]);
+
+        writes[i].blockID = order[i];
+        writes[i].write = WRITE_REQUEST;
+        writes[i].buffer = disk[order[i]];
+    }
+
+    for (int batched = 0; batched < 2; batched++) {
+        set_disk_model(DEVICE_LATENCY, DEVICE_SEEK, DEVICE_BANDWIDTH, DEVICE_DEPTH, 0);
+
+        if (batched) {
+            submitBatch(writes, BLOCKS);
+        } else {
+            for (int i = 0; i < BLOCKS; i++) {
+                put_block(order[i], disk[order[i]]);
+            }
+        }
+
+        emit("put_block_modelled", batched ? "random_scheduled" : "random", "head_travel", disk_travel(), BLOCKS,
+                disk_clock());
+    }
+
+    set_disk_model(0, 0, 0, 1, 0);
+}
+
+/*
+ * benchAlloc: Latency of getFreeBlock as the disk fills up.
+ */
+static void benchAlloc() {
+    format();
+    sfs_create("/f", 0);
+
+    size_t size = 0;
+
+    for (int percent = 0; percent <= 90; percent += percent < 75 ? 25 : 15) {
+        size_t target = (size_t) percent * (BLOCKS - RESERVED_BLOCKS) / 100 * DATA_SIZE;
+
+        fill("/f", size, target);
+        size = target > size ? target : size;
+
+        int blockID;
+        long start = now();
+
+        for (int i = 0; i < PROBES; i++) {
+            if (getFreeBlock(&blockID, ROOT_BLOCKID)) {
+                fprintf(stderr, "sfsmicro: no free block at %d%% full.\n", percent);
+                exit(1);
+            }
+        }
+
+        emit("getFreeBlock", "hint_root", "fill_percent", percent, PROBES, now() - start);
+    }
+}
+
+/*
+ * benchTraverse: Cost of resolving a path as it gets deeper, reading directories from the disk
+ * and from memory.
+ */
+static void benchTraverse() {
+    char pathname[MAX_PATH] = "";
+    char* path[MAX_DEPTH][MAX_DEPTH + 2];
+
+    format();
+
+    for (int depth = 1; depth <= MAX_DEPTH; depth++) {
+        strcat(pathname, "/d");
+        sfs_create(pathname, 1);
+
+        for (int i = 0; i < MAX_DEPTH + 2; i++) {
+            path[depth - 1][i] = malloc(MAX_DIRNAME + 1);
+        }
+
+        parsePath(path[depth - 1], pathname);
+    }
+
+    for (int preload = 0; preload < 2; preload++) {
+        sfs_preload(preload);
+
+        for (int depth = 1; depth <= MAX_DEPTH; depth++) {
+            int blockID;
+            long start = now();
+
+            for (int i = 0; i < PROBES; i++) {
+                traverse(&blockID, path[depth - 1]);
+            }
+
+            emit("traverse", preload ? "preloaded" : "disk", "depth", depth, PROBES, now() - start);
+        }
+    }
+
+    sfs_preload(0);
+}
+
+/*
+ * benchLookup: Cost of finding a name in a full directory, read from the disk and from memory,
+ * for the last entry and for a name that is not there.
+ */
+static void benchLookup() {
+    char name[MAX_PATH];
+
+    format();
+    sfs_create("/l", 1);
+
+    int fcBlockID = find("/l");
+
+    for (int k = 0; k < ENTRY_SLOTS; k++) {
+        sprintf(name, "/l/f%d", k);
+        sfs_create(name, 1);
+    }
+
+    sprintf(name, "f%d", ENTRY_SLOTS - 1);
+
+    for (int preload = 0; preload < 2; preload++) {
+        sfs_preload(preload);
+
+        for (int missing = 0; missing < 2; missing++) {
+            int blockID;
+            long start = now();
+
+            for (int i = 0; i < LOOKUPS; i++) {
+                getStart(&blockID, fcBlockID, missing ? "none" : name);
+            }
+
+            emit("getStart", preload ? (missing ? "preloaded_missing" : "preloaded_last")
+                    : (missing ? "disk_missing" : "disk_last"), "entries", ENTRY_SLOTS, LOOKUPS, now() - start);
+        }
+    }
+
+    sfs_preload(0);
+}
+
+/*
+ * benchReadDir: Cost of listing a whole directory as it gets bigger.
+ */
+static void benchReadDir() {
+    char listing[ENTRY_SLOTS * MAX_DIRNAME + 1];
+
+    format();
+    sfs_create("/r", 1);
+
+    int blockID = find("/r");
+
+    for (int size = 0; size < ENTRY_SLOTS; size++) {
+        long start = now();
+
+        for (int i = 0; i < PROBES; i++) {
+            for (int step = 0; readDir(listing, blockID, step) == 0; step++) {
+            }
+        }
+
+        emit("readDir", "full_listing", "entries", size, PROBES, now() - start);
+
+        char name[MAX_PATH];
+        sprintf(name, "/r/e%d", size);
+        sfs_create(name, 0);
+    }
+}
+
+/*
+ * benchReadFile: Cost of reading a long file in order, at random, and at a single offset
+ * further and further down its chain.
+ */
+static void benchReadFile() {
+    char buffer[CHUNK];
+    int chunks = FILE_SIZE / CHUNK;
+
+    format();
+    sfs_create("/f", 0);
+    fill("/f", 0, FILE_SIZE);
+
+    int blockID = find("/f");
+
+    for (int random = 0; random < 2; random++) {
+        long start = now();
+
+        for (int r = 0; r < ROUNDS; r++) {
+            for (int i = 0; i < chunks; i++) {
+                readFile(buffer, blockID, (random ? rand() % chunks : i) * CHUNK, CHUNK);
+            }
+        }
+
+        emit("readFile", random ? "random" : "sequential", "bytes", CHUNK, ROUNDS * chunks, now() - start);
+    }
+
+    for (int quarter = 0; quarter <= 4; quarter++) {
+        int offset = quarter * (FILE_SIZE - CHUNK) / 4;
+        long start = now();
+
+        for (int i = 0; i < PROBES; i++) {
+            readFile(buffer, blockID, offset, CHUNK);
+        }
+
+        emit("readFile", "offset", "offset", offset, PROBES, now() - start);
+    }
+}
+
+/*
+ * benchCodes: Cost of encode_int and decode_int over every block number.
+ */
+static void benchCodes() {
+    char codes[BLOCKS + 1][START];
+    long sum = 0;
+    long start = now();
+
+    for (int i = 0; i < CODES; i++) {
+        char* code = encode_int(i % (BLOCKS + 1) - 1);
+        memcpy(codes[i % (BLOCKS + 1)], code, START);
+        free(code);
+    }
+
+    emit("encode_int", "all_blocks", NULL, 0, CODES, now() - start);
+
+    start = now();
+
+    for (int i = 0; i < CODES; i++) {
+        sum += decode_int(codes[i % (BLOCKS + 1)]);
+    }
+
+    emit("decode_int", "all_blocks", NULL, 0, CODES, now() - start);
+
+    // Use the sum, so that the decoding is not optimized away
+    if (sum == 0) {
+        fprintf(stderr, "sfsmicro: the block numbers decoded to nothing.\n");
+    }
+}
+
+int main() {
+    for (int i = 0; i < MAX_IO_LENGTH; i++) {
+        data[i] = 'a' + i % 26;
+    }
+
+    srand(1);
+
+    printf("{\n  \"blocks\": %d,\n  \"block_size\": %d,\n  \"results\": [", BLOCKS, BLOCK_SIZE);
+
+    benchCodes();
+    benchBlocks();
+    benchDevice();
+    benchAlloc();
+    benchTraverse();
+    benchLookup();
+    benchReadDir();
+    benchReadFile();
+
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
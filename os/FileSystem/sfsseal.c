@@ -0,0 +1,27 @@
+/*
+ * sfsseal.c
+ *
+ * Seals the disk in simdisk.data, so that it can be served read-only
+ * with every path resolved through a perfect hash.
+ *
+ * usage: sfsseal
+ */
+
+#include <stdio.h>
+#include "fileSystem.h"
+
+int main() {
+    if (sfs_initialize(0) != 1) {
+        fprintf(stderr, "sfsseal: the disk could not be mounted.\n");
+        return 1;
+    }
+
+    if (sfs_seal() != 1) {
+        fprintf(stderr, "sfsseal: the disk could not be sealed.\n");
+        return 1;
+    }
+
+    printf("sfsseal: the disk is sealed.\n");
+
+    return 0;
+}
@@ -18,11 +18,29 @@
  You are free to make a copy of this program and to modify your
  copy for the purposes of testing your file system implementation.
  ******************************************************/
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 // Header File for implementations for the sfs_* functions.
 #include "fileSystem.h"
 
+// Headers of the layers below, which the scripted tests look into
+#include "blockio.h"
+#include "cache.h"
+#include "entry.h"
+#include "fControl.h"
+#include "pathUtils.h"
+#include "scheduler.h"
+#include "stats.h"
+#include "storeInt.h"
+#include "superblock.h"
+
 
 #include "openFiles.h"
 /*****************************************************
@@ -64,17 +82,1462 @@ char data_buffer_1[MAX_INPUT_LENGTH];
 /* the following are used to hold integer input parameters */
 int p1, p2, p3;
 
+/*****************************************************
+ scripted tests, run with "sfstest -t" or "make test"
+ Every scenario starts from an erased disk, and must
+ leave the disk clean for sfs_fsck.
+ ******************************************************/
+
+/* the number of checks failed by the scenario running */
+int failures;
+
+#define CHECK(condition) \
+    if (!(condition)) { \
+        printf("  %s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    }
+
+/* fills a buffer with bytes that depend on the seed, null chars included */
+void fill_pattern(char* buffer, int length, int seed) {
+    for (int k = 0; k < length; k++) {
+        buffer[k] = (char) ((k * 7 + seed) % 13 == 0 ? '\0' : 'a' + (k + seed) % 26);
+    }
+}
+
+/* resolves a path to its starting block, or -1 */
+int block_of(const char* pathname) {
+    static char names[MAX_PATH][MAX_DIRNAME + 1];
+    char* path[MAX_PATH];
+    int blockID;
+
+    for (int k = 0; k < MAX_PATH; k++) {
+        path[k] = names[k];
+    }
+
+    if (parsePath(path, pathname) || traverse(&blockID, path)) {
+        return -1;
+    }
+
+    return blockID;
+}
+
+/* reads the chain of blocks of a file into blockIDs, returning its length */
+int chain_of(const char* pathname, int* blockIDs) {
+    char block[BLOCK_SIZE];
+    int count = 0;
+
+    for (int blockID = block_of(pathname); blockID >= 0 && blockID < BLOCKS && count < BLOCKS; count++) {
+        blockIDs[count] = blockID;
+
+        if (get_block(blockID, block)) {
+            break;
+        }
+
+        blockID = decode_int(&block[NEXT_BLOCK]);
+    }
+
+    return count;
+}
+
+/* reads at most size - 1 bytes of a side file into text and ends them with a null char,
+ returning how many were read, or -1 if there is no such file. fControl.h takes the
+ name FILE for a file type, so side files are read and written without stdio */
+int read_file(const char* filename, char* text, int size) {
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    int length = read(fd, text, size - 1);
+    close(fd);
+
+    text[length > 0 ? length : 0] = '\0';
+
+    return length;
+}
+
+/* replaces the contents of a side file with text, returning 0 if they were written */
+int write_file(const char* filename, const char* text) {
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    int length = write(fd, text, strlen(text));
+    close(fd);
+
+    return length == (int) strlen(text) ? 0 : -1;
+}
+
+/* checks that the disk has no loops, cross links, leaks or dangling pointers */
+void check_clean() {
+    struct sfs_fsck report;
+
+    CHECK(sfs_fsck(0, &report) == 1);
+    CHECK(report.loops == 0);
+    CHECK(report.crossLinked == 0);
+    CHECK(report.leaked == 0);
+    CHECK(report.dangling == 0);
+}
+
+/* sfs_pread/sfs_pwrite round-trip binary data, and never read past the end of the file */
+void test_pread() {
+    char data[600];
+    char back[600];
+
+    fill_pattern(data, sizeof data, 3);
+
+    CHECK(sfs_create("/big", 0) == 1);
+    int fd = sfs_open("/big");
+    CHECK(fd >= 0);
+
+    CHECK(sfs_pwrite(fd, 0, 300, data) == 1);
+    CHECK(sfs_getsize("/big") == 300);
+
+    memset(back, 0, sizeof back);
+    CHECK(sfs_pread(fd, 0, 300, back) == 1);
+    CHECK(memcmp(data, back, 300) == 0);
+
+    // Past the end of the file, whether or not the chain goes on
+    CHECK(sfs_pread(fd, 0, 310, back) < 0);
+    CHECK(sfs_pread(fd, 290, 20, back) < 0);
+    CHECK(sfs_pread(fd, 295, 5, back) == 1);
+    CHECK(memcmp(&data[295], back, 5) == 0);
+
+    // Writing past the end fills the gap with zeros
+    CHECK(sfs_pwrite(fd, 400, 200, &data[400]) == 1);
+    CHECK(sfs_getsize("/big") == 600);
+    CHECK(sfs_pread(fd, 0, 600, back) == 1);
+    CHECK(memcmp(data, back, 300) == 0);
+    CHECK(back[300] == '\0' && back[399] == '\0');
+    CHECK(memcmp(&data[400], &back[400], 200) == 0);
+
+    // An io vector is filled across its elements, and no further than the file goes
+    struct iovec iov[2];
+    iov[0].iov_base = back;
+    iov[0].iov_len = 150;
+    iov[1].iov_base = &back[150];
+    iov[1].iov_len = 450;
+
+    memset(back, 0, sizeof back);
+    CHECK(sfs_readv(fd, 0, iov, 2) == 1);
+    CHECK(memcmp(&data[400], &back[400], 200) == 0);
+    CHECK(sfs_readv(fd, 10, iov, 2) < 0);
+
+    // Ranges past the largest file, or whose end does not fit in a size_t, change nothing
+    CHECK(sfs_pwrite(fd, SIZE_MAX - 5, 10, data) < 0);
+    CHECK(sfs_pwrite(fd, 1000000000, 10, data) < 0);
+    CHECK(sfs_pread(fd, SIZE_MAX - 5, 10, back) < 0);
+    iov[0].iov_len = SIZE_MAX - 100;
+    CHECK(sfs_writev(fd, 0, iov, 2) < 0);
+    CHECK(sfs_readv(fd, 0, iov, 2) < 0);
+    CHECK(sfs_getsize("/big") == 600);
+    CHECK(sfs_close(fd) == 1);
+
+    // A file held within a single block, and a file stored inline
+    CHECK(sfs_create("/one", 0) == 1);
+    fd = sfs_open("/one");
+    CHECK(sfs_pwrite(fd, 0, 50, data) == 1);
+    CHECK(sfs_pread(fd, 0, 50, back) == 1);
+    CHECK(sfs_pread(fd, 0, 60, back) < 0);
+    CHECK(sfs_close(fd) == 1);
+
+    CHECK(sfs_create("/tiny", 0) == 1);
+    fd = sfs_open("/tiny");
+    CHECK(sfs_pwrite(fd, 0, 10, data) == 1);
+    CHECK(sfs_getsize("/tiny") == 10);
+    CHECK(sfs_pread(fd, 0, 10, back) == 1);
+    CHECK(memcmp(data, back, 10) == 0);
+    CHECK(sfs_pread(fd, 0, 20, back) < 0);
+    CHECK(sfs_close(fd) == 1);
+}
+
+/* sfs_writev drains every element of an io vector in order */
+void test_writev() {
+    char data[500];
+    char back[500];
+
+    fill_pattern(data, sizeof data, 11);
+
+    struct iovec iov[3];
+    iov[0].iov_base = data;
+    iov[0].iov_len = 1;
+    iov[1].iov_base = &data[1];
+    iov[1].iov_len = 0;
+    iov[2].iov_base = &data[1];
+    iov[2].iov_len = 399;
+
+    CHECK(sfs_create("/v", 0) == 1);
+    int fd = sfs_open("/v");
+    CHECK(sfs_writev(fd, 100, iov, 3) == 1);
+    CHECK(sfs_getsize("/v") == 500);
+
+    CHECK(sfs_pread(fd, 100, 400, back) == 1);
+    CHECK(memcmp(data, back, 400) == 0);
+    CHECK(sfs_pread(fd, 0, 100, back) == 1);
+
+    for (int k = 0; k < 100; k++) {
+        CHECK(back[k] == '\0');
+    }
+
+    CHECK(sfs_writev(fd, 0, NULL, 1) < 0);
+    CHECK(sfs_writev(fd, 0, iov, -1) < 0);
+    CHECK(sfs_writev(fd, 0, iov, 0) == 1);
+    CHECK(sfs_getsize("/v") == 500);
+    CHECK(sfs_close(fd) == 1);
+}
+
+/* sfs_rename moves entries, and sfs_copy_range copies data between open files */
+void test_rename_copy() {
+    char data[400];
+    char back[400];
+
+    fill_pattern(data, sizeof data, 13);
+
+    CHECK(sfs_create("/a", 1) == 1);
+    CHECK(sfs_create("/b", 1) == 1);
+    CHECK(sfs_create("/a/f", 0) == 1);
+    int fd = sfs_open("/a/f");
+    CHECK(sfs_pwrite(fd, 0, 400, data) == 1);
+
+    // The descriptor follows the file, which keeps its blocks
+    CHECK(sfs_rename("/a/f", "/b/g") == 1);
+    CHECK(sfs_gettype("/a/f") < 0);
+    CHECK(sfs_getsize("/b/g") == 400);
+    CHECK(sfs_pread(fd, 0, 400, back) == 1);
+    CHECK(memcmp(data, back, 400) == 0);
+    CHECK(sfs_close(fd) == 1);
+
+    CHECK(sfs_rename("/b/g", "/b/g") < 0);
+
+    // A seven-char name is cut to six, as sfs_create cuts it
+    CHECK(sfs_create("/abcdef", 0) == 1);
+    CHECK(sfs_rename("/abcdef", "/abcdefg") == 1);
+    CHECK(sfs_gettype("/abcdef") == 0);
+    CHECK(sfs_delete("/abcdef") == 1);
+    CHECK(sfs_rename("/a", "/a/x") < 0);
+    CHECK(sfs_rename("/", "/c") < 0);
+    CHECK(sfs_rename("/b", "/a/b") == 1);
+    CHECK(sfs_getsize("/a/b/g") == 400);
+
+    // A small file stored inline moves with its entry
+    CHECK(sfs_create("/a/s", 0) == 1);
+    fd = sfs_open("/a/s");
+    CHECK(sfs_pwrite(fd, 0, 8, "inline!!") == 1);
+    CHECK(sfs_rename("/a/s", "/t") == 1);
+    CHECK(sfs_pread(fd, 0, 8, back) == 1);
+    CHECK(memcmp(back, "inline!!", 8) == 0);
+    CHECK(sfs_close(fd) == 1);
+
+    // Renamed within a full directory, an inline file keeps its data and its descriptors
+    CHECK(sfs_create("/d", 1) == 1);
+    CHECK(sfs_create("/d/x0", 0) == 1);
+    CHECK(sfs_create("/d/x1", 0) == 1);
+    CHECK(sfs_create("/d/y", 0) == 1);
+    fd = sfs_open("/d/x0");
+    CHECK(sfs_pwrite(fd, 0, 24, "qqqqqqqqqqqqqqqqqqqqqqqq") == 1);
+    CHECK(sfs_close(fd) == 1);
+    fd = sfs_open("/d/x1");
+    CHECK(sfs_pwrite(fd, 0, 24, "rrrrrrrrrrrrrrrrrrrrrrrr") == 1);
+    CHECK(sfs_close(fd) == 1);
+    fd = sfs_open("/d/y");
+    CHECK(sfs_pwrite(fd, 0, 8, "ssssssss") == 1);
+    CHECK(sfs_close(fd) == 1);
+    CHECK(sfs_rename("/d/y", "/d/z") == 1);
+    CHECK(sfs_rename("/d/z", "/d/x1") < 0);
+    fd = sfs_open("/d/x0");
+    CHECK(sfs_rename("/d/x0", "/d/w") == 1);
+    CHECK(sfs_pwrite(fd, 0, 5, "HELLO") == 1);
+    CHECK(sfs_close(fd) == 1);
+    fd = sfs_open("/d/w");
+    CHECK(sfs_pread(fd, 0, 24, back) == 1);
+    CHECK(memcmp(back, "HELLOqqqqqqqqqqqqqqqqqqq", 24) == 0);
+    CHECK(sfs_close(fd) == 1);
+    fd = sfs_open("/d/z");
+    CHECK(sfs_pread(fd, 0, 8, back) == 1);
+    CHECK(memcmp(back, "ssssssss", 8) == 0);
+    CHECK(sfs_close(fd) == 1);
+    CHECK(sfs_gettype("/d/x0") < 0);
+    CHECK(sfs_gettype("/d/y") < 0);
+    check_clean();
+
+    int in = sfs_open("/a/b/g");
+    CHECK(sfs_create("/copy", 0) == 1);
+    int out = sfs_open("/copy");
+    CHECK(sfs_copy_range(in, out, 50, 300) == 1);
+    CHECK(sfs_getsize("/copy") == 350);
+    CHECK(sfs_pread(out, 50, 300, back) == 1);
+    CHECK(memcmp(&data[50], back, 300) == 0);
+
+    // Nothing is copied from past the end of the source
+    CHECK(sfs_copy_range(in, out, 300, 101) < 0);
+    CHECK(sfs_getsize("/copy") == 350);
+
+    // Nor from a range whose end wraps around, even within a single file
+    CHECK(sfs_copy_range(in, in, SIZE_MAX - 5, 10) < 0);
+    CHECK(sfs_copy_range(in, out, SIZE_MAX - 5, 10) < 0);
+    CHECK(sfs_getsize("/copy") == 350);
+    CHECK(sfs_close(in) == 1);
+    CHECK(sfs_close(out) == 1);
+}
+
+/* a snapshot keeps the data it was taken with, and is mounted only with no files open */
+void test_snapshot() {
+    char data[300];
+    char back[300];
+
+    fill_pattern(data, sizeof data, 5);
+
+    CHECK(sfs_create("/dir", 1) == 1);
+    CHECK(sfs_create("/dir/f", 0) == 1);
+    int fd = sfs_open("/dir/f");
+    CHECK(sfs_pwrite(fd, 0, 300, data) == 1);
+
+    CHECK(sfs_snapshot("snap") == 1);
+
+    // The live tree writes copies of the blocks it shares with the snapshot
+    CHECK(sfs_pwrite(fd, 100, 5, "ZZZZZ") == 1);
+    CHECK(sfs_create("/dir/g", 0) == 1);
+
+    // An open descriptor would point into the wrong tree
+    CHECK(sfs_mount("snap") < 0);
+    CHECK(sfs_pread(fd, 100, 5, back) == 1);
+    CHECK(memcmp(back, "ZZZZZ", 5) == 0);
+    CHECK(sfs_close(fd) == 1);
+
+    CHECK(sfs_mount("snap") == 1);
+    CHECK(sfs_gettype("/dir/g") < 0);
+    fd = sfs_open("/dir/f");
+    CHECK(fd >= 0);
+    CHECK(sfs_pread(fd, 0, 300, back) == 1);
+    CHECK(memcmp(data, back, 300) == 0);
+    CHECK(sfs_pwrite(fd, 0, 5, "ZZZZZ") < 0);
+    CHECK(sfs_close(fd) == 1);
+
+    CHECK(sfs_mount(NULL) == 1);
+    CHECK(sfs_gettype("/dir/g") == 0);
+    CHECK(sfs_mount("none") < 0);
+}
+
+/* deleting a snapshot frees the blocks only it held, and lets generations start over */
+void test_snapshot_delete() {
+    char data[400];
+    struct sfs_fsck before;
+    struct sfs_fsck after;
+
+    fill_pattern(data, sizeof data, 7);
+
+    CHECK(sfs_create("/f", 0) == 1);
+    int fd = sfs_open("/f");
+    CHECK(sfs_pwrite(fd, 0, 400, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+
+    CHECK(sfs_snapshot("snap") == 1);
+    CHECK(sfs_delete("/f") == 1);
+    CHECK(sfs_reclaim(BLOCKS) >= 0);
+
+    // The snapshot still holds the chain of the deleted file
+    CHECK(sfs_fsck(0, &before) == 1);
+    CHECK(sfs_delete_snapshot("none") < 0);
+    CHECK(sfs_delete_snapshot("snap") == 1);
+    CHECK(sfs_mount("snap") < 0);
+    CHECK(sfs_fsck(0, &after) == 1);
+    CHECK(after.reachable < before.reachable);
+
+    // A file written before a snapshot that was deleted is freed on delete
+    CHECK(sfs_create("/g", 0) == 1);
+    fd = sfs_open("/g");
+    CHECK(sfs_pwrite(fd, 0, 400, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+    CHECK(sfs_snapshot("snap") == 1);
+    CHECK(sfs_create("/keep", 0) == 1);
+    CHECK(sfs_snapshot("keep") == 1);
+    CHECK(sfs_delete_snapshot("keep") == 1);
+    CHECK(sfs_delete_snapshot("snap") == 1);
+    CHECK(sfs_delete("/g") == 1);
+    CHECK(sfs_reclaim(BLOCKS) >= 0);
+    CHECK(sfs_fsck(0, &after) == 1);
+    CHECK(after.leaked == 0);
+
+    // Generations run out while a snapshot is kept, and start over once none is left
+    CHECK(sfs_snapshot("base") == 1);
+
+    int taken = 0;
+
+    while (taken < 300 && sfs_snapshot("tmp") == 1) {
+        CHECK(sfs_delete_snapshot("tmp") == 1);
+        taken++;
+    }
+
+    CHECK(taken < 300);
+    CHECK(sfs_snapshot("tmp") == -3);
+    CHECK(sfs_delete_snapshot("base") == 1);
+
+    for (int k = 0; k < 300; k++) {
+        CHECK(sfs_snapshot("tmp") == 1);
+        CHECK(sfs_delete_snapshot("tmp") == 1);
+    }
+}
+
+/* identical file blocks are stored once, and freed with the last file pointing at them */
+void test_dedup() {
+    char data[600];
+    char back[600];
+    struct sfs_fsck empty;
+    struct sfs_fsck one;
+    struct sfs_fsck two;
+
+    fill_pattern(data, sizeof data, 17);
+
+    CHECK(sfs_dedup(1) == 1);
+    CHECK(sfs_create("/a", 0) == 1);
+    CHECK(sfs_create("/b", 0) == 1);
+    CHECK(sfs_fsck(0, &empty) == 1);
+
+    int a = sfs_open("/a");
+    int b = sfs_open("/b");
+    CHECK(sfs_pwrite(a, 0, 600, data) == 1);
+    CHECK(sfs_fsck(0, &one) == 1);
+    CHECK(sfs_pwrite(b, 0, 600, data) == 1);
+    CHECK(sfs_fsck(0, &two) == 1);
+
+    // Empty files are stored inline; of the second copy, only the starting block is its own
+    CHECK(one.reachable == empty.reachable + 5);
+    CHECK(two.reachable == one.reachable + 1);
+
+    // Writing one copy gives it a private block again
+    CHECK(sfs_pwrite(b, 300, 5, "ZZZZZ") == 1);
+    CHECK(sfs_pread(a, 0, 600, back) == 1);
+    CHECK(memcmp(data, back, 600) == 0);
+    CHECK(sfs_close(a) == 1);
+    CHECK(sfs_close(b) == 1);
+    check_clean();
+
+    // The blocks outlive the first file deleted, and go with the second
+    CHECK(sfs_delete("/a") == 1);
+    CHECK(sfs_reclaim(BLOCKS) >= 0);
+    b = sfs_open("/b");
+    CHECK(sfs_pread(b, 0, 300, back) == 1);
+    CHECK(memcmp(data, back, 300) == 0);
+    CHECK(sfs_close(b) == 1);
+    check_clean();
+
+    CHECK(sfs_delete("/b") == 1);
+    CHECK(sfs_reclaim(BLOCKS) >= 0);
+    CHECK(sfs_fsck(0, &two) == 1);
+    CHECK(two.reachable == empty.reachable);
+    check_clean();
+
+    // A file deduplicated against blocks held by a snapshot counts as one of their pointers
+    CHECK(sfs_create("/c", 0) == 1);
+    int c = sfs_open("/c");
+    CHECK(sfs_pwrite(c, 0, 600, data) == 1);
+    CHECK(sfs_close(c) == 1);
+    CHECK(sfs_snapshot("snap") == 1);
+    CHECK(sfs_create("/d", 0) == 1);
+    int d = sfs_open("/d");
+    CHECK(sfs_pwrite(d, 0, 600, data) == 1);
+    CHECK(sfs_close(d) == 1);
+    CHECK(sfs_delete_snapshot("snap") == 1);
+    check_clean();
+
+    d = sfs_open("/d");
+    CHECK(sfs_getsize("/d") == 600);
+    CHECK(sfs_pread(d, 0, 600, back) == 1);
+    CHECK(memcmp(data, back, 600) == 0);
+    CHECK(sfs_close(d) == 1);
+
+    CHECK(sfs_delete("/c") == 1);
+    CHECK(sfs_delete("/d") == 1);
+    CHECK(sfs_reclaim(BLOCKS) >= 0);
+    CHECK(sfs_fsck(0, &two) == 1);
+    CHECK(two.reachable == empty.reachable);
+
+    // Blocks that only an older snapshot still holds are not handed out to a live file
+    CHECK(sfs_create("/e", 0) == 1);
+    CHECK(sfs_create("/f", 0) == 1);
+    int e = sfs_open("/e");
+    CHECK(sfs_pwrite(e, 0, 244, data) == 1);
+    CHECK(sfs_snapshot("s0") == 1);
+    CHECK(sfs_truncate(e, 0) == 1);
+    CHECK(sfs_snapshot("s1") == 1);
+    int f = sfs_open("/f");
+    CHECK(sfs_pwrite(f, 0, 244, data) == 1);
+    CHECK(sfs_delete_snapshot("s0") == 1);
+    CHECK(sfs_pread(f, 0, 244, back) == 1);
+    CHECK(memcmp(data, back, 244) == 0);
+    CHECK(sfs_truncate(f, 0) == 1);
+    check_clean();
+    CHECK(sfs_close(e) == 1);
+    CHECK(sfs_close(f) == 1);
+    CHECK(sfs_delete_snapshot("s1") == 1);
+    check_clean();
+
+    CHECK(sfs_delete("/e") == 1);
+    CHECK(sfs_delete("/f") == 1);
+    CHECK(sfs_dedup(0) == 1);
+}
+
+/* a small file lives in its parent's fcb until it outgrows INLINE_MAX bytes */
+void test_inline() {
+    char data[200];
+    char back[200];
+    struct sfs_fsck empty;
+    struct sfs_fsck after;
+
+    fill_pattern(data, sizeof data, 19);
+
+    CHECK(sfs_fsck(0, &empty) == 1);
+    CHECK(sfs_create("/s", 0) == 1);
+    int fd = sfs_open("/s");
+
+    // Up to 24 bytes take no block of their own
+    CHECK(sfs_pwrite(fd, 0, 24, data) == 1);
+    CHECK(sfs_getsize("/s") == 24);
+    CHECK(sfs_fsck(0, &after) == 1);
+    CHECK(after.reachable == empty.reachable);
+    CHECK(sfs_pread(fd, 0, 24, back) == 1);
+    CHECK(memcmp(data, back, 24) == 0);
+
+    // A range whose end wraps around is refused, and leaves the file inline
+    CHECK(sfs_pwrite(fd, SIZE_MAX - 5, 10, "0123456789") < 0);
+    CHECK(sfs_getsize("/s") == 24);
+    CHECK(sfs_fsck(0, &after) == 1);
+    CHECK(after.reachable == empty.reachable);
+
+    // One more byte moves the file to a block, under the same descriptor
+    CHECK(sfs_pwrite(fd, 24, 1, &data[24]) == 1);
+    CHECK(sfs_getsize("/s") == 25);
+    CHECK(sfs_fsck(0, &after) == 1);
+    CHECK(after.reachable == empty.reachable + 1);
+    CHECK(sfs_pwrite(fd, 25, 175, &data[25]) == 1);
+    CHECK(sfs_pread(fd, 0, 200, back) == 1);
+    CHECK(memcmp(data, back, 200) == 0);
+    CHECK(sfs_close(fd) == 1);
+
+    // Several inline files share one fcb with ordinary entries
+    CHECK(sfs_create("/t", 0) == 1);
+    CHECK(sfs_create("/u", 1) == 1);
+    fd = sfs_open("/t");
+    CHECK(sfs_write(fd, 0, 10, "0123456789") == 1);
+    CHECK(sfs_read(fd, 0, 10, back) == 1);
+    CHECK(memcmp(back, "0123456789", 10) == 0);
+    CHECK(sfs_close(fd) == 1);
+    CHECK(sfs_gettype("/u") == 1);
+
+    CHECK(sfs_delete("/t") == 1);
+    CHECK(sfs_gettype("/t") < 0);
+    CHECK(sfs_getsize("/s") == 200);
+}
+
+/* batches create and delete files across several directories */
+void test_batch() {
+    char* dirs[] = { "/p", "/p/q", "/r" };
+    char* files[] = { "/p/a", "/p/b", "/p/q/c", "/r/d", "/e" };
+
+    CHECK(sfs_create_batch(dirs, 3, 1) == 1);
+    CHECK(sfs_create_batch(files, 5, 0) == 1);
+
+    for (int k = 0; k < 3; k++) {
+        CHECK(sfs_gettype(dirs[k]) == 1);
+    }
+
+    for (int k = 0; k < 5; k++) {
+        CHECK(sfs_gettype(files[k]) == 0);
+    }
+
+    // A name taken already fails its group
+    char* again[] = { "/p/a" };
+    CHECK(sfs_create_batch(again, 1, 0) < 0);
+
+    int fd = sfs_open("/p/q/c");
+    CHECK(sfs_pwrite(fd, 0, 5, "hello") == 1);
+    CHECK(sfs_close(fd) == 1);
+
+    // A directory goes in the same batch as its contents
+    char* gone[] = { "/p/q", "/p/q/c", "/p/a", "/e" };
+    CHECK(sfs_delete_batch(gone, 4) == 1);
+
+    for (int k = 0; k < 4; k++) {
+        CHECK(sfs_gettype(gone[k]) < 0);
+    }
+
+    CHECK(sfs_gettype("/p/b") == 0);
+    CHECK(sfs_gettype("/r/d") == 0);
+}
+
+/* a file is placed in its parent's block group, and its chain in one run */
+void test_locality() {
+    char data[MAX_IO_LENGTH];
+    int chain[BLOCKS];
+
+    fill_pattern(data, sizeof data, 23);
+
+    CHECK(sfs_create("/a", 1) == 1);
+    CHECK(sfs_create("/a/big", 0) == 1);
+    int fd = sfs_open("/a/big");
+
+    // Push the next free block well past the first group
+    for (int k = 0; k < 4; k++) {
+        CHECK(sfs_pwrite(fd, k * MAX_IO_LENGTH, MAX_IO_LENGTH, data) == 1);
+    }
+
+    CHECK(sfs_close(fd) == 1);
+
+    int count = chain_of("/a/big", chain);
+    CHECK(count == (4 * MAX_IO_LENGTH + DATA_SIZE - 1) / DATA_SIZE);
+
+    for (int k = 1; k < count; k++) {
+        CHECK(chain[k] == chain[k - 1] + 1);
+    }
+
+    CHECK(sfs_create("/b", 1) == 1);
+    CHECK(sfs_create("/b/f", 0) == 1);
+    fd = sfs_open("/b/f");
+    CHECK(sfs_pwrite(fd, 0, 300, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+
+    int parent = block_of("/b");
+    count = chain_of("/b/f", chain);
+    CHECK(count == 3);
+
+    for (int k = 0; k < count; k++) {
+        CHECK(chain[k] / BLOCK_GROUP == parent / BLOCK_GROUP);
+    }
+}
+
+/* sfs_fallocate extends a file with zeros in one run, and never shrinks it */
+void test_fallocate() {
+    char data[300];
+    char back[600];
+    int chain[BLOCKS];
+
+    fill_pattern(data, sizeof data, 29);
+
+    CHECK(sfs_create("/f", 0) == 1);
+    int fd = sfs_open("/f");
+    CHECK(sfs_pwrite(fd, 0, 100, data) == 1);
+
+    CHECK(sfs_fallocate(fd, 0, 600) == 1);
+    CHECK(sfs_getsize("/f") == 600);
+
+    int count = chain_of("/f", chain);
+    CHECK(count == (600 + DATA_SIZE - 1) / DATA_SIZE);
+
+    for (int k = 1; k < count; k++) {
+        CHECK(chain[k] == chain[k - 1] + 1);
+    }
+
+    CHECK(sfs_pread(fd, 0, 600, back) == 1);
+    CHECK(memcmp(data, back, 100) == 0);
+
+    for (int k = 100; k < 600; k++) {
+        CHECK(back[k] == '\0');
+    }
+
+    // A range already inside the file changes nothing
+    CHECK(sfs_fallocate(fd, 100, 200) == 1);
+    CHECK(sfs_getsize("/f") == 600);
+
+    // Ranges and sizes past the largest file are refused, and change nothing either
+    CHECK(sfs_fallocate(fd, SIZE_MAX - 5, 10) < 0);
+    CHECK(sfs_fallocate(fd, 0, MAX_FILE_SIZE + 1) < 0);
+    CHECK(sfs_truncate(fd, SIZE_MAX) < 0);
+    CHECK(sfs_getsize("/f") == 600);
+    CHECK(chain_of("/f", chain) == count);
+
+    // Writes into the range fill the blocks reserved for them
+    CHECK(sfs_pwrite(fd, 200, 300, data) == 1);
+    CHECK(sfs_getsize("/f") == 600);
+    CHECK(chain_of("/f", chain) == count);
+    CHECK(sfs_pread(fd, 200, 300, back) == 1);
+    CHECK(memcmp(data, back, 300) == 0);
+
+    CHECK(sfs_fallocate(fd, 500, 300) == 1);
+    CHECK(sfs_getsize("/f") == 800);
+    CHECK(sfs_close(fd) == 1);
+}
+
+/* sfs_truncate shrinks a file to its new last block, or grows it with zeros */
+void test_truncate() {
+    char data[600];
+    char back[600];
+    int chain[BLOCKS];
+    struct sfs_fsck full;
+    struct sfs_fsck cut;
+
+    fill_pattern(data, sizeof data, 31);
+
+    CHECK(sfs_create("/f", 0) == 1);
+    int fd = sfs_open("/f");
+    CHECK(sfs_pwrite(fd, 0, 600, data) == 1);
+    CHECK(sfs_fsck(0, &full) == 1);
+
+    CHECK(sfs_truncate(fd, 250) == 1);
+    CHECK(sfs_getsize("/f") == 250);
+    CHECK(chain_of("/f", chain) == 3);
+    CHECK(sfs_fsck(0, &cut) == 1);
+    CHECK(cut.reachable == full.reachable - 2);
+    CHECK(sfs_pread(fd, 0, 250, back) == 1);
+    CHECK(memcmp(data, back, 250) == 0);
+    CHECK(sfs_pread(fd, 0, 251, back) < 0);
+
+    // Growing again reads zeros, not the bytes cut off
+    CHECK(sfs_truncate(fd, 400) == 1);
+    CHECK(sfs_getsize("/f") == 400);
+    CHECK(sfs_pread(fd, 0, 400, back) == 1);
+    CHECK(memcmp(data, back, 250) == 0);
+
+    for (int k = 250; k < 400; k++) {
+        CHECK(back[k] == '\0');
+    }
+
+    // A block boundary, and nothing at all
+    CHECK(sfs_truncate(fd, 2 * DATA_SIZE) == 1);
+    CHECK(sfs_getsize("/f") == 2 * DATA_SIZE);
+    CHECK(chain_of("/f", chain) == 2);
+    CHECK(sfs_truncate(fd, 0) == 1);
+    CHECK(sfs_getsize("/f") == 0);
+    CHECK(sfs_pread(fd, 0, 1, back) < 0);
+    CHECK(sfs_close(fd) == 1);
+
+    // A file stored inline
+    CHECK(sfs_create("/s", 0) == 1);
+    fd = sfs_open("/s");
+    CHECK(sfs_pwrite(fd, 0, 20, data) == 1);
+    CHECK(sfs_truncate(fd, 5) == 1);
+    CHECK(sfs_getsize("/s") == 5);
+    CHECK(sfs_pread(fd, 0, 5, back) == 1);
+    CHECK(memcmp(data, back, 5) == 0);
+    CHECK(sfs_truncate(fd, 100) == 1);
+    CHECK(sfs_getsize("/s") == 100);
+    CHECK(sfs_close(fd) == 1);
+}
+
+/* a deleted file's chain waits in the orphan list until it is reclaimed */
+void test_reclaim() {
+    char data[MAX_IO_LENGTH];
+    struct sfs_fsck empty;
+    struct sfs_fsck pending;
+    struct sfs_fsck after;
+
+    fill_pattern(data, sizeof data, 37);
+
+    CHECK(sfs_fsck(0, &empty) == 1);
+    CHECK(sfs_create("/f", 0) == 1);
+    int fd = sfs_open("/f");
+    CHECK(sfs_pwrite(fd, 0, MAX_IO_LENGTH, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+
+    int blocks = (MAX_IO_LENGTH + DATA_SIZE - 1) / DATA_SIZE;
+
+    // The chain is still in use, reached from the orphan list
+    CHECK(sfs_delete("/f") == 1);
+    CHECK(sfs_gettype("/f") < 0);
+    CHECK(sfs_fsck(0, &pending) == 1);
+    CHECK(pending.reachable == empty.reachable + blocks);
+    check_clean();
+
+    CHECK(sfs_reclaim(1) >= 1);
+    CHECK(sfs_reclaim(0) >= 0);
+    CHECK(sfs_reclaim(0) == 0);
+    CHECK(sfs_fsck(0, &after) == 1);
+    CHECK(after.reachable == empty.reachable);
+
+    // Mounting finishes the reclamation left over
+    CHECK(sfs_create("/g", 0) == 1);
+    fd = sfs_open("/g");
+    CHECK(sfs_pwrite(fd, 0, MAX_IO_LENGTH, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+    CHECK(sfs_delete("/g") == 1);
+    CHECK(sfs_initialize(0) == 1);
+    CHECK(sfs_fsck(0, &after) == 1);
+    CHECK(after.reachable == empty.reachable);
+}
+
+/* erasing writes only the reserved blocks, and the whole disk stays usable */
+void test_format() {
+    char data[MAX_IO_LENGTH];
+    char back[MAX_IO_LENGTH];
+    struct sfs_fsck report;
+
+    fill_pattern(data, sizeof data, 41);
+
+    CHECK(sfs_fsck(0, &report) == 1);
+    CHECK(report.blocks == BLOCKS);
+    CHECK(report.reachable == RESERVED_BLOCKS);
+    CHECK(sfs_gettype("/") == 1);
+
+    // Fill the disk, so every block is handed out once
+    CHECK(sfs_create("/f", 0) == 1);
+    int fd = sfs_open("/f");
+    int written = 0;
+
+    while (written < BLOCKS * DATA_SIZE && sfs_pwrite(fd, written, MAX_IO_LENGTH, data) == 1) {
+        written += MAX_IO_LENGTH;
+    }
+
+    CHECK(written > (BLOCKS - 2 * BLOCK_GROUP) * DATA_SIZE);
+    CHECK(sfs_pread(fd, written - MAX_IO_LENGTH, MAX_IO_LENGTH, back) == 1);
+    CHECK(memcmp(data, back, MAX_IO_LENGTH) == 0);
+    CHECK(sfs_close(fd) == 1);
+    check_clean();
+
+    // The write that ran out of blocks changed nothing
+    CHECK(sfs_getsize("/f") == written);
+
+    // A disk initialized without erasing keeps its files
+    CHECK(sfs_initialize(0) == 1);
+    CHECK(sfs_getsize("/f") == written);
+
+    // Erasing forgets them, whatever was on the blocks, and writes a handful of blocks
+    static struct sfs_stats stats;
+    CHECK(sfs_stats(&stats, 1) == 1);
+    CHECK(sfs_initialize(1) == 1);
+    CHECK(sfs_stats(&stats, 0) == 1);
+
+    for (int op = 0; op < SFS_OPS; op++) {
+        if (strcmp(stats.ops[op].name, "initialize") == 0) {
+            CHECK(stats.ops[op].calls == 1);
+            CHECK(stats.ops[op].blockWrites < 2 * RESERVED_BLOCKS);
+        }
+    }
+
+    CHECK(sfs_gettype("/f") < 0);
+    CHECK(sfs_fsck(0, &report) == 1);
+    CHECK(report.reachable == RESERVED_BLOCKS);
+
+    CHECK(sfs_create("/g", 0) == 1);
+    fd = sfs_open("/g");
+    CHECK(sfs_pwrite(fd, 0, MAX_IO_LENGTH, data) == 1);
+    CHECK(sfs_pread(fd, 0, MAX_IO_LENGTH, back) == 1);
+    CHECK(memcmp(data, back, MAX_IO_LENGTH) == 0);
+    CHECK(sfs_close(fd) == 1);
+}
+
+/* preloaded directories serve lookups from memory and see every change */
+void test_preload() {
+    static struct sfs_stats stats;
+
+    CHECK(sfs_create("/d", 1) == 1);
+    CHECK(sfs_create("/d/e", 1) == 1);
+    CHECK(sfs_create("/d/e/f", 0) == 1);
+
+    CHECK(sfs_preload(1) == 1);
+    CHECK(sfs_stats(&stats, 1) == 1);
+    CHECK(sfs_gettype("/d/e/f") == 0);
+    CHECK(sfs_stats(&stats, 0) == 1);
+
+    for (int op = 0; op < SFS_OPS; op++) {
+        if (strcmp(stats.ops[op].name, "gettype") == 0) {
+            CHECK(stats.ops[op].cacheHits >= 3);
+            CHECK(stats.ops[op].cacheMisses == 0);
+        }
+    }
+
+    // Changes are written through, to memory and disk alike
+    CHECK(sfs_create("/d/g", 0) == 1);
+    CHECK(sfs_rename("/d/e/f", "/h") == 1);
+    CHECK(sfs_delete("/d/e") == 1);
+    CHECK(sfs_gettype("/d/g") == 0);
+    CHECK(sfs_gettype("/h") == 0);
+    CHECK(sfs_gettype("/d/e") < 0);
+
+    CHECK(sfs_preload(0) == 1);
+    CHECK(sfs_gettype("/d/g") == 0);
+    CHECK(sfs_gettype("/h") == 0);
+    CHECK(sfs_gettype("/d/e") < 0);
+
+    // The tree is read again whenever a tree is mounted
+    CHECK(sfs_preload(1) == 1);
+    CHECK(sfs_initialize(0) == 1);
+    CHECK(sfs_gettype("/d/g") == 0);
+    CHECK(sfs_snapshot("snap") == 1);
+    CHECK(sfs_delete("/d/g") == 1);
+    CHECK(sfs_mount("snap") == 1);
+    CHECK(sfs_gettype("/d/g") == 0);
+    CHECK(sfs_mount(NULL) == 1);
+    CHECK(sfs_gettype("/d/g") < 0);
+    CHECK(sfs_preload(0) == 1);
+}
+
+/* a sealed disk resolves paths through its index, and takes no writes */
+void test_seal() {
+    char back[300];
+    char data[300];
+
+    fill_pattern(data, sizeof data, 43);
+
+    CHECK(sfs_create("/d", 1) == 1);
+    CHECK(sfs_create("/d/f", 0) == 1);
+    CHECK(sfs_create("/d/s", 0) == 1);
+    int fd = sfs_open("/d/f");
+    CHECK(sfs_pwrite(fd, 0, 300, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+    fd = sfs_open("/d/s");
+    CHECK(sfs_pwrite(fd, 0, 3, "abc") == 1);
+    CHECK(sfs_close(fd) == 1);
+
+    CHECK(sfs_seal() == 1);
+    CHECK(sfs_seal() < 0);
+
+    CHECK(sfs_gettype("/") == 1);
+    CHECK(sfs_gettype("/d") == 1);
+    CHECK(sfs_gettype("/d/f") == 0);
+    CHECK(sfs_getsize("/d/f") == 300);
+    CHECK(sfs_getsize("/d/s") == 3);
+    CHECK(sfs_gettype("/d/x") < 0);
+    CHECK(sfs_gettype("/x/f") < 0);
+
+    fd = sfs_open("/d/f");
+    CHECK(fd >= 0);
+    CHECK(sfs_pread(fd, 0, 300, back) == 1);
+    CHECK(memcmp(data, back, 300) == 0);
+    CHECK(sfs_pwrite(fd, 0, 3, "xyz") < 0);
+    CHECK(sfs_truncate(fd, 0) < 0);
+    CHECK(sfs_close(fd) == 1);
+
+    CHECK(sfs_create("/g", 0) < 0);
+    CHECK(sfs_delete("/d/f") < 0);
+    CHECK(sfs_rename("/d/f", "/f") < 0);
+    CHECK(sfs_snapshot("snap") < 0);
+
+    // The seal outlives a mount, and only erasing lifts it
+    CHECK(sfs_initialize(0) == 1);
+    CHECK(sfs_create("/g", 0) < 0);
+    CHECK(sfs_getsize("/d/f") == 300);
+    CHECK(sfs_initialize(1) == 1);
+    CHECK(sfs_create("/g", 0) == 1);
+}
+
+/* names sharing a prefix are told apart, with and without the lanes of a cached fcb */
+void test_lanes() {
+    char* names[] = { "/a", "/ab", "/abc", "/abcd", "/abcde", "/abcdef", "/b", "/ba" };
+    int count = sizeof names / sizeof names[0];
+
+    for (int cached = 0; cached <= 1; cached++) {
+        CHECK(sfs_initialize(1) == 1);
+        CHECK(sfs_preload(cached) == 1);
+
+        for (int i = 0; i < count; i++) {
+            CHECK(sfs_create(names[i], i % 2) == 1);
+        }
+
+        for (int i = 0; i < count; i++) {
+            CHECK(sfs_gettype(names[i]) == i % 2);
+        }
+
+        CHECK(sfs_gettype("/abcdeg") < 0);
+        CHECK(sfs_gettype("/c") < 0);
+
+        // Lanes follow the fcb as slots are emptied and names change
+        CHECK(sfs_delete("/abc") == 1);
+        CHECK(sfs_gettype("/abc") < 0);
+        CHECK(sfs_gettype("/abcd") == 1);
+        CHECK(sfs_gettype("/ab") == 1);
+
+        CHECK(sfs_rename("/ab", "/abx") == 1);
+        CHECK(sfs_gettype("/ab") < 0);
+        CHECK(sfs_gettype("/abx") == 1);
+        CHECK(sfs_gettype("/a") == 0);
+
+        CHECK(sfs_create("/abc", 0) == 1);
+        CHECK(sfs_gettype("/abc") == 0);
+
+        // A full directory is searched to its last slot, and takes no more entries
+        char path[16];
+
+        CHECK(sfs_create("/d", 1) == 1);
+
+        for (int i = 0; i < ENTRY_SLOTS; i++) {
+            sprintf(path, "/d/f%d", i);
+            CHECK(sfs_create(path, i % 2) == 1);
+        }
+
+        CHECK(sfs_create("/d/g", 0) < 0);
+
+        for (int i = 0; i < ENTRY_SLOTS; i++) {
+            sprintf(path, "/d/f%d", i);
+            CHECK(sfs_gettype(path) == i % 2);
+        }
+
+        CHECK(sfs_gettype("/d/g") < 0);
+
+        CHECK(sfs_preload(0) == 1);
+        check_clean();
+    }
+}
+
+/* every public operation is counted once, with its errors, block I/O and latencies */
+void test_stats() {
+    static struct sfs_stats stats;
+    char data[300];
+    char back[300];
+
+    fill_pattern(data, sizeof data, 47);
+
+    CHECK(sfs_stats(NULL, 1) == 1);
+    CHECK(sfs_create("/f", 0) == 1);
+    CHECK(sfs_create("/f", 0) < 0);
+    CHECK(sfs_create("/x/f", 0) < 0);
+
+    int fd = sfs_open("/f");
+    CHECK(sfs_pwrite(fd, 0, 300, data) == 1);
+
+    for (int i = 0; i < 10; i++) {
+        CHECK(sfs_pread(fd, 0, 300, back) == 1);
+    }
+
+    CHECK(sfs_close(fd) == 1);
+    CHECK(sfs_stats(&stats, 0) == 1);
+
+    struct sfs_opstats* create = &stats.ops[OP_CREATE];
+    struct sfs_opstats* pwrite = &stats.ops[OP_PWRITE];
+    struct sfs_opstats* pread = &stats.ops[OP_PREAD];
+
+    CHECK(!strcmp(create->name, "create"));
+    CHECK(!strcmp(stats.ops[OP_DELETE_SNAPSHOT].name, "delete_snapshot"));
+    CHECK(create->calls == 3 && create->errors == 2);
+    CHECK(stats.ops[OP_OPEN].calls == 1 && stats.ops[OP_CLOSE].calls == 1);
+    CHECK(pwrite->calls == 1 && pwrite->errors == 0);
+    CHECK(pwrite->blockWrites >= 3 && pwrite->allocations > 0);
+    CHECK(pread->calls == 10 && pread->blockWrites == 0);
+
+    // Calls made from inside sfs_pwrite are not counted as calls of their own
+    CHECK(stats.ops[OP_GETSIZE].calls == 0 && stats.ops[OP_GETTYPE].calls == 0);
+
+    // Percentiles rise with the fraction, and never pass the slowest call
+    unsigned long p0 = sfs_percentile(pread, 0);
+    unsigned long p50 = sfs_percentile(pread, 0.5);
+    unsigned long p100 = sfs_percentile(pread, 1);
+
+    CHECK(p0 <= p50 && p50 <= p100 && p100 <= pread->maxTime);
+    CHECK(pread->maxTime <= pread->totalTime);
+    CHECK(sfs_percentile(&stats.ops[OP_DEFRAG], 0.5) == 0);
+
+    // Resetting clears the counters after copying them
+    CHECK(sfs_stats(&stats, 1) == 1);
+    CHECK(stats.ops[OP_PREAD].calls == 10);
+    CHECK(sfs_stats(&stats, 0) == 1);
+    CHECK(stats.ops[OP_PREAD].calls == 0);
+}
+
+/* the spans traced are exported as Chrome trace events, when tracing is compiled in */
+void test_trace() {
+    char text[4096];
+
+    CHECK(sfs_create("/f", 0) == 1);
+
+#ifdef SFS_TRACE
+    CHECK(sfs_trace("sfstest.trace") == 1);
+
+    CHECK(read_file("sfstest.trace", text, sizeof text) > 0);
+    CHECK(!strncmp(text, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [", 42));
+    CHECK(strstr(text, "\"ph\": \"X\"") != NULL);
+    CHECK(strstr(text, "\"name\": \"") != NULL);
+
+    remove("sfstest.trace");
+    CHECK(sfs_trace("/nonexistent/sfstest.trace") == -2);
+#else
+    CHECK(sfs_trace("sfstest.trace") == -1);
+    CHECK(read_file("sfstest.trace", text, sizeof text) == -1);
+#endif
+}
+
+/* the modelled disk charges latency, seek distance and transfer time to a simulated clock */
+void test_disk_model() {
+    char block[BLOCK_SIZE];
+    char run[4 * BLOCK_SIZE];
+
+    CHECK(set_disk_model(-1, 0, 0, 1, 0) == -1);
+    CHECK(set_disk_model(0, 0, 0, 0, 0) == -1);
+
+    // 1000 ns per request and 10 ns per block of travel
+    CHECK(set_disk_model(1000, 10, 0, 1, 0) == 0);
+    CHECK(disk_clock() == 0 && disk_travel() == 0);
+
+    CHECK(get_block(100, block) == 0);
+    CHECK(disk_head() == 101);
+
+    long clock = disk_clock();
+    long travel = disk_travel();
+
+    // The next block is under the head, and costs no seek
+    CHECK(get_block(101, block) == 0);
+    CHECK(disk_clock() == clock + 1000);
+    CHECK(disk_travel() == travel);
+
+    CHECK(get_block(51, block) == 0);
+    CHECK(disk_clock() == clock + 2000 + 10 * 51);
+    CHECK(disk_travel() == travel + 51);
+
+    // A run pays one latency and one seek, and 1000 ns per block at 128 MB/s
+    CHECK(set_disk_model(1000, 10, BLOCK_SIZE * 1000000L, 1, 0) == 0);
+    CHECK(get_run(52, 4, run) == 0);
+    CHECK(disk_clock() == 1000 + 4 * 1000);
+    CHECK(disk_head() == 56);
+
+    // Plugged requests share one latency per queue depth of them
+    CHECK(set_disk_model(1000, 0, 0, 4, 0) == 0);
+    plug_disk();
+
+    for (int i = 0; i < 8; i++) {
+        CHECK(get_block(i, block) == 0);
+    }
+
+    unplug_disk();
+    CHECK(disk_clock() == 2 * 1000);
+
+    CHECK(set_disk_model(0, 0, 0, 1, 0) == 0);
+}
+
+/* a batch ends as if its requests ran in order, with fewer requests reaching the disk */
+void test_scheduler() {
+    char saved[3][BLOCK_SIZE];
+    char a[BLOCK_SIZE];
+    char b[BLOCK_SIZE];
+    char c[BLOCK_SIZE];
+    char reads[3][BLOCK_SIZE];
+    char back[BLOCK_SIZE];
+
+    // Blocks at the end of a fresh disk are free, and are put back as they were
+    for (int i = 0; i < 3; i++) {
+        CHECK(get_block(BLOCKS - 3 + i, saved[i]) == 0);
+    }
+
+    fill_pattern(a, BLOCK_SIZE, 53);
+    fill_pattern(b, BLOCK_SIZE, 59);
+    fill_pattern(c, BLOCK_SIZE, 61);
+
+    struct request batch[] = {
+        { BLOCKS - 2, READ_REQUEST, reads[0] },
+        { BLOCKS - 3, WRITE_REQUEST, a },
+        { BLOCKS - 3, READ_REQUEST, reads[1] },
+        { BLOCKS - 2, WRITE_REQUEST, b },
+        { BLOCKS - 2, WRITE_REQUEST, c },
+        { BLOCKS - 1, READ_REQUEST, reads[2] },
+    };
+
+    // With no seek cost, the clock counts the requests the disk sees
+    CHECK(set_disk_model(1000, 0, 0, 1, 0) == 0);
+    CHECK(submitBatch(batch, 6) == 0);
+    CHECK(disk_clock() == 4 * 1000);
+
+    CHECK(memcmp(reads[0], saved[1], BLOCK_SIZE) == 0);
+    CHECK(memcmp(reads[1], a, BLOCK_SIZE) == 0);
+    CHECK(memcmp(reads[2], saved[2], BLOCK_SIZE) == 0);
+
+    CHECK(get_block(BLOCKS - 3, back) == 0);
+    CHECK(memcmp(back, a, BLOCK_SIZE) == 0);
+    CHECK(get_block(BLOCKS - 2, back) == 0);
+    CHECK(memcmp(back, c, BLOCK_SIZE) == 0);
+
+    struct request invalid[] = { { BLOCKS, READ_REQUEST, back } };
+    CHECK(submitBatch(invalid, 1) == -1);
+    CHECK(submitBatch(NULL, 0) == 0);
+
+    CHECK(set_disk_model(0, 0, 0, 1, 0) == 0);
+
+    for (int i = 0; i < 3; i++) {
+        CHECK(put_block(BLOCKS - 3 + i, saved[i]) == 0);
+    }
+}
+
+/* sequential reads of a chain read ahead, and still return the right data */
+void test_readahead() {
+    static char data[32 * DATA_SIZE];
+    char back[DATA_SIZE];
+
+    fill_pattern(data, sizeof data, 67);
+
+    CHECK(sfs_create("/f", 0) == 1);
+    int fd = sfs_open("/f");
+    CHECK(sfs_pwrite(fd, 0, sizeof data, data) == 1);
+
+    // With no seek cost, the clock counts the requests that reach the disk
+    long requests[2];
+
+    for (int sequential = 1; sequential >= 0; sequential--) {
+        clearCache();
+        CHECK(set_disk_model(1000, 0, 0, 1, 0) == 0);
+
+        for (int i = 0; i < 32; i++) {
+            // Striding seven blocks at a time ends every stream at once
+            int chunk = sequential ? i : (i * 7) % 32;
+
+            CHECK(sfs_pread(fd, (size_t) chunk * DATA_SIZE, DATA_SIZE, back) == 1);
+            CHECK(memcmp(back, &data[chunk * DATA_SIZE], DATA_SIZE) == 0);
+        }
+
+        requests[sequential] = disk_clock() / 1000;
+    }
+
+    CHECK(requests[1] < requests[0]);
+    CHECK(requests[1] < 32);
+
+    // A stream that is cut short reads what was asked for, and nothing past the file
+    clearCache();
+    CHECK(sfs_pread(fd, 0, DATA_SIZE, back) == 1);
+    CHECK(sfs_pread(fd, DATA_SIZE, DATA_SIZE, back) == 1);
+    CHECK(sfs_pread(fd, sizeof data - 10, 10, back) == 1);
+    CHECK(memcmp(back, &data[sizeof data - 10], 10) == 0);
+    CHECK(sfs_pread(fd, sizeof data - 10, 11, back) < 0);
+
+    CHECK(set_disk_model(0, 0, 0, 1, 0) == 0);
+    CHECK(sfs_close(fd) == 1);
+}
+
+/* the hot blocks saved on shutdown serve the first reads after the next mount */
+void test_warmup() {
+    static struct sfs_stats stats;
+    char data[5 * DATA_SIZE];
+    char back[5 * DATA_SIZE];
+    char text[4096];
+
+    fill_pattern(data, sizeof data, 71);
+
+    CHECK(sfs_create("/d", 1) == 1);
+    CHECK(sfs_create("/d/f", 0) == 1);
+    int fd = sfs_open("/d/f");
+    CHECK(sfs_pwrite(fd, 0, sizeof data, data) == 1);
+    CHECK(sfs_pread(fd, 0, sizeof data, back) == 1);
+
+    // Reads after a mount cost block reads with warm-up off, and none with it on
+    for (int warm = 0; warm <= 1; warm++) {
+        CHECK(sfs_warmup(warm) == 1);
+        CHECK(sfs_shutdown() == 1);
+        CHECK((read_file(HOT_FILE, text, sizeof text) >= 0) == warm);
+        CHECK(sfs_initialize(0) == 1);
+
+        CHECK(sfs_stats(NULL, 1) == 1);
+        fd = sfs_open("/d/f");
+        CHECK(sfs_pread(fd, 0, sizeof data, back) == 1);
+        CHECK(memcmp(data, back, sizeof data) == 0);
+        CHECK(sfs_stats(&stats, 0) == 1);
+        CHECK((stats.ops[OP_PREAD].blockReads == 0) == warm);
+        CHECK(sfs_close(fd) == 1);
+
+        remove(HOT_FILE);
+    }
+
+    // A side file naming blocks off the disk is ignored
+    sprintf(text, "%d\n", BLOCKS + 1);
+    CHECK(write_file(HOT_FILE, text) == 0);
+
+    CHECK(sfs_initialize(0) == 1);
+    CHECK(sfs_getsize("/d/f") == (int) sizeof data);
+
+    // Erasing the disk drops the side file with it
+    CHECK(sfs_initialize(1) == 1);
+    CHECK(read_file(HOT_FILE, text, sizeof text) == -1);
+
+    CHECK(sfs_warmup(0) == 1);
+}
+
+/* defragmenting lays every chain out contiguously, leaving the data and open files as they were */
+void test_defrag() {
+    static char data[2][8 * DATA_SIZE];
+    char back[8 * DATA_SIZE];
+    int chain[BLOCKS];
+    double before;
+    double after;
+
+    fill_pattern(data[0], sizeof data[0], 73);
+    fill_pattern(data[1], sizeof data[1], 79);
+
+    // Two files grown a block at a time in turn end up interleaved
+    CHECK(sfs_create("/d", 1) == 1);
+    CHECK(sfs_create("/d/a", 0) == 1);
+    CHECK(sfs_create("/b", 0) == 1);
+    int fds[2] = { sfs_open("/d/a"), sfs_open("/b") };
+
+    for (int i = 0; i < 8; i++) {
+        for (int f = 0; f < 2; f++) {
+            CHECK(sfs_pwrite(fds[f], (size_t) i * DATA_SIZE, DATA_SIZE, &data[f][i * DATA_SIZE]) == 1);
+        }
+    }
+
+    CHECK(sfs_defrag(1, &before, &after) == 1);
+    CHECK(before > 0);
+    CHECK(after == 0);
+
+    const char* paths[2] = { "/d/a", "/b" };
+
+    for (int f = 0; f < 2; f++) {
+        int length = chain_of(paths[f], chain);
+        CHECK(length == 8);
+
+        for (int i = 1; i < length; i++) {
+            CHECK(chain[i] == chain[i - 1] + 1);
+        }
+
+        // The open file follows its chain, and so does a fresh one
+        CHECK(sfs_pread(fds[f], 0, sizeof back, back) == 1);
+        CHECK(memcmp(back, data[f], sizeof back) == 0);
+        CHECK(sfs_close(fds[f]) == 1);
+
+        int fd = sfs_open((char*) paths[f]);
+        CHECK(sfs_pread(fd, 0, sizeof back, back) == 1);
+        CHECK(memcmp(back, data[f], sizeof back) == 0);
+        CHECK(sfs_close(fd) == 1);
+    }
+
+    // The chains are already contiguous, and a snapshot is never rewritten
+    CHECK(sfs_defrag(0, &before, &after) == 1);
+    CHECK(before == 0 && after == 0);
+    CHECK(sfs_snapshot("snap") == 1);
+    CHECK(sfs_mount("snap") == 1);
+    CHECK(sfs_defrag(0, NULL, NULL) == -1);
+    CHECK(sfs_mount(NULL) == 1);
+}
+
+/* fsck finds leaked blocks, excess reference counts and dangling pointers, and repairs them */
+void test_fsck() {
+    char data[3 * DATA_SIZE];
+    char back[DATA_SIZE];
+    char block[BLOCK_SIZE];
+    int chain[BLOCKS];
+    struct sfs_fsck report;
+
+    fill_pattern(data, sizeof data, 83);
+
+    CHECK(sfs_create("/f", 0) == 1);
+    int fd = sfs_open("/f");
+    CHECK(sfs_pwrite(fd, 0, sizeof data, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+    CHECK(chain_of("/f", chain) == 3);
+
+    // Freeing a file leaves formatted blocks free
+    CHECK(sfs_create("/g", 0) == 1);
+    fd = sfs_open("/g");
+    CHECK(sfs_pwrite(fd, 0, sizeof data, data) == 1);
+    CHECK(sfs_close(fd) == 1);
+    CHECK(sfs_delete("/g") == 1);
+    CHECK(sfs_reclaim(BLOCKS) >= 0);
+
+    CHECK(sfs_fsck(1, &report) == 1);
+    CHECK(report.repaired == 0 && report.reachable > 0);
+
+    // A copy of a file block that nothing points at is leaked. Blocks never formatted
+    // count as free whatever they hold, so the copy goes to one of the blocks of /g
+    int spare = -1;
+
+    for (int blockID = 0; blockID < BLOCKS && spare < 0; blockID++) {
+        if (isFormatted(blockID) && get_block(blockID, block) == 0 && block[BLOCK_START] == FREE) {
+            spare = blockID;
+        }
+    }
+
+    CHECK(spare >= 0);
+    CHECK(get_block(chain[0], block) == 0);
+    CHECK(put_block(spare, block) == 0);
+
+    // A block counting more references than point at it is leaked as well
+    CHECK(get_block(chain[1], block) == 0);
+    block[REFS_P] = 3;
+    CHECK(put_block(chain[1], block) == 0);
+
+    // The last block of the chain points at a block never formatted
+    CHECK(get_block(chain[2], block) == 0);
+    char* next = encode_int(BLOCKS - 1);
+    block[NEXT_BLOCK] = next[0];
+    block[NEXT_BLOCK + 1] = next[1];
+    free(next);
+    CHECK(put_block(chain[2], block) == 0);
+
+    CHECK(sfs_fsck(0, &report) == 1);
+    CHECK(report.leaked == 2);
+    CHECK(report.dangling == 1);
+    CHECK(report.repaired == 0);
+
+    CHECK(sfs_fsck(1, &report) == 1);
+    CHECK(report.repaired == 3);
+
+    CHECK(get_block(spare, block) == 0);
+    CHECK(block[BLOCK_START] == FREE);
+    CHECK(get_block(chain[1], block) == 0);
+    CHECK(block[REFS_P] == 1);
+
+    // The file keeps its three blocks and its data
+    CHECK(chain_of("/f", chain) == 3);
+    fd = sfs_open("/f");
+    CHECK(sfs_pread(fd, 2 * DATA_SIZE, DATA_SIZE, back) == 1);
+    CHECK(memcmp(back, &data[2 * DATA_SIZE], DATA_SIZE) == 0);
+    CHECK(sfs_close(fd) == 1);
+}
+
+struct scenario {
+    const char* name;
+    void (*run)();
+};
+
+struct scenario scenarios[] = {
+    { "pread", test_pread },
+    { "writev", test_writev },
+    { "rename and copy_range", test_rename_copy },
+    { "snapshot", test_snapshot },
+    { "snapshot delete", test_snapshot_delete },
+    { "dedup", test_dedup },
+    { "inline", test_inline },
+    { "batch", test_batch },
+    { "locality", test_locality },
+    { "fallocate", test_fallocate },
+    { "truncate", test_truncate },
+    { "reclaim", test_reclaim },
+    { "lazy format", test_format },
+    { "preload", test_preload },
+    { "seal", test_seal },
+    { "lanes", test_lanes },
+    { "stats", test_stats },
+    { "trace", test_trace },
+    { "disk_model", test_disk_model },
+    { "scheduler", test_scheduler },
+    { "readahead", test_readahead },
+    { "warmup", test_warmup },
+    { "defrag", test_defrag },
+    { "fsck", test_fsck },
+};
+
+/* runs every scenario, returning the number of scenarios that failed */
+int run_tests() {
+    int failed = 0;
+    int count = sizeof scenarios / sizeof scenarios[0];
+
+    for (int k = 0; k < count; k++) {
+        failures = 0;
+
+        CHECK(sfs_initialize(1) == 1);
+        scenarios[k].run();
+        check_clean();
+
+        printf("%s %s\n", failures ? "FAIL" : "ok  ", scenarios[k].name);
+
+        if (failures) {
+            failed++;
+        }
+    }
+
+    printf("%d of %d scenarios passed\n", count - failed, count);
+    return failed;
+}
+
 /*****************************************************
  main test routine
  ******************************************************/
 
-int main() {
+int main(int argc, char* argv[]) {
     int i;
     int retval; /* used to hold return values of file system calls */
 
     // Run constructor for table
     openTable.length = 0;
 
+    if (argc > 1 && strcmp(argv[1], "-t") == 0) {
+        return run_tests() ? 1 : 0;
+    }
+
     /* do forever:
      1) print a list of available commands
      2) read a command
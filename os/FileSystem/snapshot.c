@@ -0,0 +1,468 @@
+/*
+ * snapshot.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "dirTree.h"
+#include "entry.h"
+#include "fControl.h"
+#include "openFiles.h"
+#include "pathUtils.h"
+#include "seal.h"
+#include "snapshot.h"
+#include "storeInt.h"
+#include "superblock.h"
+
+/*
+ * The snapshot table is laid out like a file control block:
+ *
+ *      type    entries ...                                     generation
+ *      META    DIRECTORY, name, root of the frozen tree ...    current generation
+ *
+ * Every block records the generation it was written in at GEN_P.
+ * Taking a snapshot copies the root directory, stamped with the current generation,
+ * and bumps the generation, so every block written before it is shared with the snapshot.
+ * A shared block is never modified or freed: writers copy it first.
+ *
+ * A block of the live tree written no later than the newest snapshot is part of that
+ * snapshot, so the generation of the newest snapshot left is all it takes to tell which
+ * blocks are shared. Deleting a snapshot lowers it, and blocks only the deleted snapshot
+ * held are freed by a sweep of the disk. Generations are a byte wide: once the table is
+ * empty every block is restamped with FIRST_GENERATION and counting starts over, but at
+ * most MAX_GENERATION - FIRST_GENERATION snapshots can be taken in between.
+ */
+
+// The current generation
+static int generation = FIRST_GENERATION;
+
+// The generation of the newest snapshot, or 0 when there is none
+static int horizon = 0;
+
+// The root directory of the mounted tree
+static int root = ROOT_BLOCKID;
+
+/*
+ * saveGeneration: Stores the current generation in the snapshot table.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the snapshot table
+ * return -2:       error creating the snapshot table
+ */
+static int saveGeneration() {
+    char block[BLOCK_SIZE];
+
+    if (get_block(SNAPSHOT_BLOCKID, block)) {
+        fprintf(stderr, "Error retrieving the snapshot table.\n");
+        return -1;
+    }
+
+    block[GEN_P] = generation;
+
+    if (put_block(SNAPSHOT_BLOCKID, block)) {
+        fprintf(stderr, "Error creating the snapshot table.\n");
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * loadHorizon: Finds the generation of the newest snapshot from the stamps of the frozen roots.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the snapshot table
+ */
+static int loadHorizon() {
+    char table[BLOCK_SIZE];
+    char block[BLOCK_SIZE];
+
+    if (getFCB(SNAPSHOT_BLOCKID, table)) {
+        fprintf(stderr, "Error retrieving the snapshot table.\n");
+        return -1;
+    }
+
+    horizon = 0;
+
+    for (int i = ENTRY_START; i + ENTRY_LENGTH <= GEN_P; i += ENTRY_LENGTH) {
+        char* line = &table[i];
+
+        if (line[TYPE_P] != DIRECTORY || line[NAME_P] == '\0') {
+            continue;
+        }
+
+        if (get_block(decode_int(&line[START_P]), block)) {
+            fprintf(stderr, "Error retrieving the snapshot table.\n");
+            return -1;
+        }
+
+        if ((unsigned char) block[GEN_P] > horizon) {
+            horizon = (unsigned char) block[GEN_P];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * createSnapshotTable: Creates the snapshot table of a freshly erased disk.
+ *
+ * return  0:       successful execution
+ * return -1:       error creating the snapshot table
+ */
+int createSnapshotTable() {
+    char block[BLOCK_SIZE];
+    memset(block, 0, BLOCK_SIZE);
+
+    generation = FIRST_GENERATION;
+    horizon = 0;
+
+    block[BLOCK_START] = META;
+    block[ENTRY_START] = ENTRY_END;
+    block[GEN_P] = generation;
+
+    if (put_block(SNAPSHOT_BLOCKID, block)) {
+        fprintf(stderr, "Error creating the snapshot table.\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * loadGeneration: Loads the current generation from the snapshot table.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the snapshot table
+ * return -2:       the disk has no snapshot table
+ */
+int loadGeneration() {
+    char block[BLOCK_SIZE];
+
+    if (get_block(SNAPSHOT_BLOCKID, block)) {
+        fprintf(stderr, "Error retrieving the snapshot table.\n");
+        return -1;
+    }
+
+    if (block[BLOCK_START] != META) {
+        fprintf(stderr, "The disk has no snapshot table.\n");
+        return -2;
+    }
+
+    generation = (unsigned char) block[GEN_P];
+
+    return loadHorizon();
+}
+
+/*
+ * getGeneration: Gets the current generation.
+ *
+ * return int:      the current generation
+ */
+int getGeneration() {
+    return generation;
+}
+
+/*
+ * getRoot: Gets the root directory of the mounted tree.
+ *
+ * return int:      block id of the root directory
+ */
+int getRoot() {
+    return root;
+}
+
+/*
+ * isReadOnly: Checks whether the mounted tree is a read-only snapshot, or the disk is sealed.
+ *
+ * return 1:        a snapshot is mounted, or the disk is sealed
+ * return 0:        the live tree is mounted
+ */
+int isReadOnly() {
+    return root != ROOT_BLOCKID || isSealed();
+}
+
+/*
+ * isShared: Checks whether a block is shared with a snapshot.
+ *
+ * @block       String      contents of the block
+ *
+ * return 1:                the block was written no later than the newest snapshot
+ * return 0:                the block belongs to the live tree only
+ */
+int isShared(const char* block) {
+    return (unsigned char) block[GEN_P] <= horizon;
+}
+
+/*
+ * copyOnWrite: Moves the contents of a shared block to a fresh block of the current generation.
+ * The caller is responsible for pointing the referrer of the block at the copy.
+ *
+ * @blockID     Integer Pointer     the shared block, replaced by the copy
+ * @block       String              contents of the shared block, restamped with the current generation
+ *
+ * return  0:                       successful execution
+ * return -1:                       error looking for a free block
+ * return -2:                       error creating file block
+ */
+int copyOnWrite(int* blockID, char* block) {
+    int copy;
+
+    // Keep the copy where the block was
+    if (getFreeBlock(&copy, *blockID)) {
+        fprintf(stderr, "Error looking for a free block.\n");
+        return -1;
+    }
+
+    block[GEN_P] = generation;
+
+    // The copy starts out with a single referrer
+    if (block[BLOCK_START] == FILE) {
+        block[REFS_P] = 1;
+    }
+
+    if (putFCB(copy, block)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -2;
+    }
+
+    *blockID = copy;
+
+    return 0;
+}
+
+/*
+ * unshareFile: Makes the starting block of an open file private to the live tree.
+ * The path to the file is copied from the root down, and every open file
+ * table entry for the file is moved to the copy. For a file stored inline,
+ * the path to its fcb is copied instead.
+ *
+ * @blockID     Integer Pointer     starting block of the file, replaced by its private copy
+ *
+ * return  0:                       successful execution
+ * return -1:                       error retrieving file block
+ * return -2:                       error finding the file in the live tree
+ * return -3:                       error copying the path to the file
+ */
+int unshareFile(int* blockID) {
+    char block[BLOCK_SIZE];
+
+    // A file stored inline is private once its fcb is
+    int fcBlockID = isInline(*blockID) ? (*blockID - BLOCKS) / BLOCK_SIZE : *blockID;
+
+    if (getFCB(fcBlockID, block)) {
+        fprintf(stderr, "Error retrieving file block.\n");
+        return -1;
+    }
+
+    if (!isShared(block)) {
+        return 0;
+    }
+
+    char** path = malloc(MAX_PATH * sizeof(char*));
+
+    for (int i = 0; i < MAX_PATH; i++) {
+        path[i] = malloc(MAX_DIRNAME);
+    }
+
+    if (findPath(path, fcBlockID)) {
+        fprintf(stderr, "Error finding the file in the live tree.\n");
+        return -2;
+    }
+
+    int copy;
+
+    if (traverseForWrite(&copy, path)) {
+        fprintf(stderr, "Error copying the path to the file.\n");
+        return -3;
+    }
+
+    // Open files stored inline in the fcb were moved along with it
+    if (isInline(*blockID)) {
+        *blockID = INLINE_ID(copy, (*blockID - BLOCKS) % BLOCK_SIZE);
+        return 0;
+    }
+
+    renumber(*blockID, copy);
+    *blockID = copy;
+
+    return 0;
+}
+
+/*
+ * createSnapshot: Freezes the live tree under a name.
+ * Only the root directory is copied. The generation is bumped,
+ * which marks every other block as shared with the snapshot.
+ *
+ * @name        String      name of the snapshot, at most six characters
+ *
+ * return  0:               successful execution
+ * return -1:               invalid snapshot name
+ * return -2:               error retrieving the root directory
+ * return -3:               error looking for a free block
+ * return -4:               error creating file block
+ * return -5:               error adding the snapshot to the snapshot table
+ * return -6:               no generations left until every snapshot is deleted
+ */
+int createSnapshot(char* name) {
+    if (name[0] == '\0' || strlen(name) > MAX_DIRNAME - 1 || strchr(name, '/') != NULL) {
+        fprintf(stderr, "Invalid snapshot name.\n");
+        return -1;
+    }
+
+    if (generation >= MAX_GENERATION) {
+        fprintf(stderr, "No generations left.\n");
+        return -6;
+    }
+
+    char block[BLOCK_SIZE];
+
+    if (getFCB(ROOT_BLOCKID, block)) {
+        fprintf(stderr, "Error retrieving the root directory.\n");
+        return -2;
+    }
+
+    int frozen;
+
+    if (getFreeBlock(&frozen, SNAPSHOT_BLOCKID)) {
+        fprintf(stderr, "Error looking for a free block.\n");
+        return -3;
+    }
+
+    // The stamp of the frozen root is the generation of the snapshot
+    block[GEN_P] = generation;
+
+    if (putFCB(frozen, block)) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -4;
+    }
+
+    if (linkEntry(frozen, SNAPSHOT_BLOCKID, name, DIRECTORY)) {
+        // Release the copy of the root directory
+        block[BLOCK_START] = FREE;
+        putFCB(frozen, block);
+
+        fprintf(stderr, "Error adding the snapshot to the snapshot table.\n");
+        return -5;
+    }
+
+    horizon = generation++;
+
+    // The live root directory was copied, so it is not shared with the snapshot
+    block[GEN_P] = generation;
+
+    if (putFCB(ROOT_BLOCKID, block) || saveGeneration()) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -4;
+    }
+
+    return 0;
+}
+
+/*
+ * restampBlocks: Stamps every file and directory block with FIRST_GENERATION,
+ * reading and writing the disk a run of blocks at a time.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the blocks
+ * return -2:       error creating the blocks
+ */
+static int restampBlocks() {
+    char blocks[RESTAMP_RUN][BLOCK_SIZE];
+
+    for (int first = RESERVED_BLOCKS; first < BLOCKS; first += RESTAMP_RUN) {
+        int count = BLOCKS - first < RESTAMP_RUN ? BLOCKS - first : RESTAMP_RUN;
+        int changed = 0;
+
+        if (get_run(first, count, blocks[0])) {
+            fprintf(stderr, "Error retrieving blocks %d to %d.\n", first, first + count - 1);
+            return -1;
+        }
+
+        for (int k = 0; k < count; k++) {
+            char* block = blocks[k];
+
+            if (!isFormatted(first + k) || (block[BLOCK_START] != FILE && block[BLOCK_START] != DIRECTORY)) {
+                continue;
+            }
+
+            if (block[GEN_P] != FIRST_GENERATION) {
+                block[GEN_P] = FIRST_GENERATION;
+                changed = 1;
+            }
+        }
+
+        if (changed && put_run(first, count, blocks[0])) {
+            fprintf(stderr, "Error creating blocks %d to %d.\n", first, first + count - 1);
+            return -2;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * deleteSnapshot: Removes a snapshot from the snapshot table.
+ * Its blocks are not freed here: the caller sweeps the disk for the blocks nothing reaches any more.
+ * Deleting the last snapshot restamps the disk, so generations are counted from the first again.
+ *
+ * precondition: the live tree is mounted
+ *
+ * @name        String      name of the snapshot
+ *
+ * return  0:               successful execution
+ * return -1:               no such snapshot
+ * return -2:               error reading the snapshot table
+ * return -3:               error restamping the blocks
+ */
+int deleteSnapshot(const char* name) {
+    int frozen;
+
+    if (name == NULL || name[0] == '\0' || removeEntry(&frozen, SNAPSHOT_BLOCKID, name)) {
+        fprintf(stderr, "No such snapshot.\n");
+        return -1;
+    }
+
+    if (loadHorizon()) {
+        return -2;
+    }
+
+    if (horizon == 0 && generation != FIRST_GENERATION) {
+        if (restampBlocks()) {
+            return -3;
+        }
+
+        generation = FIRST_GENERATION;
+
+        if (saveGeneration()) {
+            return -2;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * mountSnapshot: Mounts a snapshot read-only, or the live tree.
+ * The open file table is left alone: the caller makes sure no file is open.
+ *
+ * @name        String      name of the snapshot, or NULL for the live tree
+ *
+ * return  0:               successful execution
+ * return -1:               no such snapshot
+ */
+int mountSnapshot(const char* name) {
+    int frozen = ROOT_BLOCKID;
+
+    if (name != NULL && name[0] != '\0' && getStart(&frozen, SNAPSHOT_BLOCKID, name)) {
+        fprintf(stderr, "No such snapshot.\n");
+        return -1;
+    }
+
+    root = frozen;
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*
+ * snapshot.h
+ *
+ */
+
+#define SNAPSHOT_BLOCKID 1
+#define FIRST_GENERATION 1
+#define MAX_GENERATION 255
+#define RESTAMP_RUN 64
+
+// Creates the snapshot table of a freshly erased disk
+int createSnapshotTable();
+
+// Loads the current generation from the snapshot table
+int loadGeneration();
+
+// Gets the current generation
+int getGeneration();
+
+// Gets the root directory of the mounted tree
+int getRoot();
+
+// Checks whether the mounted tree is a read-only snapshot, or the disk is sealed
+int isReadOnly();
+
+// Checks whether a block is shared with a snapshot
+int isShared(const char* block);
+
+// Moves the contents of a shared block to a fresh block of the current generation
+int copyOnWrite(int* blockID, char* block);
+
+// Makes the starting block of an open file private to the live tree
+int unshareFile(int* blockID);
+
+// Freezes the live tree under a name
+int createSnapshot(char* name);
+
+// Removes a snapshot from the snapshot table
+int deleteSnapshot(const char* name);
+
+// Mounts a snapshot, or the live tree
+int mountSnapshot(const char* name);
@@ -0,0 +1,209 @@
+/*
+ * stats.c
+ *
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <string.h>
+#include <time.h>
+#include "fileSystem.h"
+#include "stats.h"
+
+/*
+ * Every public operation counts its calls, errors, block reads and writes, allocator calls and
+ * fcb cache hits and misses, and keeps its latencies in a histogram. Work done while no
+ * operation is running, and the operations called from inside another, are counted against
+ * the outermost one, or against OP_OTHER.
+ *
+ * The histogram has LATENCY_SUBBUCKETS buckets per power of two above LATENCY_SUBBUCKETS
+ * nanoseconds, so every latency is kept to within 1/LATENCY_SUBBUCKETS of its value at
+ * the cost of a few shifts per operation.
+ */
+
+static const char* names[SFS_OPS] = { "open", "read", "write", "pread", "pwrite", "readv", "writev", "readdir",
+        "close", "delete", "create", "create_batch", "delete_batch", "rename", "copy_range", "fallocate",
+        "truncate", "getsize", "gettype", "initialize", "snapshot", "mount", "dedup", "reclaim", "preload", "seal",
+        "warmup", "shutdown", "defrag", "fsck", "delete_snapshot", "other" };
+
+static struct sfs_stats stats;
+
+// The outermost operation running, and how many operations are nested in it
+static int current = OP_OTHER;
+static int depth = 0;
+
+/*
+ * now: Reads the monotonic clock in nanoseconds.
+ */
+static long now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/*
+ * bucketOf: Finds the bucket of the histogram a latency falls in.
+ */
+static int bucketOf(unsigned long latency) {
+    if (latency < 2 * LATENCY_SUBBUCKETS) {
+        return latency;
+    }
+
+    int exponent = 0;
+
+    while (latency >> (exponent + 1)) {
+        exponent++;
+    }
+
+    // The leading bit and the next ones pick the power of two and the bucket within it
+    int bucket = 2 * LATENCY_SUBBUCKETS + (exponent - LATENCY_BITS - 1) * LATENCY_SUBBUCKETS
+            + ((latency >> (exponent - LATENCY_BITS)) & (LATENCY_SUBBUCKETS - 1));
+
+    return bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1;
+}
+
+/*
+ * lowestOf: Finds the smallest latency that falls in a bucket of the histogram.
+ */
+static unsigned long lowestOf(int bucket) {
+    if (bucket < 2 * LATENCY_SUBBUCKETS) {
+        return bucket;
+    }
+
+    int exponent = (bucket - 2 * LATENCY_SUBBUCKETS) / LATENCY_SUBBUCKETS + LATENCY_BITS + 1;
+    unsigned long sub = bucket % LATENCY_SUBBUCKETS;
+
+    return (LATENCY_SUBBUCKETS + sub) << (exponent - LATENCY_BITS);
+}
+
+/*
+ * beginOp: Starts timing a public operation. An operation called from inside another
+ * is counted as part of the outer one.
+ *
+ * @op          Integer     the operation, one of OP_*
+ *
+ * return long:             when the operation started, in nanoseconds
+ */
+long beginOp(int op) {
+    if (depth++ == 0) {
+        current = op;
+    }
+
+    return now();
+}
+
+/*
+ * endOp: Records a public operation that has ended.
+ *
+ * @op          Integer     the operation, one of OP_*
+ * @start       Long        when the operation started
+ * @result      Integer     what the operation returned; it failed if negative
+ *
+ * return int:              the result, unchanged
+ */
+int endOp(int op, long start, int result) {
+    if (--depth > 0) {
+        return result;
+    }
+
+    unsigned long latency = now() - start;
+    struct sfs_opstats* stat = &stats.ops[op];
+
+    stat->calls++;
+    stat->errors += result < 0;
+    stat->totalTime += latency;
+    stat->maxTime = latency > stat->maxTime ? latency : stat->maxTime;
+    stat->latencies[bucketOf(latency)]++;
+
+    current = OP_OTHER;
+
+    return result;
+}
+
+/*
+ * countBlockRead: Counts a block read from disk against the operation running.
+ */
+void countBlockRead() {
+    stats.ops[current].blockReads++;
+}
+
+/*
+ * countBlockWrite: Counts a block written to disk against the operation running.
+ */
+void countBlockWrite() {
+    stats.ops[current].blockWrites++;
+}
+
+/*
+ * countAllocation: Counts a call to the allocator against the operation running.
+ */
+void countAllocation() {
+    stats.ops[current].allocations++;
+}
+
+/*
+ * countCache: Counts a fcb served from the directory tree in memory, or read from disk.
+ *
+ * @hit         Integer     1 if the fcb was held in memory
+ */
+void countCache(int hit) {
+    if (hit) {
+        stats.ops[current].cacheHits++;
+    } else {
+        stats.ops[current].cacheMisses++;
+    }
+}
+
+/*
+ * getStats: Copies the counters of every operation.
+ *
+ * @copy        sfs_stats Pointer   where the counters are copied to
+ * @reset       Integer             1 to clear the counters after copying them
+ */
+void getStats(struct sfs_stats* copy, int reset) {
+    for (int op = 0; op < SFS_OPS; op++) {
+        stats.ops[op].name = names[op];
+    }
+
+    if (copy != NULL) {
+        memcpy(copy, &stats, sizeof(struct sfs_stats));
+    }
+
+    if (reset) {
+        memset(&stats, 0, sizeof(struct sfs_stats));
+    }
+}
+
+/*
+ * getPercentile: Gets a percentile of the latencies of an operation from its histogram.
+ *
+ * @op          sfs_opstats Pointer     the counters of the operation
+ * @fraction    Double                  the percentile, between 0 and 1
+ *
+ * return unsigned long:                the latency, in nanoseconds, or 0 if the operation never ran
+ */
+unsigned long getPercentile(const struct sfs_opstats* op, double fraction) {
+    if (op->calls == 0) {
+        return 0;
+    }
+
+    unsigned long rank = (unsigned long) (fraction * (op->calls - 1)) + 1;
+    unsigned long seen = 0;
+
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += op->latencies[bucket];
+
+        if (seen >= rank) {
+            unsigned long lowest = lowestOf(bucket);
+            unsigned long highest = bucket + 1 < LATENCY_BUCKETS ? lowestOf(bucket + 1) - 1 : op->maxTime;
+
+            // The middle of the bucket, but never more than the slowest call
+            unsigned long middle = lowest + (highest - lowest) / 2;
+
+            return middle < op->maxTime ? middle : op->maxTime;
+        }
+    }
+
+    return op->maxTime;
+}
@@ -0,0 +1,61 @@
+/*
+ * stats.h
+ *
+ */
+
+#define OP_OPEN         0
+#define OP_READ         1
+#define OP_WRITE        2
+#define OP_PREAD        3
+#define OP_PWRITE       4
+#define OP_READV        5
+#define OP_WRITEV       6
+#define OP_READDIR      7
+#define OP_CLOSE        8
+#define OP_DELETE       9
+#define OP_CREATE       10
+#define OP_CREATE_BATCH 11
+#define OP_DELETE_BATCH 12
+#define OP_RENAME       13
+#define OP_COPY_RANGE   14
+#define OP_FALLOCATE    15
+#define OP_TRUNCATE     16
+#define OP_GETSIZE      17
+#define OP_GETTYPE      18
+#define OP_INITIALIZE   19
+#define OP_SNAPSHOT     20
+#define OP_MOUNT        21
+#define OP_DEDUP        22
+#define OP_RECLAIM      23
+#define OP_PRELOAD      24
+#define OP_SEAL         25
+#define OP_WARMUP       26
+#define OP_SHUTDOWN     27
+#define OP_DEFRAG       28
+#define OP_FSCK         29
+#define OP_DELETE_SNAPSHOT 30
+#define OP_OTHER        31
+
+// Starts timing a public operation, and returns when it started
+long beginOp(int op);
+
+// Records a public operation that has ended, passing its result through
+int endOp(int op, long start, int result);
+
+// Counts a block read from disk
+void countBlockRead();
+
+// Counts a block written to disk
+void countBlockWrite();
+
+// Counts a call to the allocator
+void countAllocation();
+
+// Counts a fcb served from memory, or read from disk
+void countCache(int hit);
+
+// Copies the counters of every operation, clearing them if asked
+void getStats(struct sfs_stats* stats, int reset);
+
+// Gets a percentile of the latencies of an operation
+unsigned long getPercentile(const struct sfs_opstats* op, double fraction);
@@ -17,31 +17,22 @@ char* encode_int(int c) {
     char* output = malloc(START);
 
     /*
-     * int      output[0]   output[1]
-     *  -1           -128           0
-     *   0           -127           0
-     * 127              0           0
-     * 128              1           0
-     * 129              2           0
-     * 254            127           0
-     * 255            128           0
-     * 382            255           0
+     * The integer is shifted up by one so that -1 (BLOCK_END) is stored as 0,
+     * then split into a low and a high byte.
      *
-     * 383           -128           1
-     * 384           -127           1
-     * 385           -126           1
-     * 509             -2           1
-     * 510             -1           1
-     * 511              0           1
+     * int      output[0]   output[1]
+     *  -1              0           0
+     *   0              1           0
+     * 254            255           0
+     * 255              0           1
+     * 256              1           1
+     * 511              0           2
      */
 
-    if (c < 383) {
-        output[0] = c - 127;
-        output[1] = 0;
-    } else {
-        output[0] = c - 511;
-        output[1] = 1;
-    }
+    unsigned int shifted = c + 1;
+
+    output[0] = (char) (shifted & 0xFF);
+    output[1] = (char) (shifted >> 8);
 
     return output;
 }
@@ -57,26 +48,13 @@ int decode_int(char* c) {
 
     /*
      * int        char[0]     char[1]
-     *  -1           -128           0
-     *   0           -127           0
-     * 127              0           0
-     * 128              1           0
-     * 129              2           0
-     * 254            127           0
-     * 255            128           0
-     * 382            255           0
-     *
-     * 383           -128           1
-     * 384           -127           1
-     * 385           -126           1
-     * 509             -2           1
-     * 510             -1           1
-     * 511              0           1
+     *  -1              0           0
+     *   0              1           0
+     * 254            255           0
+     * 255              0           1
+     * 256              1           1
+     * 511              0           2
      */
 
-    if (c[1] == 0) {
-        return c[0] + 127;
-    }
-
-    return c[0] + 511;
+    return ((unsigned char) c[0] | (unsigned char) c[1] << 8) - 1;
 }
@@ -0,0 +1,202 @@
+/*
+ * superblock.c
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blockio.h"
+#include "entry.h"
+#include "fControl.h"
+#include "fileSystem.h"
+#include "scheduler.h"
+#include "storeInt.h"
+#include "superblock.h"
+
+/*
+ * The superblock records which blocks have been written since the disk was formatted:
+ *
+ *      type    magic   blocks  bitmap ...                                      seal
+ *      META    SFS1    BLOCKS  one bit per block, set once the block is formatted  path index of a sealed disk
+ *
+ * Formatting writes the reserved blocks and clears the bitmap, so its cost does not grow
+ * with the disk. A block whose bit is clear is free whatever it holds; the allocator
+ * marks it free on disk and sets its bit the first time it hands the block out.
+ * A disk without a superblock was formatted block by block, so all of it counts as formatted.
+ */
+
+// The allocation bitmap of the mounted disk
+static unsigned char bitmap[(BLOCKS + 7) / 8];
+
+// Whether the disk has a superblock to keep the bitmap in
+static int lazy = 0;
+
+/*
+ * setFormatted: Sets the bit of a block in the allocation bitmap.
+ */
+static void setFormatted(int blockID) {
+    bitmap[blockID / 8] |= 1 << (blockID % 8);
+}
+
+/*
+ * saveBitmap: Writes the superblock with the allocation bitmap.
+ * The rest of the superblock is kept, unless the disk is being formatted.
+ *
+ * @format      Integer     1 to start from an empty superblock
+ *
+ * return  0:               successful execution
+ * return -1:               error retrieving the superblock
+ * return -2:               error creating the superblock
+ */
+static int saveBitmap(int format) {
+    char block[BLOCK_SIZE];
+
+    if (!format && get_block(SUPER_BLOCKID, block)) {
+        fprintf(stderr, "Error retrieving the superblock.\n");
+        return -1;
+    }
+
+    if (format || !isSuperblock(block)) {
+        char* none = encode_int(BLOCK_END);
+        memset(block, 0, BLOCK_SIZE);
+
+        block[SEAL_P] = none[0];
+        block[SEAL_P + 1] = none[1];
+        free(none);
+    }
+
+    block[BLOCK_START] = META;
+    memcpy(&block[MAGIC_P], MAGIC, MAGIC_LENGTH);
+
+    char* blocks = encode_int(BLOCKS);
+    block[BLOCKS_P] = blocks[0];
+    block[BLOCKS_P + 1] = blocks[1];
+    free(blocks);
+
+    memcpy(&block[BITMAP_P], bitmap, sizeof(bitmap));
+
+    if (put_block(SUPER_BLOCKID, block)) {
+        fprintf(stderr, "Error creating the superblock.\n");
+        return -2;
+    }
+
+    return 0;
+}
+
+/*
+ * formatDisk: Writes the superblock and an empty allocation bitmap over the disk.
+ * Only the reserved blocks count as formatted; their owners write them next.
+ *
+ * return  0:       successful execution
+ * return -1:       error creating the superblock
+ */
+int formatDisk() {
+    memset(bitmap, 0, sizeof(bitmap));
+    lazy = 1;
+
+    for (int i = 0; i < RESERVED_BLOCKS; i++) {
+        setFormatted(i);
+    }
+
+    return saveBitmap(1);
+}
+
+/*
+ * isSuperblock: Checks whether a block is a superblock for this disk.
+ *
+ * @block       String      contents of the block
+ *
+ * return 1:                the block is a superblock for a disk of BLOCKS blocks
+ * return 0:                the block is anything else
+ */
+int isSuperblock(const char* block) {
+    char blocks[2];
+    blocks[0] = block[BLOCKS_P];
+    blocks[1] = block[BLOCKS_P + 1];
+
+    return block[BLOCK_START] == META && !memcmp(&block[MAGIC_P], MAGIC, MAGIC_LENGTH)
+            && decode_int(blocks) == BLOCKS;
+}
+
+/*
+ * loadBitmap: Loads the allocation bitmap from the superblock.
+ *
+ * return  0:       successful execution
+ * return -1:       error retrieving the superblock
+ */
+int loadBitmap() {
+    char block[BLOCK_SIZE];
+
+    if (get_block(SUPER_BLOCKID, block)) {
+        fprintf(stderr, "Error retrieving the superblock.\n");
+        return -1;
+    }
+
+    lazy = isSuperblock(block);
+
+    if (lazy) {
+        memcpy(bitmap, &block[BITMAP_P], sizeof(bitmap));
+    }
+
+    return 0;
+}
+
+/*
+ * isFormatted: Checks whether a block has been written since the disk was formatted.
+ * Only the type of a formatted block means anything.
+ *
+ * @blockID     Integer     the block
+ *
+ * return 1:                the block is formatted
+ * return 0:                the block is free, whatever it holds
+ */
+int isFormatted(int blockID) {
+    return !lazy || ((bitmap[blockID / 8] >> (blockID % 8)) & 1);
+}
+
+/*
+ * formatBlocks: Marks fresh blocks as free on disk before they are handed out,
+ * so that a block left unused still reads as free. The bitmap is written once.
+ *
+ * @blockIDs    Integer Array       the blocks, formatted or not
+ * @count       Integer             number of blocks
+ *
+ * return  0:                       successful execution
+ * return -1:                       error creating the block or the superblock
+ */
+int formatBlocks(const int* blockIDs, int count) {
+    char block[BLOCK_SIZE];
+    struct request* writes = malloc(count * sizeof(struct request));
+    int changed = 0;
+
+    memset(block, 0, BLOCK_SIZE);
+    block[BLOCK_START] = FREE;
+
+    for (int i = 0; i < count; i++) {
+        if (!isFormatted(blockIDs[i])) {
+            writes[changed].blockID = blockIDs[i];
+            writes[changed].write = WRITE_REQUEST;
+            writes[changed++].buffer = block;
+        }
+    }
+
+    int result = submitBatch(writes, changed);
+
+    for (int i = 0; i < changed && result == 0; i++) {
+        setFormatted(writes[i].blockID);
+    }
+
+    free(writes);
+
+    if (result) {
+        fprintf(stderr, "Error creating file block.\n");
+        return -1;
+    }
+
+    if (changed && saveBitmap(0)) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * superblock.h
+ *
+ */
+
+#define SUPER_BLOCKID 3
+#define RESERVED_BLOCKS (SUPER_BLOCKID + 1)
+#define MAGIC "SFS1"
+#define MAGIC_P 1
+#define MAGIC_LENGTH 4
+#define BLOCKS_P (MAGIC_P + MAGIC_LENGTH)
+#define BITMAP_P (BLOCKS_P + START)
+#define SEAL_P (BITMAP_P + (BLOCKS + 7) / 8)
+#define KEYS_P (SEAL_P + START)
+#define BUCKETS_P (KEYS_P + START)
+
+// Writes the superblock and an empty allocation bitmap over the disk
+int formatDisk();
+
+// Checks whether a block is a superblock for this disk
+int isSuperblock(const char* block);
+
+// Loads the allocation bitmap from the superblock
+int loadBitmap();
+
+// Checks whether a block has been written since the disk was formatted
+int isFormatted(int blockID);
+
+// Marks fresh blocks as free on disk before they are handed out
+int formatBlocks(const int* blockIDs, int count);
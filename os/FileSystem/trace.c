@@ -0,0 +1,166 @@
+/*
+ * trace.c
+ *
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "trace.h"
+
+#ifdef SFS_TRACE
+
+/*
+ * Every thread records its spans into its own ring of TRACE_EVENTS events, so recording takes
+ * no lock: the thread is the only writer of its ring, and publishes each event by storing the
+ * new count after it. The oldest events are overwritten once a ring is full. A ring is
+ * registered in a fixed table the first time its thread records a span; exporting reads every
+ * registered ring, and is meant to run once the traced work is done.
+ */
+
+// A span that has ended
+struct event {
+    const char* name;
+    long start;
+    long duration;
+};
+
+struct ring {
+    struct event events[TRACE_EVENTS];
+    unsigned long count;
+};
+
+static struct ring* rings[TRACE_THREADS];
+static int threads = 0;
+
+// The ring of the calling thread
+static __thread struct ring* own = NULL;
+
+/*
+ * now: Reads the monotonic clock in nanoseconds.
+ */
+static long now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+/*
+ * beginSpan: Opens a span.
+ *
+ * @name        String      what the span is timing, which must outlive the trace
+ *
+ * return span:             the span, started now
+ */
+struct span beginSpan(const char* name) {
+    struct span span = { name, now() };
+
+    return span;
+}
+
+/*
+ * endSpan: Records a span that has ended in the ring of the calling thread.
+ * A thread that cannot get a ring records nothing.
+ *
+ * @span        span Pointer    the span, started by beginSpan
+ */
+void endSpan(struct span* span) {
+    long end = now();
+
+    if (own == NULL) {
+        int slot = __atomic_fetch_add(&threads, 1, __ATOMIC_RELAXED);
+
+        if (slot >= TRACE_THREADS || (own = calloc(1, sizeof(struct ring))) == NULL) {
+            return;
+        }
+
+        __atomic_store_n(&rings[slot], own, __ATOMIC_RELEASE);
+    }
+
+    unsigned long count = own->count;
+    struct event* event = &own->events[count % TRACE_EVENTS];
+
+    event->name = span->name;
+    event->start = span->start;
+    event->duration = end - span->start;
+
+    __atomic_store_n(&own->count, count + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * exportTrace: Writes the spans recorded by every thread as complete events in the
+ * Chrome trace event format, which trace viewers such as Perfetto load as they are.
+ *
+ * @filename    String      the file to write
+ *
+ * return  0:               successful execution
+ * return -1:               the file system was compiled without tracing
+ * return -2:               error writing the file
+ */
+int exportTrace(const char* filename) {
+    FILE* out = fopen(filename, "w");
+
+    if (out == NULL) {
+        fprintf(stderr, "Error opening %s.\n", filename);
+        return -2;
+    }
+
+    int first = 1;
+    int registered = __atomic_load_n(&threads, __ATOMIC_RELAXED);
+
+    fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+    for (int t = 0; t < registered && t < TRACE_THREADS; t++) {
+        struct ring* ring = __atomic_load_n(&rings[t], __ATOMIC_ACQUIRE);
+
+        if (ring == NULL) {
+            continue;
+        }
+
+        unsigned long count = __atomic_load_n(&ring->count, __ATOMIC_ACQUIRE);
+        unsigned long oldest = count > TRACE_EVENTS ? count - TRACE_EVENTS : 0;
+
+        for (unsigned long i = oldest; i < count; i++) {
+            struct event* event = &ring->events[i % TRACE_EVENTS];
+
+            fprintf(out, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                    first ? "" : ",", event->name, t + 1, event->start / 1000.0, event->duration / 1000.0);
+            first = 0;
+        }
+    }
+
+    fprintf(out, "\n]}\n");
+
+    if (fclose(out)) {
+        fprintf(stderr, "Error writing %s.\n", filename);
+        return -2;
+    }
+
+    return 0;
+}
+
+#else
+
+/*
+ * Without -DSFS_TRACE no trace point calls in here, and there is nothing to export.
+ */
+struct span beginSpan(const char* name) {
+    struct span span = { name, 0 };
+
+    return span;
+}
+
+void endSpan(struct span* span) {
+    (void) span;
+}
+
+int exportTrace(const char* filename) {
+    (void) filename;
+    fprintf(stderr, "The file system was compiled without -DSFS_TRACE.\n");
+    return -1;
+}
+
+#endif
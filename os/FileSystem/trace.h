@@ -0,0 +1,33 @@
+/*
+ * trace.h
+ *
+ */
+
+#define TRACE_EVENTS 65536
+#define TRACE_THREADS 64
+
+/*
+ * TRACE(name) opens a span that lasts until the end of the enclosing block, however the block
+ * is left. The span is recorded when the file system is compiled with -DSFS_TRACE;
+ * otherwise the trace point compiles to nothing.
+ */
+#ifdef SFS_TRACE
+#define TRACE(name) struct span traceSpan __attribute__((cleanup(endSpan))) = beginSpan(name)
+#else
+#define TRACE(name) (void) 0
+#endif
+
+// A span being timed
+struct span {
+    const char* name;
+    long start;
+};
+
+// Opens a span
+struct span beginSpan(const char* name);
+
+// Records a span that has ended
+void endSpan(struct span* span);
+
+// Writes the spans recorded by every thread as Chrome trace events
+int exportTrace(const char* filename);